@@ -1,8 +1,10 @@
 // Application.cpp
 #include "Application.h"
 #include "DragonCurve.h"
+#include "FrameProfiler.h"
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <string>
@@ -19,15 +21,6 @@ static hershey_font* g_hersheyFont = nullptr;
 // ------------------------------------------------------------
 // Small helpers
 // ------------------------------------------------------------
-static Entity* FindEntityById(EntityBook& book, std::size_t id)
-{
-    auto& ents = book.GetEntitiesMutable();
-    for (auto& e : ents)
-        if (e.id == id)
-            return &e;
-    return nullptr;
-}
-
 static Entity MakeLine(uint32_t id,
     EntityTag tag,
     int drawOrder,
@@ -125,7 +118,6 @@ void Application::Init(int windowWidth, int windowHeight)
         -(clientHeight * 0.5f) * invZoom);
 
     MarkAllDirty();
-    EnsureCursorEntities();
     OnResize(clientWidth, clientHeight);
 }
 
@@ -153,52 +145,125 @@ void Application::OnResize(int w, int h)
 
     model = glm::mat4(1.0f);
 
-    MarkAllDirty();
+    MarkViewDirty();
 }
 
 
 void Application::MarkAllDirty()
 {
     dirtyScene = true;
+    dirtyGrid = true;
     dirtyPickTree = true;
 }
 
-void Application::Update(float /*deltaTime*/)
+// Camera-only change: the grid is view-dependent, the scene (and therefore the
+// pick tree, which stores unpadded world boxes) is not.
+void Application::MarkViewDirty()
 {
+    dirtyGrid = true;
+}
+
+void Application::Update(float deltaTime)
+{
+    ScopedCpuTimer cpuTimer("Update");
+
     OnMouseMove();
 
-    if (dirtyScene)
+    if (dirtyScene || dirtyGrid)
     {
-        // Remove old grid/scene, rebuild.
-        entityBook.RemoveIf([](const Entity& e)
+        const bool scene = dirtyScene;
+
+        // Rebuilding/sorting shifts EntityBook indices. Hover and selection are
+        // index-based, so restore hover colors now and carry selection across by id.
+        ClearHover();
+
+        std::vector<std::pair<std::size_t, glm::vec4>> keptSelection; // (entity id, previous color)
+        if (scene)
+        {
+            ClearSelection();
+        }
+        else
+        {
+            const auto& ents = entityBook.GetEntities();
+            for (std::size_t idx : selectedIndices)
+            {
+                auto it = selectedPrevColors.find(idx);
+                if (it != selectedPrevColors.end() && idx < ents.size())
+                    keptSelection.emplace_back(ents[idx].id, it->second);
+            }
+        }
+
+        // Camera-only changes rebuild just the grid, so scene entity ids (which the
+        // snap index is keyed on) stay stable while panning/zooming.
+        entityBook.RemoveIf([scene](const Entity& e)
             {
-                return e.tag == EntityTag::Grid || e.tag == EntityTag::Scene || e.tag == EntityTag::Hud;
+                if (e.tag == EntityTag::Grid)
+                    return true;
+                return scene && (e.tag == EntityTag::Scene || e.tag == EntityTag::Hud);
             });
 
+        // Scene ids come from their own range (see kSceneIdBase), so they don't
+        // depend on how many grid lines the viewport needs or on earlier rebuilds.
+        if (scene)
+            RebuildScene();
         RebuildGrid();
-        RebuildScene();
 
-        // Cursor entities stay; make sure ordering is consistent.
+        // Make sure ordering is consistent.
         entityBook.SortByDrawOrder();
 
+        if (!keptSelection.empty())
+        {
+            std::unordered_map<std::size_t, std::size_t> indexById;
+            const auto& ents = entityBook.GetEntities();
+            for (std::size_t i = 0; i < ents.size(); ++i)
+                indexById[ents[i].id] = i;
+
+            selectedIndices.clear();
+            selectedPrevColors.clear();
+            for (const auto& kv : keptSelection)
+            {
+                auto it = indexById.find(kv.first);
+                if (it == indexById.end())
+                    continue;
+                selectedIndices.push_back(it->second);
+                selectedPrevColors[it->second] = kv.second;
+            }
+
+            selectedIndex.reset();
+            if (!selectedIndices.empty())
+                selectedIndex = selectedIndices.front();
+        }
+
+        if (scene)
+        {
+            dirtySnapIndex = true;
+            dirtyPickTree = true;
+        }
+
         dirtyScene = false;
-        dirtyPickTree = true;
+        dirtyGrid = false;
     }
 
-    // Cursor overlay updated every frame (box always, crosshair only when selection inactive).
-    EnsureCursorEntities();
-    UpdateCursorEntities();
+    // Kick off (or map) the pick index as soon as the scene changes, not on first
+    // use; this never blocks, and Poll() swaps in finished builds.
+    EnsurePickTree();
+
+    // Cursor overlay rebuilt every frame (box always, crosshair only when
+    // selection inactive); it is drawn immediate-mode, outside the book.
+    UpdateSnap();
+    BuildOverlay();
 
     // Hover only when selection mode is active and we are NOT doing a marquee drag.
     if (selectionMode && !marqueeActive)
     {
-        EnsurePickTree();
         UpdateHover();
     }
     else
     {
         ClearHover();
     }
+
+    UpdateFrameStatsOverlay(deltaTime);
 }
 
 void Application::OnMouseMove()
@@ -246,7 +311,7 @@ void Application::UpdateMousePan(int clientX, int clientY)
     panPixels -= glm::vec2(delta.x * invZoom, delta.y * invZoom);
 
     UpdateCameraMatrices();
-    MarkAllDirty();
+    MarkViewDirty();
 }
 
 
@@ -269,7 +334,7 @@ void Application::ZoomAtClient(int cx, int cy, float zoomFactor)
     panPixels = worldUnder - client / std::max(0.0001f, zoom);
 
     UpdateCameraMatrices();
-    MarkAllDirty();
+    MarkViewDirty();
 }
 
 
@@ -279,7 +344,7 @@ void Application::PanByPixels(int dx, int dy)
     panPixels += glm::vec2(dx * invZoom, dy * invZoom);
 
     UpdateCameraMatrices();
-    MarkAllDirty();
+    MarkViewDirty();
 }
 
 
@@ -300,7 +365,7 @@ void Application::ToggleSelectionMode()
 void Application::ToggleGrid()
 {
     gridEnabled = !gridEnabled;
-    MarkAllDirty();
+    MarkViewDirty();
 }
 
 void Application::ToggleWipeout()
@@ -309,6 +374,25 @@ void Application::ToggleWipeout()
     MarkAllDirty();
 }
 
+void Application::ToggleObjectSnap()
+{
+    snapEnabled = !snapEnabled;
+    if (!snapEnabled)
+        activeSnap.reset();
+}
+
+void Application::ToggleFrameStats()
+{
+    frameStatsVisible = !frameStatsVisible;
+    frameStatsTimer = 0.0f;
+
+    if (!frameStatsVisible && frameStatsId != 0)
+    {
+        const std::size_t id = frameStatsId;
+        entityBook.RemoveIf([id](const Entity& e) { return e.id == id; });
+    }
+}
+
 // ------------------------------------------------------------
 // Picking / selection
 // ------------------------------------------------------------
@@ -331,27 +415,22 @@ void Application::OnLeftDown(HWND /*hwnd*/)
 
     EnsurePickTree();
 
-    // Picker square size is defined in client pixels, converted to world units.
-    const float halfSize = (0.5f * static_cast<float>(SELECTION_BOX_SIZE_PX)) / std::max(0.0001f, zoom);
-    const BoundingBox box(
-        mouseWorld.x - halfSize, mouseWorld.y - halfSize, -1.0f,
-        mouseWorld.x + halfSize, mouseWorld.y + halfSize, 1.0f);
+    bool stale = false;
+    const auto hit = PickAt(mouseWorld, &stale);
 
 #if _DEBUG
-    std::printf("[Pick LMB Down] mouseClient=(%d,%d) mouseWorld=(%.3f,%.3f)\n", mouseClient.x, mouseClient.y, mouseWorld.x, mouseWorld.y);
+    std::printf("[Pick LMB Down] mouseClient=(%d,%d) mouseWorld=(%.3f,%.3f)%s\n", mouseClient.x, mouseClient.y, mouseWorld.x, mouseWorld.y,
+        stale ? " (pick tree rebuilding, result may be stale)" : "");
 #endif
 
-    const auto hit = pickTree.QueryFirstIntersect(box);
     if (hit.has_value())
     {
-        // Single entity select
+        // Single entity select. Drop hover first so the highlight color is not
+        // captured as the entity's pre-selection color.
         const std::size_t idx = *hit;
+        ClearHover();
         ApplySelection(std::vector<std::size_t>{ idx });
 
-        // Prevent hover from immediately undoing selection
-        if (hoveredIndex.has_value() && *hoveredIndex == idx)
-            hoveredIndex.reset();
-
         return;
     }
 
@@ -378,25 +457,28 @@ void Application::UpdateMarqueeDrag(int clientX, int clientY)
 
 void Application::ClearSelection()
 {
-    auto& ents = entityBook.GetEntitiesMutable();
+    const auto& ents = entityBook.GetEntities();
 
     for (const auto& kv : selectedPrevColors)
     {
         const std::size_t idx = kv.first;
         if (idx < ents.size() && ents[idx].type == EntityType::Line)
-            ents[idx].line.color = kv.second;
+            entityBook.EditEntity(idx).line.color = kv.second;
     }
 
     selectedPrevColors.clear();
     selectedIndices.clear();
     selectedIndex.reset();
+
+    // Colors changed under the cursor; re-resolve hover next frame.
+    hoverKeyValid = false;
 }
 
 void Application::ApplySelection(const std::vector<std::size_t>& indices)
 {
     ClearSelection();
 
-    auto& ents = entityBook.GetEntitiesMutable();
+    const auto& ents = entityBook.GetEntities();
     selectedIndices = indices;
     if (!selectedIndices.empty())
         selectedIndex = selectedIndices.front();
@@ -405,10 +487,10 @@ void Application::ApplySelection(const std::vector<std::size_t>& indices)
     {
         if (idx >= ents.size())
             continue;
-        Entity& e = ents[idx];
-        if (e.type != EntityType::Line)
+        if (ents[idx].type != EntityType::Line)
             continue;
 
+        Entity& e = entityBook.EditEntity(idx);
         selectedPrevColors[idx] = e.line.color;
         e.line.color = glm::vec4(1, 1, 1, 1); // SELECTED = white
     }
@@ -488,26 +570,10 @@ void Application::FinishMarqueeSelect()
     marqueeActive = false;
 }
 
-void Application::UpdateMarqueeOverlay()
+void Application::AppendMarqueeOverlay()
 {
-    // Hide marquee when not active by collapsing it to cursor center.
     if (!marqueeActive)
-    {
-        const float cx = static_cast<float>(mouseClient.x);
-        const float cy = static_cast<float>(clientHeight - 1 - mouseClient.y);
-        const glm::vec3 c(cx, cy, 0.0f);
-
-        for (int i = 0; i < 4; ++i)
-        {
-            if (auto* l = FindEntityById(entityBook, marqueeBoxId[i]))
-            {
-                l->screenSpace = true;
-                l->line.start = c;
-                l->line.end = c;
-            }
-        }
         return;
-    }
 
     // Use client coords, but convert to renderer's Y-up screen space.
     const float sx = static_cast<float>(marqueeStartClient.x);
@@ -525,32 +591,33 @@ void Application::UpdateMarqueeOverlay()
     const glm::vec3 r11(x1, y1, 0.0f);
     const glm::vec3 r01(x0, y1, 0.0f);
 
-    if (auto* b0 = FindEntityById(entityBook, marqueeBoxId[0])) { b0->screenSpace = true; b0->line.start = r00; b0->line.end = r10; }
-    if (auto* b1 = FindEntityById(entityBook, marqueeBoxId[1])) { b1->screenSpace = true; b1->line.start = r10; b1->line.end = r11; }
-    if (auto* b2 = FindEntityById(entityBook, marqueeBoxId[2])) { b2->screenSpace = true; b2->line.start = r11; b2->line.end = r01; }
-    if (auto* b3 = FindEntityById(entityBook, marqueeBoxId[3])) { b3->screenSpace = true; b3->line.start = r01; b3->line.end = r00; }
+    AddOverlayLine(r00, r10);
+    AddOverlayLine(r10, r11);
+    AddOverlayLine(r11, r01);
+    AddOverlayLine(r01, r00);
 }
 
 void Application::EnsurePickTree()
 {
-    if (!dirtyPickTree)
-        return;
+    // Never blocks: a dirty tree is rebuilt on the worker from a snapshot while
+    // queries keep using the previous one until the new build is swapped in.
+    if (dirtyPickTree)
+    {
+        BuildPickTree();
+        dirtyPickTree = false;
+    }
 
-    BuildPickTree();
-    dirtyPickTree = false;
+    pickTree.Poll();
 }
 
 void Application::BuildPickTree()
 {
-    pickTree.Clear();
+    ScopedCpuTimer cpuTimer("BuildPickTree");
 
     const auto& ents = entityBook.GetEntities();
-    std::vector<std::pair<BoundingBox, std::size_t>> items;
+    AsyncGeometryTree::Items items;
     items.reserve(ents.size());
 
-    // Small pad so thin lines are still hittable. Uses selection box size.
-    const float pad = (0.5f * static_cast<float>(SELECTION_BOX_SIZE_PX)) / std::max(0.0001f, zoom);
-
     for (std::size_t i = 0; i < ents.size(); ++i)
     {
         const Entity& e = ents[i];
@@ -563,20 +630,90 @@ void Application::BuildPickTree()
         const glm::vec3 a = e.line.start;
         const glm::vec3 b = e.line.end;
 
-        const float minX = std::min(a.x, b.x) - pad;
-        const float minY = std::min(a.y, b.y) - pad;
-        const float maxX = std::max(a.x, b.x) + pad;
-        const float maxY = std::max(a.y, b.y) + pad;
+        items.emplace_back(BoundingBox(
+            std::min(a.x, b.x), std::min(a.y, b.y), -1.0f,
+            std::max(a.x, b.x), std::max(a.y, b.y), 1.0f), e.id);
+    }
+
+    if (pickIndexPath.empty())
+    {
+        pickTree.RequestBuild(std::move(items));
+        return;
+    }
 
-        items.emplace_back(BoundingBox(minX, minY, -1.0f, maxX, maxY, 1.0f), i);
+    // Persisted index: map it and pick immediately if it was built from exactly
+    // these items; otherwise rebuild in the background and write it back.
+    const uint64_t hash = FlatGeometryIndex::ComputeHash(items);
+    auto persisted = FlatGeometryIndex::Open(pickIndexPath);
+    if (persisted && persisted->GetContentHash() == hash)
+    {
+#if _DEBUG
+        std::printf("[PickTree] mapped '%s' (%zu items)\n", pickIndexPath.c_str(), persisted->GetItemCount());
+#endif
+        pickTree.Adopt(std::move(persisted), true);
+        return;
     }
 
-    if (!items.empty())
-        pickTree.Build(items);
+    // A stale file still beats no index while the rebuild runs (hits are re-checked).
+    if (persisted && !pickTree.HasIndex())
+        pickTree.Adopt(std::move(persisted), false);
+
+    pickTree.RequestBuild(std::move(items), pickIndexPath, hash);
+}
+
+// Picker square around a world position. Its size is defined in client pixels
+// and converted to world units; padding the query (not the stored boxes) keeps
+// thin lines hittable at any zoom.
+BoundingBox Application::PickBox(const glm::vec2& world, float scale) const
+{
+    const float halfSize = scale * (0.5f * static_cast<float>(SELECTION_BOX_SIZE_PX)) / std::max(0.0001f, zoom);
+    return BoundingBox(
+        world.x - halfSize, world.y - halfSize, -1.0f,
+        world.x + halfSize, world.y + halfSize, 1.0f);
+}
+
+// Live check of a pickable entity against a pick box (same test the tree does).
+bool Application::PickBoxHits(const Entity& e, const BoundingBox& box) const
+{
+    if (e.tag != EntityTag::Scene || e.type != EntityType::Line)
+        return false;
+
+    const glm::vec3 a = e.line.start;
+    const glm::vec3 b = e.line.end;
+    return !(std::max(a.x, b.x) < box.minX || std::min(a.x, b.x) > box.maxX ||
+             std::max(a.y, b.y) < box.minY || std::min(a.y, b.y) > box.maxY);
+}
+
+// Entity index under the picker square at a world position, or nullopt.
+// Hits from a stale tree are re-checked against the live entity so a
+// removed or moved entity is never returned.
+std::optional<std::size_t> Application::PickAt(const glm::vec2& world, bool* stale) const
+{
+    const BoundingBox box = PickBox(world);
+
+    const auto r = pickTree.QueryFirstIntersect(box);
+    if (stale)
+        *stale = r.stale;
+
+    if (!r.hit.has_value())
+        return std::nullopt;
+
+    const auto idx = entityBook.FindIndexById(*r.hit);
+    if (!idx.has_value())
+        return std::nullopt;
+
+    const Entity& e = entityBook.GetEntities()[*idx];
+    if (r.stale ? !PickBoxHits(e, box) : (e.tag != EntityTag::Scene || e.type != EntityType::Line))
+        return std::nullopt;
+
+    return idx;
 }
 
 void Application::ClearHover()
 {
+    // Whatever changed (selection, rebuild, mode), the next UpdateHover must resolve again.
+    hoverKeyValid = false;
+
     if (!hoveredIndex.has_value())
         return;
 
@@ -589,25 +726,65 @@ void Application::ClearHover()
         return;
     }
 
-    auto& ents = entityBook.GetEntitiesMutable();
+    const auto& ents = entityBook.GetEntities();
     if (idx < ents.size() && ents[idx].type == EntityType::Line)
-        ents[idx].line.color = hoveredPrevColor;
+        entityBook.EditEntity(idx).line.color = hoveredPrevColor;
 
     hoveredIndex.reset();
 }
 
 void Application::UpdateHover()
 {
-    // Clear previous hover (restores color).
-    ClearHover();
+    const uint64_t generation = pickTree.GetGeneration();
+
+    // Idle frame: same cursor position, zoom and index => same answer, no work.
+    if (hoverKeyValid && hoverKeyWorld == mouseWorld && hoverKeyZoom == zoom && hoverKeyGeneration == generation)
+        return;
+
+    hoverKeyValid = true;
+    hoverKeyWorld = mouseWorld;
+    hoverKeyZoom = zoom;
+    hoverKeyGeneration = generation;
 
     // Query a small box around mouse, sized from SELECTION_BOX_SIZE_PX.
-    const float halfSize = (0.5f * static_cast<float>(SELECTION_BOX_SIZE_PX)) / std::max(0.0001f, zoom);
-    const BoundingBox box(
-        mouseWorld.x - halfSize, mouseWorld.y - halfSize, -1.0f,
-        mouseWorld.x + halfSize, mouseWorld.y + halfSize, 1.0f);
+    const BoundingBox box = PickBox(mouseWorld);
+
+    // Small moves stay inside the inflated box of an earlier query, so its
+    // candidates are a superset of what the tree would return for this box.
+    const bool cacheHit = hoverCacheValid &&
+        hoverCacheZoom == zoom && hoverCacheGeneration == generation &&
+        box.minX >= hoverCacheBox.minX && box.maxX <= hoverCacheBox.maxX &&
+        box.minY >= hoverCacheBox.minY && box.maxY <= hoverCacheBox.maxY;
+
+    if (!cacheHit)
+    {
+        hoverCacheBox = PickBox(mouseWorld, HOVER_CACHE_SCALE);
+        hoverCandidates.clear();
+        pickTree.QueryIntersects(hoverCacheBox, hoverCandidates);
+        hoverCacheZoom = zoom;
+        hoverCacheGeneration = generation;
+        hoverCacheValid = true;
+    }
+
+    std::optional<std::size_t> hit;
+    for (std::size_t id : hoverCandidates)
+    {
+        const auto idx = entityBook.FindIndexById(id);
+        if (idx.has_value() && PickBoxHits(entityBook.GetEntities()[*idx], box))
+        {
+            hit = idx;
+            break;
+        }
+    }
+
+    // Same entity as before: colors are already right.
+    if (hit == hoveredIndex)
+        return;
+
+    // Clear previous hover (restores color). Keep the key we just resolved.
+    ClearHover();
+    hoverKeyValid = true;
 
-    const auto hit = pickTree.QueryFirstIntersect(box);
     if (!hit.has_value())
         return;
 
@@ -617,66 +794,117 @@ void Application::UpdateHover()
     if (selectedPrevColors.find(idx) != selectedPrevColors.end())
         return;
 
-    auto& ents = entityBook.GetEntitiesMutable();
-    if (idx >= ents.size())
-        return;
-
-    Entity& e = ents[idx];
-    if (e.type != EntityType::Line)
+    const auto& ents = entityBook.GetEntities();
+    if (idx >= ents.size() || ents[idx].type != EntityType::Line)
         return;
 
+    Entity& e = entityBook.EditEntity(idx);
     hoveredPrevColor = e.line.color;
     e.line.color = glm::vec4(1, 1, 1, 1); // hover highlight (white)
     hoveredIndex = idx;
 }
 
 // ------------------------------------------------------------
-// Cursor entities (screen space)
+// Object snap
 // ------------------------------------------------------------
-void Application::EnsureCursorEntities()
+void Application::EnsureSnapIndex()
 {
-    if (cursorEntitiesValid)
+    if (!dirtySnapIndex)
         return;
 
-    const glm::vec4 white(1, 1, 1, 1);
-    const int order = 900;
+    // Incremental: only entities whose id/geometry changed are touched
+    // (a full repack once a sizeable part of the scene changed).
+    snapIndex.Sync(entityBook);
+    dirtySnapIndex = false;
+}
 
-    // Crosshair: 6 lines (we only use 2, but keep array stable)
-    for (int i = 0; i < 6; ++i)
+void Application::UpdateSnap()
+{
+    // Snaps drive the drawing crosshair; selection mode has its own pick box.
+    if (!snapEnabled || selectionMode || mousePanning)
     {
-        cursorCrossId[i] = nextId++;
-        entityBook.AddEntity(MakeLine(cursorCrossId[i], EntityTag::Cursor, order,
-            glm::vec3(0, 0, 0), glm::vec3(0, 0, 0),
-            white, 1.0f, true));
+        activeSnap.reset();
+        snapKeyValid = false;
+        return;
     }
 
-    // Box: 4 lines (always drawn; used as selection box OR crosshair center box)
-    for (int i = 0; i < 4; ++i)
-    {
-        cursorBoxId[i] = nextId++;
-        entityBook.AddEntity(MakeLine(cursorBoxId[i], EntityTag::Cursor, order,
-            glm::vec3(0, 0, 0), glm::vec3(0, 0, 0),
-            white, 1.0f, true));
-    }
+    EnsureSnapIndex();
+
+    // Idle frame: same cursor position, zoom and index => same answer, no work.
+    const uint64_t generation = snapIndex.GetGeneration();
+    if (snapKeyValid && snapKeyWorld == mouseWorld && snapKeyZoom == zoom && snapKeyGeneration == generation)
+        return;
+
+    snapKeyValid = true;
+    snapKeyWorld = mouseWorld;
+    snapKeyZoom = zoom;
+    snapKeyGeneration = generation;
+
+    const float radius = static_cast<float>(SNAP_APERTURE_PX) / std::max(0.0001f, zoom);
+    activeSnap = snapIndex.FindBest(mouseWorld, radius);
+}
+
+void Application::AppendSnapMarker()
+{
+    if (!activeSnap.has_value())
+        return;
+
+    // Marker sits on the snapped point (client space, Y-up like the rest of the overlay).
+    const glm::vec2 client = WorldToClient(activeSnap->point);
+    const float x = client.x;
+    const float y = static_cast<float>(clientHeight - 1) - client.y;
+    const float m = static_cast<float>(SNAP_MARKER_PX);
 
-    // Marquee selection rectangle: 4 lines (only shown while dragging)
-    for (int i = 0; i < 4; ++i)
+    const glm::vec3 bl(x - m, y - m, 0.0f), br(x + m, y - m, 0.0f);
+    const glm::vec3 tr(x + m, y + m, 0.0f), tl(x - m, y + m, 0.0f);
+
+    const glm::vec4 snapColor(1.0f, 0.85f, 0.1f, 1.0f);
+    switch (activeSnap->type)
+    {
+    case SnapType::Endpoint: // square
+        AddOverlayLine(bl, br, snapColor);
+        AddOverlayLine(br, tr, snapColor);
+        AddOverlayLine(tr, tl, snapColor);
+        AddOverlayLine(tl, bl, snapColor);
+        break;
+    case SnapType::Midpoint: // triangle
     {
-        marqueeBoxId[i] = nextId++;
-        entityBook.AddEntity(MakeLine(marqueeBoxId[i], EntityTag::Cursor, order,
-            glm::vec3(0, 0, 0), glm::vec3(0, 0, 0),
-            white, 1.0f, true));
+        const glm::vec3 top(x, y + m, 0.0f);
+        AddOverlayLine(bl, br, snapColor);
+        AddOverlayLine(br, top, snapColor);
+        AddOverlayLine(top, bl, snapColor);
+        break;
     }
+    case SnapType::Intersection: // X
+        AddOverlayLine(bl, tr, snapColor);
+        AddOverlayLine(br, tl, snapColor);
+        break;
+    case SnapType::Nearest: // hourglass
+        AddOverlayLine(bl, br, snapColor);
+        AddOverlayLine(br, tl, snapColor);
+        AddOverlayLine(tl, tr, snapColor);
+        AddOverlayLine(tr, bl, snapColor);
+        break;
+    }
+}
 
-    cursorEntitiesValid = true;
-
-    // Reorders vector => pickTree indices become invalid.
-    entityBook.SortByDrawOrder();
-    dirtyPickTree = true;
+// ------------------------------------------------------------
+// Cursor overlay (screen space, outside the book)
+// ------------------------------------------------------------
+void Application::AddOverlayLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color)
+{
+    LineEntity l;
+    l.start = a;
+    l.end = b;
+    l.color = color;
+    l.width = 1.0f;
+    overlayLines.push_back(l);
 }
 
-void Application::UpdateCursorEntities()
+void Application::BuildOverlay()
 {
+    overlayLines.clear();
+
     // Cursor overlay is expressed in client-space pixels.
     // Our renderer’s screen-space path expects Y-up (origin bottom-left),
     // while Win32 mouse coords are Y-down (origin top-left), so flip Y here.
@@ -686,7 +914,6 @@ void Application::UpdateCursorEntities()
     // A small box centered at the cursor. Size is defined in client pixels.
     const float boxHalf = 0.5f * static_cast<float>(SELECTION_BOX_SIZE_PX);
 
-    const glm::vec3 c(cx, cy, 0.0f);
     const glm::vec3 b00(cx - boxHalf, cy - boxHalf, 0.0f);
     const glm::vec3 b10(cx + boxHalf, cy - boxHalf, 0.0f);
     const glm::vec3 b11(cx + boxHalf, cy + boxHalf, 0.0f);
@@ -698,47 +925,68 @@ void Application::UpdateCursorEntities()
         const float w = static_cast<float>(clientWidth);
         const float h = static_cast<float>(clientHeight);
 
-        const glm::vec3 h0(0.0f, cy, 0.0f);
-        const glm::vec3 h1(w, cy, 0.0f);
-        const glm::vec3 v0(cx, 0.0f, 0.0f);
-        const glm::vec3 v1(cx, h, 0.0f);
+        AddOverlayLine(glm::vec3(0.0f, cy, 0.0f), glm::vec3(w, cy, 0.0f));
+        AddOverlayLine(glm::vec3(cx, 0.0f, 0.0f), glm::vec3(cx, h, 0.0f));
+    }
 
-        // Use first two cross entities; collapse the rest.
-        if (auto* l0 = FindEntityById(entityBook, cursorCrossId[0])) { l0->screenSpace = true; l0->line.start = h0; l0->line.end = h1; }
-        if (auto* l1 = FindEntityById(entityBook, cursorCrossId[1])) { l1->screenSpace = true; l1->line.start = v0; l1->line.end = v1; }
+    // Center box always exists.
+    AddOverlayLine(b00, b10);
+    AddOverlayLine(b10, b11);
+    AddOverlayLine(b11, b01);
+    AddOverlayLine(b01, b00);
 
-        for (int i = 2; i < 6; ++i)
-        {
-            if (auto* l = FindEntityById(entityBook, cursorCrossId[i]))
-            {
-                l->screenSpace = true;
-                l->line.start = c;
-                l->line.end = c;
-            }
-        }
-    }
-    else
+    // Optional marquee rectangle (screen space)
+    AppendMarqueeOverlay();
+
+    // Object-snap marker
+    AppendSnapMarker();
+}
+
+// ------------------------------------------------------------
+// Frame statistics overlay (screen space)
+// ------------------------------------------------------------
+void Application::UpdateFrameStatsOverlay(float deltaTime)
+{
+    if (!frameStatsVisible)
+        return;
+
+    // Scene rebuilds drop HUD entities; re-add the overlay with the same id.
+    std::optional<std::size_t> idx;
+    if (frameStatsId)
+        idx = entityBook.FindIndexById(frameStatsId);
+
+    frameStatsTimer += deltaTime;
+    if (idx.has_value() && frameStatsTimer < FRAME_STATS_HUD_INTERVAL)
+        return;
+    frameStatsTimer = 0.0f;
+
+    const float boxW = 520.0f;
+    const float boxH = 240.0f;
+    const glm::vec3 pos(16.0f, static_cast<float>(clientHeight) - 16.0f - boxH, 0.0f);
+
+    Entity* e = idx.has_value() ? &entityBook.EditEntity(*idx) : nullptr;
+    if (!e)
     {
-        // Selection active: no crosshair lines.
-        for (int i = 0; i < 6; ++i)
+        if (frameStatsId == 0)
         {
-            if (auto* l = FindEntityById(entityBook, cursorCrossId[i]))
-            {
-                l->screenSpace = true;
-                l->line.start = c;
-                l->line.end = c;
-            }
+            assert(nextId < kGridIdBase);
+            frameStatsId = nextId++;
         }
-    }
 
-    // Center box always exists.
-    if (auto* b0 = FindEntityById(entityBook, cursorBoxId[0])) { b0->screenSpace = true; b0->line.start = b00; b0->line.end = b10; }
-    if (auto* b1 = FindEntityById(entityBook, cursorBoxId[1])) { b1->screenSpace = true; b1->line.start = b10; b1->line.end = b11; }
-    if (auto* b2 = FindEntityById(entityBook, cursorBoxId[2])) { b2->screenSpace = true; b2->line.start = b11; b2->line.end = b01; }
-    if (auto* b3 = FindEntityById(entityBook, cursorBoxId[3])) { b3->screenSpace = true; b3->line.start = b01; b3->line.end = b00; }
+        // Highest draw order in the book, so appending keeps it sorted.
+        e = &entityBook.AddEntity(MakeText(frameStatsId, EntityTag::Hud, 960,
+            std::string(), pos,
+            boxW, boxH,
+            false,
+            TextHAlign::Left,
+            0.5f,
+            glm::vec4(0.55f, 1.0f, 0.55f, 1.0f),
+            1.0f,
+            true));
+    }
 
-    // Optional marquee rectangle (screen space)
-    UpdateMarqueeOverlay();
+    e->text.text = FrameProfiler::Format();
+    e->text.position = pos;
 }
 
 
@@ -748,6 +996,8 @@ void Application::UpdateCursorEntities()
 // ------------------------------------------------------------
 void Application::RebuildScene()
 {
+    ScopedCpuTimer cpuTimer("RebuildScene");
+
     const int dragonIterations = 12; // 4096 segments
     const glm::vec3 dragonOriginWorld(0.0f, 0.0f, 0.0f); // TRUE world origin
 
@@ -765,10 +1015,14 @@ void Application::RebuildScene()
     const int drawOrder = 100;
     const float thickness = 2.0f;
 
+    // Same ids for the same drawing on every rebuild (the previous scene is
+    // already removed).
+    uint32_t sceneId = kSceneIdBase;
+
     for (const auto& s : segs)
     {
         entityBook.AddEntity(MakeLine(
-            nextId++,
+            sceneId++,
             EntityTag::Scene,
             drawOrder,
             s.a,
@@ -779,7 +1033,7 @@ void Application::RebuildScene()
     }
 
     // HUD text (unchanged)
-    entityBook.AddEntity(MakeText(nextId++, EntityTag::Hud, 950,
+    entityBook.AddEntity(MakeText(sceneId++, EntityTag::Hud, 950,
         selectionMode ? "Selection: ON (LMB pick)" : "Selection: OFF (Crosshair)",
         glm::vec3(16, 24, 0),
         900, 40,
@@ -839,6 +1093,9 @@ void Application::RebuildGrid()
             return (int)std::ceil(v / (float)step) * step;
         };
 
+    // Grid ids restart at kGridIdBase (the previous grid is gone by now).
+    uint32_t gridId = kGridIdBase;
+
     const int x0 = floorToStep(L, minorStep);
     const int x1 = ceilToStep(R, minorStep);
     const int y0 = floorToStep(T, minorStep);
@@ -860,7 +1117,7 @@ void Application::RebuildGrid()
             color = major;
         }
 
-        entityBook.AddEntity(MakeLine(nextId++, EntityTag::Grid, 0,
+        entityBook.AddEntity(MakeLine(gridId++, EntityTag::Grid, 0,
             glm::vec3((float)x, (float)y0, 0.0f),
             glm::vec3((float)x, (float)y1, 0.0f),
             color, 1.5f, false));
@@ -882,11 +1139,12 @@ void Application::RebuildGrid()
             color = major;
         }
 
-        entityBook.AddEntity(MakeLine(nextId++, EntityTag::Grid, 0,
+        entityBook.AddEntity(MakeLine(gridId++, EntityTag::Grid, 0,
             glm::vec3((float)x0, (float)y, 0.0f),
             glm::vec3((float)x1, (float)y, 0.0f),
             color, 1.5f, false));
     }
+    assert(gridId <= kSceneIdBase);
 
     (void)wipeoutEnabled;
 }
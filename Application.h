@@ -4,9 +4,11 @@
 #include <glm/glm.hpp>
 
 #include "EntityBook.h"
-#include "RGeometryTree.h" // BoundingBox + RGeometryTree
+#include "AsyncGeometryTree.h" // BoundingBox + RGeometryTree, built off-thread
+#include "SnapIndex.h"
 
 #include <optional>
+#include <string>
 #include <vector>
 #include <unordered_map>
 #include <cstddef>
@@ -16,6 +18,9 @@
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <windows.h>
+#else
+// The click handlers take the window for Win32 builds only; unused elsewhere.
+typedef void* HWND;
 #endif
 
 // -----------------------------------------------------------------------------
@@ -27,6 +32,26 @@
 #define SELECTION_BOX_SIZE_PX 12
 #endif
 
+// Hover keeps the candidates of a query this many times larger than the pick
+// box, so small cursor moves are resolved without touching the tree.
+#ifndef HOVER_CACHE_SCALE
+#define HOVER_CACHE_SCALE 4.0f
+#endif
+
+// Object-snap aperture radius (client pixels) and marker half-size.
+#ifndef SNAP_APERTURE_PX
+#define SNAP_APERTURE_PX 10
+#endif
+
+#ifndef SNAP_MARKER_PX
+#define SNAP_MARKER_PX 6
+#endif
+
+// Seconds between refreshes of the frame statistics overlay text.
+#ifndef FRAME_STATS_HUD_INTERVAL
+#define FRAME_STATS_HUD_INTERVAL 0.25f
+#endif
+
 class Application
 {
 public:
@@ -40,6 +65,7 @@ public:
     const glm::mat4& GetProjectionMatrix() const { return projection; }
     const glm::mat4& GetViewMatrix() const { return view; }
     const glm::mat4& GetModelMatrix() const { return model; }
+    glm::ivec2 GetClientSize() const { return { clientWidth, clientHeight }; }
 
     // Input
     void SetMouseClient(int x, int y) { mouseClient = { x, y }; }
@@ -58,6 +84,11 @@ public:
     void ToggleSelectionMode();
     void ToggleGrid();
     void ToggleWipeout();
+    void ToggleObjectSnap();
+
+    // Rolling FrameProfiler numbers as HUD text (top left).
+    void ToggleFrameStats();
+    bool IsFrameStatsVisible() const { return frameStatsVisible; }
 
     // Click handlers
     void OnLeftClick();
@@ -71,22 +102,55 @@ public:
 
     EntityBook& GetEntityBook() { return entityBook; }
 
+    // Cursor overlay (crosshair, pick box, marquee, snap marker) in Y-up client
+    // pixels, rebuilt by Update(). Not part of the book: draw it each frame with
+    // an immediate-mode pass so cursor motion never touches retained batches.
+    const std::vector<LineEntity>& GetOverlayLines() const { return overlayLines; }
+
+    // Current object snap under the cursor (crosshair mode only).
+    const std::optional<SnapResult>& GetActiveSnap() const { return activeSnap; }
+
+    // True while the pick tree is being rebuilt in the background; hover/pick
+    // results may miss entities added since the last finished build.
+    bool IsPickTreeStale() const { return pickTree.IsStale(); }
+
+    // True while Update() still has background results to pick up, so the
+    // caller keeps scheduling frames even without input.
+    bool HasPendingWork() const { return pickTree.IsStale(); }
+
+    // Sidecar file for the persisted pick index of the current drawing. When set,
+    // a matching index is memory-mapped on scene load instead of being rebuilt,
+    // and rebuilt trees are written back in the background.
+    void SetPickIndexPath(const std::string& path) { pickIndexPath = path; }
+
 private:
     // Scene lifecycle
     void MarkAllDirty();
+    void MarkViewDirty();
     void RebuildScene();
     void RebuildGrid();
 
     // Cursor overlay
-    void EnsureCursorEntities();
-    void UpdateCursorEntities();
+    void BuildOverlay();
+    void AddOverlayLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color = glm::vec4(1.0f));
+
+    // Frame statistics overlay
+    void UpdateFrameStatsOverlay(float deltaTime);
 
     // Picking / hover
     void EnsurePickTree();
     void BuildPickTree();
+    std::optional<std::size_t> PickAt(const glm::vec2& world, bool* stale = nullptr) const;
+    BoundingBox PickBox(const glm::vec2& world, float scale = 1.0f) const;
+    bool PickBoxHits(const Entity& e, const BoundingBox& box) const;
     void UpdateHover();
     void ClearHover();
 
+    // Object snap
+    void EnsureSnapIndex();
+    void UpdateSnap();
+    void AppendSnapMarker();
+
 // Selection helpers
 void ClearSelection();
 void ApplySelection(const std::vector<std::size_t>& indices);
@@ -94,7 +158,7 @@ void ApplySelection(const std::vector<std::size_t>& indices);
 // Marquee selection
 void BeginMarquee();
 void FinishMarqueeSelect();
-void UpdateMarqueeOverlay();
+void AppendMarqueeOverlay();
 
 glm::vec2 WorldToClient(const glm::vec2& world) const;
 
@@ -140,24 +204,61 @@ private:
     bool selectionMode = false;
     bool gridEnabled = true;
     bool wipeoutEnabled = true;
+    bool snapEnabled = true;
 
     // Dirty flags
     bool dirtyScene = true;
+    bool dirtyGrid = true;
     bool dirtyPickTree = true;
+    bool dirtySnapIndex = true;
 
-    // Picking structure
-    RGeometryTree pickTree;
+    // Picking structure (payload = entity id; boxes are unpadded so the tree is
+    // zoom-independent and only scene edits require a rebuild)
+    AsyncGeometryTree pickTree;
+    std::string pickIndexPath;
 
     std::optional<std::size_t> hoveredIndex;
     glm::vec4 hoveredPrevColor{ 1,1,1,1 };
 
-    // Cursor entity ids (screen space)
-    bool cursorEntitiesValid = false;
-    uint32_t cursorCrossId[6]{ 0,0,0,0,0,0 };
-    uint32_t cursorBoxId[4]{ 0,0,0,0 };
-    uint32_t marqueeBoxId[4]{ 0,0,0,0 };
-
-    // Entity IDs
+    // Hover coherence: the last resolved (mouse world, zoom, tree generation) key,
+    // and candidate ids from an inflated query around an earlier position.
+    bool hoverKeyValid = false;
+    glm::vec2 hoverKeyWorld{ 0.0f, 0.0f };
+    float hoverKeyZoom = 0.0f;
+    uint64_t hoverKeyGeneration = 0;
+
+    bool hoverCacheValid = false;
+    BoundingBox hoverCacheBox;
+    float hoverCacheZoom = 0.0f;
+    uint64_t hoverCacheGeneration = 0;
+    std::vector<std::size_t> hoverCandidates;
+
+    // Object snap (keyed by entity id, synced incrementally from the book)
+    SnapIndex snapIndex;
+    std::optional<SnapResult> activeSnap;
+
+    // activeSnap was resolved for this (mouse world, zoom, index generation).
+    bool snapKeyValid = false;
+    glm::vec2 snapKeyWorld{ 0.0f, 0.0f };
+    float snapKeyZoom = 0.0f;
+    uint64_t snapKeyGeneration = 0;
+
+    // Cursor overlay lines (screen space, Y-up)
+    std::vector<LineEntity> overlayLines;
+
+    // Frame statistics overlay (screen space text, refreshed periodically)
+    bool frameStatsVisible = false;
+    float frameStatsTimer = 0.0f;
+    uint32_t frameStatsId = 0;
+
+    // Entity IDs, in fixed ranges. RebuildScene numbers the scene from
+    // kSceneIdBase every time, so the same drawing keeps the same ids across
+    // rebuilds and launches (the snap index and the persisted pick index are
+    // keyed on them). RebuildGrid numbers the grid from kGridIdBase after the
+    // old grid is removed, so panning and zooming use up no ids. The rest
+    // (frame stats) takes nextId, below both.
+    static constexpr uint32_t kGridIdBase = 1u << 30;
+    static constexpr uint32_t kSceneIdBase = 1u << 31;
     uint32_t nextId = 1;
 
     // Matrices
@@ -0,0 +1,180 @@
+// AsyncGeometryTree.cpp
+#include "AsyncGeometryTree.h"
+
+#include <chrono>
+#include <cstdio>
+
+AsyncGeometryTree::AsyncGeometryTree()
+{
+    m_worker = std::thread(&AsyncGeometryTree::WorkerMain, this);
+}
+
+AsyncGeometryTree::~AsyncGeometryTree()
+{
+    // Drop an adopted mapping first, so a finished build waiting to persist can
+    // still replace the file on the way out.
+    m_frontFlat.reset();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ready)
+        {
+            m_polledGeneration = m_readyGeneration;
+            m_polledCurrent = m_readyGeneration > m_frontGeneration;
+        }
+        m_quit = true;
+    }
+    m_wake.notify_one();
+
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void AsyncGeometryTree::RequestBuild(Items items, std::string persistPath, std::uint64_t contentHash)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = std::move(items);
+        m_pendingGeneration = ++m_requestedGeneration;
+        m_pendingPersistPath = std::move(persistPath);
+        m_pendingHash = contentHash;
+        m_hasPending = true;
+    }
+    m_wake.notify_one();
+}
+
+void AsyncGeometryTree::Adopt(std::shared_ptr<const FlatGeometryIndex> index, bool current)
+{
+    if (current)
+    {
+        // Counts as a finished build of a new snapshot; anything still in flight
+        // on the worker is older and will be dropped by Poll().
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frontGeneration = ++m_requestedGeneration;
+    }
+
+    m_front.reset();
+    m_frontFlat = std::move(index);
+    ++m_frontSerial;
+}
+
+bool AsyncGeometryTree::Poll()
+{
+    std::shared_ptr<const RGeometryTree> ready;
+    std::uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_ready)
+            return false;
+        ready = std::move(m_ready);
+        generation = m_readyGeneration;
+    }
+
+    // An older build can finish after a newer one was published; keep the newest.
+    const bool newer = generation > m_frontGeneration;
+    if (newer)
+    {
+        m_front = std::move(ready);
+        m_frontFlat.reset();
+        m_frontGeneration = generation;
+        ++m_frontSerial;
+    }
+
+    // The mapping is gone now; the worker may write this build's file.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_polledGeneration = generation;
+        m_polledCurrent = newer;
+    }
+    m_wake.notify_one();
+    return newer;
+}
+
+AsyncGeometryTree::QueryResult AsyncGeometryTree::QueryFirstIntersect(const BoundingBox& box) const
+{
+    QueryResult r;
+    r.stale = IsStale();
+    if (m_front)
+        r.hit = m_front->QueryFirstIntersect(box);
+    else if (m_frontFlat)
+        r.hit = m_frontFlat->QueryFirstIntersect(box);
+    return r;
+}
+
+bool AsyncGeometryTree::QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const
+{
+    if (m_front)
+        m_front->QueryIntersects(box, out);
+    else if (m_frontFlat)
+        m_frontFlat->QueryIntersects(box, out);
+    return IsStale();
+}
+
+void AsyncGeometryTree::WorkerMain()
+{
+    for (;;)
+    {
+        Items items;
+        std::uint64_t generation = 0;
+        std::string persistPath;
+        std::uint64_t contentHash = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_quit || m_hasPending; });
+            if (m_quit)
+                return;
+
+            items = std::move(m_pending);
+            m_pending.clear();
+            generation = m_pendingGeneration;
+            persistPath = std::move(m_pendingPersistPath);
+            m_pendingPersistPath.clear();
+            contentHash = m_pendingHash;
+            m_hasPending = false;
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+
+        auto tree = std::make_shared<RGeometryTree>();
+        if (!items.empty())
+            tree->Build(items);
+
+#if _DEBUG
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::printf("[PickTree] generation %llu: %zu items built in %.2f ms (background)\n",
+            (unsigned long long)generation, items.size(), ms);
+#else
+        (void)t0;
+#endif
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // A newer snapshot may already be queued; publishing this one still
+            // beats serving an even older tree in the meantime.
+            if (generation > m_readyGeneration)
+            {
+                m_ready = std::move(tree);
+                m_readyGeneration = generation;
+            }
+        }
+
+        // Persisting is off the critical path, but waits for Poll() to take the
+        // tree: until then the front may be a mapping of the file being replaced.
+        // A build that was outdated by then is not written.
+        if (!persistPath.empty())
+        {
+            bool current = false;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]() { return m_quit || m_polledGeneration >= generation; });
+                current = m_polledGeneration == generation && m_polledCurrent;
+            }
+
+            if (current)
+            {
+                const auto flat = FlatGeometryIndex::Build(items, contentHash);
+                if (!flat->WriteFile(persistPath))
+                    std::printf("[PickTree] failed to write index '%s'\n", persistPath.c_str());
+            }
+        }
+    }
+}
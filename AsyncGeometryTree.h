@@ -0,0 +1,95 @@
+// AsyncGeometryTree.h
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RGeometryTree.h"
+#include "FlatGeometryIndex.h"
+
+// Double-buffered RGeometryTree.
+//
+// RequestBuild() hands a snapshot of (box, payload) items to a worker thread and
+// returns immediately. Queries keep hitting the current (front) tree until
+// Poll() finds a finished build and swaps it in. Only the UI thread touches the
+// front tree, so queries never lock; the worker publishes through m_mutex.
+// If several builds are requested while one is running, only the latest
+// snapshot is built.
+//
+// The front can also be a FlatGeometryIndex mapped from disk (Adopt), which makes
+// picking available right after load; a build request with a persist path writes
+// the flat image of the finished build back to disk from the worker, once Poll()
+// has swapped the build in (and so released an adopted mapping of the old file,
+// which Windows won't replace while a view of it is mapped).
+class AsyncGeometryTree
+{
+public:
+    using Items = std::vector<std::pair<BoundingBox, std::size_t>>;
+
+    struct QueryResult
+    {
+        std::optional<std::size_t> hit;
+        bool stale = false; // a newer build is pending; the answer may be out of date
+    };
+
+    AsyncGeometryTree();
+    ~AsyncGeometryTree();
+
+    AsyncGeometryTree(const AsyncGeometryTree&) = delete;
+    AsyncGeometryTree& operator=(const AsyncGeometryTree&) = delete;
+
+    // persistPath: if non-empty, the worker also writes a FlatGeometryIndex image
+    // (tagged with contentHash) there after the tree is published.
+    void RequestBuild(Items items, std::string persistPath = {}, std::uint64_t contentHash = 0);
+
+    // Serve queries from a prebuilt flat index. current = it matches the latest
+    // snapshot (no build needed); otherwise it only fills in until a build lands.
+    void Adopt(std::shared_ptr<const FlatGeometryIndex> index, bool current);
+
+    bool HasIndex() const { return m_front || m_frontFlat; }
+
+    // Swap in a finished build, if any. Returns true when the front tree changed.
+    bool Poll();
+
+    // True while the front tree is older than the last requested snapshot.
+    bool IsStale() const { return m_frontGeneration != m_requestedGeneration; }
+
+    // Changes whenever the front index is replaced (0 = none yet).
+    std::uint64_t GetGeneration() const { return m_frontSerial; }
+
+    QueryResult QueryFirstIntersect(const BoundingBox& box) const;
+
+    // Appends every intersecting payload to out. Returns true if the answer may be stale.
+    bool QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const;
+
+private:
+    void WorkerMain();
+
+    std::shared_ptr<const RGeometryTree> m_front;
+    std::shared_ptr<const FlatGeometryIndex> m_frontFlat;
+    std::uint64_t m_frontGeneration = 0;
+    std::uint64_t m_frontSerial = 0;
+    std::uint64_t m_requestedGeneration = 0;
+
+    // Shared with the worker (guarded by m_mutex)
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+    bool m_hasPending = false;
+    Items m_pending;
+    std::uint64_t m_pendingGeneration = 0;
+    std::string m_pendingPersistPath;
+    std::uint64_t m_pendingHash = 0;
+    std::shared_ptr<const RGeometryTree> m_ready;
+    std::uint64_t m_readyGeneration = 0;
+    std::uint64_t m_polledGeneration = 0; // last build Poll() took
+    bool m_polledCurrent = false;         // ... and swapped in (it may persist)
+
+    std::thread m_worker;
+};
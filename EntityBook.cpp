@@ -4,13 +4,19 @@
 
 Entity& EntityBook::AddEntity(const Entity& e)
 {
+    TouchLayout(e.tag);
     entities.push_back(e);
+    if (indexByIdValid)
+        indexById[e.id] = entities.size() - 1;
     return entities.back();
 }
 
 void EntityBook::Clear()
 {
+    TouchAll();
     entities.clear();
+    indexById.clear();
+    indexByIdValid = true;
 }
 
 const std::vector<Entity>& EntityBook::GetEntities() const
@@ -18,14 +24,60 @@ const std::vector<Entity>& EntityBook::GetEntities() const
     return entities;
 }
 
+Entity& EntityBook::EditEntity(std::size_t index)
+{
+    Entity& e = entities[index];
+    Touch(e.tag);
+
+    if (editLog.size() < ENTITY_BOOK_EDIT_LOG)
+        editLog.push_back(e.id);
+    else
+        editLog[editCount % ENTITY_BOOK_EDIT_LOG] = e.id;
+    ++editCount;
+    return e;
+}
+
+bool EntityBook::GetEditsSince(uint64_t since, std::vector<std::size_t>& out) const
+{
+    if (since > editCount || editCount - since > editLog.size())
+        return false;
+
+    for (uint64_t n = since; n < editCount; ++n)
+        out.push_back(editLog[n % ENTITY_BOOK_EDIT_LOG]);
+    return true;
+}
+
 std::vector<Entity>& EntityBook::GetEntitiesMutable()
 {
+    TouchAll();
     return entities;
 }
 
+void EntityBook::TouchAll()
+{
+    for (std::size_t t = 0; t < kEntityTagCount; ++t)
+        TouchLayout((EntityTag)t);
+}
+
 // Stable sort so insertion order is preserved within a drawOrder.
 void EntityBook::SortByDrawOrder()
 {
+    // Order of each tag's entities (a hash of their id sequence) before and
+    // after; a tag whose entities only moved relative to other tags' is unchanged.
+    auto orderHashes = [this](uint64_t (&out)[kEntityTagCount])
+        {
+            for (uint64_t& h : out)
+                h = 1469598103934665603ull;
+            for (const Entity& e : entities)
+            {
+                uint64_t& h = out[(std::size_t)e.tag];
+                h = (h ^ (uint64_t)e.id) * 1099511628211ull;
+            }
+        };
+
+    uint64_t before[kEntityTagCount];
+    orderHashes(before);
+
     std::stable_sort(entities.begin(), entities.end(),
         [](const Entity& a, const Entity& b)
         {
@@ -49,4 +101,41 @@ void EntityBook::SortByDrawOrder()
 
             return a.id < b.id;
         });
+    indexByIdValid = false;
+
+    uint64_t after[kEntityTagCount];
+    orderHashes(after);
+    for (std::size_t t = 0; t < kEntityTagCount; ++t)
+    {
+        if (before[t] != after[t])
+            TouchLayout((EntityTag)t);
+    }
+}
+
+std::optional<std::size_t> EntityBook::FindIndexById(std::size_t id) const
+{
+    auto rebuild = [this]()
+        {
+            indexById.clear();
+            indexById.reserve(entities.size());
+            for (std::size_t i = 0; i < entities.size(); ++i)
+                indexById[entities[i].id] = i;
+            indexByIdValid = true;
+        };
+
+    if (!indexByIdValid)
+        rebuild();
+
+    auto it = indexById.find(id);
+    if (it == indexById.end())
+        return std::nullopt;
+    if (it->second < entities.size() && entities[it->second].id == id)
+        return it->second;
+
+    // Ids edited through GetEntitiesMutable() bypass the cache; resync once.
+    rebuild();
+    it = indexById.find(id);
+    if (it == indexById.end())
+        return std::nullopt;
+    return it->second;
 }
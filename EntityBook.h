@@ -1,8 +1,26 @@
 // EntityBook.h
 #pragma once
 #include <vector>
+#include <optional>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
 #include "Entity.h"
 
+// Number of EntityTag values (versions are kept per tag).
+constexpr std::size_t kEntityTagCount = 4;
+
+#ifndef ENTITY_BOOK_EDIT_LOG
+// EditEntity calls remembered for GetEditsSince(); a reader that falls further
+// behind than this has to resync from scratch.
+#define ENTITY_BOOK_EDIT_LOG 4096
+#endif
+
+// Every change made through the book bumps the version of the tags it touches
+// (added, removed, edited or reordered entities), so consumers such as the
+// renderer can tell which kinds of content changed since they last looked.
+// Edits through EditEntity are also logged by id, so a consumer can redo just
+// the edited entities as long as the tag's layout version did not move.
 class EntityBook
 {
 public:
@@ -13,19 +31,68 @@ public:
     template <typename Pred>
     void RemoveIf(Pred&& pred)
     {
-        entities.erase(
-            std::remove_if(entities.begin(), entities.end(), std::forward<Pred>(pred)),
-            entities.end()
-        );
+        auto first = std::remove_if(entities.begin(), entities.end(), [&](const Entity& e)
+            {
+                if (!pred(e))
+                    return false;
+                TouchLayout(e.tag);
+                return true;
+            });
+        if (first == entities.end())
+            return;
+
+        entities.erase(first, entities.end());
+        indexByIdValid = false;
     }
 
     void Clear();
 
     const std::vector<Entity>& GetEntities() const;
+
+    // Mutable access to one entity; counts as an edit of its tag and is logged.
+    // Don't change id, tag, screenSpace or drawOrder through it (remove and
+    // re-add instead).
+    Entity& EditEntity(std::size_t index);
+
+    // Unversioned bulk access: counts as an edit of every tag.
     std::vector<Entity>& GetEntitiesMutable();
 
+    // Only tags whose entities actually change relative order are bumped.
     void SortByDrawOrder();
 
+    // Changes at least once whenever an entity with this tag changes.
+    uint64_t GetVersion(EntityTag tag) const { return versions[(std::size_t)tag]; }
+
+    // Like GetVersion, but EditEntity leaves it alone: changes only when
+    // entities with this tag are added, removed, reordered or bulk-edited.
+    uint64_t GetLayoutVersion(EntityTag tag) const { return layoutVersions[(std::size_t)tag]; }
+
+    // EditEntity calls so far.
+    uint64_t GetEditCount() const { return editCount; }
+
+    // Appends the ids edited since GetEditCount() returned `since`, oldest
+    // first (repeats included). False when the log no longer reaches back that
+    // far; out is left untouched then.
+    bool GetEditsSince(uint64_t since, std::vector<std::size_t>& out) const;
+
+    // Current index of an entity id. The id->index map is rebuilt lazily after
+    // the book is reordered or resized, so repeated lookups are O(1).
+    std::optional<std::size_t> FindIndexById(std::size_t id) const;
+
+private:
+    void Touch(EntityTag tag) { ++versions[(std::size_t)tag]; }
+    void TouchLayout(EntityTag tag) { Touch(tag); ++layoutVersions[(std::size_t)tag]; }
+    void TouchAll();
+
 private:
     std::vector<Entity> entities;
+    uint64_t versions[kEntityTagCount]{};
+    uint64_t layoutVersions[kEntityTagCount]{};
+
+    // Ring of the last ENTITY_BOOK_EDIT_LOG edited ids; edit n is at n % size.
+    std::vector<std::size_t> editLog;
+    uint64_t editCount = 0;
+
+    mutable std::unordered_map<std::size_t, std::size_t> indexById;
+    mutable bool indexByIdValid = false;
 };
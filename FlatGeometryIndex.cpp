@@ -0,0 +1,443 @@
+// FlatGeometryIndex.cpp
+#include "FlatGeometryIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr char kMagic[8] = { 'V', 'K', 'P', 'I', 'C', 'K', '\0', '\0' };
+
+    uint64_t Mix64(uint64_t x)
+    {
+        // splitmix64 finalizer
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t FloatPair(float a, float b)
+    {
+        uint32_t ua = 0, ub = 0;
+        std::memcpy(&ua, &a, sizeof(ua));
+        std::memcpy(&ub, &b, sizeof(ub));
+        return (uint64_t(ua) << 32) | ub;
+    }
+
+    // Position of (x, y) along a Hilbert curve on a 2^16 x 2^16 grid.
+    uint32_t HilbertIndex(uint32_t x, uint32_t y)
+    {
+        uint32_t d = 0;
+        for (uint32_t s = 1u << 15; s > 0; s >>= 1)
+        {
+            const uint32_t rx = (x & s) ? 1u : 0u;
+            const uint32_t ry = (y & s) ? 1u : 0u;
+            d += s * s * ((3u * rx) ^ ry);
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    bool Overlaps(float minX, float minY, float maxX, float maxY, const BoundingBox& b)
+    {
+        return !(maxX < b.minX || minX > b.maxX || maxY < b.minY || minY > b.maxY);
+    }
+}
+
+// ------------------------------------------------------------
+// Platform file mapping
+// ------------------------------------------------------------
+struct FlatGeometryIndex::Mapping
+{
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#else
+    std::size_t length = 0;
+#endif
+    void* view = nullptr;
+
+    ~Mapping()
+    {
+#ifdef _WIN32
+        if (view)
+            UnmapViewOfFile(view);
+        if (mapping)
+            CloseHandle(mapping);
+#else
+        if (view)
+            munmap(view, length);
+#endif
+    }
+
+    static Mapping* Open(const std::string& path, std::size_t& outSize)
+    {
+        outSize = 0;
+#ifdef _WIN32
+        // FILE_SHARE_DELETE only covers this handle, which is closed right below;
+        // a mapped view still keeps the file from being replaced, so the owner
+        // releases the mapping before a new image is renamed over it.
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+        {
+            CloseHandle(file);
+            return nullptr;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file); // the mapping keeps the file open
+        if (!mapping)
+            return nullptr;
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(mapping);
+            return nullptr;
+        }
+
+        auto* m = new Mapping();
+        m->mapping = mapping;
+        m->view = view;
+        outSize = static_cast<std::size_t>(size.QuadPart);
+        return m;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* view = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file open
+        if (view == MAP_FAILED)
+            return nullptr;
+
+        auto* m = new Mapping();
+        m->view = view;
+        m->length = static_cast<std::size_t>(st.st_size);
+        outSize = m->length;
+        return m;
+#endif
+    }
+};
+
+// ------------------------------------------------------------
+// Build / open / write
+// ------------------------------------------------------------
+FlatGeometryIndex::~FlatGeometryIndex()
+{
+    delete m_mapping;
+}
+
+uint64_t FlatGeometryIndex::ComputeHash(const Items& items)
+{
+    // Sum of per-item hashes: independent of item order, O(n), no sort.
+    uint64_t sum = 0;
+    for (const auto& it : items)
+    {
+        const BoundingBox& b = it.first;
+        uint64_t h = Mix64(FloatPair(b.minX, b.minY));
+        h = Mix64(h ^ FloatPair(b.maxX, b.maxY));
+        h = Mix64(h ^ static_cast<uint64_t>(it.second));
+        sum += h;
+    }
+    return Mix64(sum ^ Mix64(static_cast<uint64_t>(items.size())));
+}
+
+std::shared_ptr<FlatGeometryIndex> FlatGeometryIndex::Build(const Items& items, uint64_t contentHash)
+{
+    const std::size_t n = items.size();
+
+    // Level sizes up to a single root.
+    std::vector<std::size_t> levelCounts;
+    for (std::size_t c = n; c > 1 || levelCounts.empty(); )
+    {
+        c = (c + kNodeSize - 1) / kNodeSize;
+        levelCounts.push_back(c);
+        if (c <= 1)
+            break;
+    }
+    std::size_t nodeCount = 0;
+    if (n > 0)
+        for (std::size_t c : levelCounts)
+            nodeCount += c;
+
+    const std::size_t bytes = sizeof(Header) + n * sizeof(Item) + nodeCount * sizeof(Node);
+
+    std::shared_ptr<FlatGeometryIndex> index(new FlatGeometryIndex());
+    index->m_owned.assign((bytes + 7) / 8, 0);
+    index->m_data = reinterpret_cast<const uint8_t*>(index->m_owned.data());
+    index->m_size = bytes;
+
+    uint8_t* base = reinterpret_cast<uint8_t*>(index->m_owned.data());
+    Header& header = *reinterpret_cast<Header*>(base);
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.nodeCount = static_cast<uint32_t>(nodeCount);
+    header.contentHash = contentHash;
+    header.itemCount = n;
+    header.rootIndex = nodeCount ? static_cast<uint32_t>(nodeCount - 1) : 0;
+    header.nodeSize = kNodeSize;
+
+    if (n == 0)
+        return index;
+
+    // Hilbert-sort items by box center so consecutive runs are spatially tight.
+    float minX = items[0].first.minX, minY = items[0].first.minY;
+    float maxX = items[0].first.maxX, maxY = items[0].first.maxY;
+    for (const auto& it : items)
+    {
+        minX = std::min(minX, it.first.minX);
+        minY = std::min(minY, it.first.minY);
+        maxX = std::max(maxX, it.first.maxX);
+        maxY = std::max(maxY, it.first.maxY);
+    }
+    const float sx = (maxX > minX) ? 65535.0f / (maxX - minX) : 0.0f;
+    const float sy = (maxY > minY) ? 65535.0f / (maxY - minY) : 0.0f;
+
+    std::vector<std::pair<uint32_t, uint32_t>> order(n); // (hilbert, item)
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const BoundingBox& b = items[i].first;
+        const float cx = 0.5f * (b.minX + b.maxX);
+        const float cy = 0.5f * (b.minY + b.maxY);
+        order[i] = { HilbertIndex(static_cast<uint32_t>((cx - minX) * sx), static_cast<uint32_t>((cy - minY) * sy)),
+                     static_cast<uint32_t>(i) };
+    }
+    std::sort(order.begin(), order.end());
+
+    Item* outItems = reinterpret_cast<Item*>(base + sizeof(Header));
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const auto& src = items[order[i].second];
+        outItems[i] = { src.first.minX, src.first.minY, src.first.maxX, src.first.maxY, static_cast<uint64_t>(src.second) };
+    }
+
+    // Pack levels bottom-up; each node covers kNodeSize consecutive children.
+    Node* outNodes = reinterpret_cast<Node*>(base + sizeof(Header) + n * sizeof(Item));
+    std::size_t childBegin = 0, childCount = n, nodeAt = 0;
+    for (std::size_t level = 0; level < levelCounts.size(); ++level)
+    {
+        const std::size_t levelBegin = nodeAt;
+        for (std::size_t c = 0; c < childCount; c += kNodeSize)
+        {
+            const std::size_t count = std::min<std::size_t>(kNodeSize, childCount - c);
+            Node node{};
+            node.first = static_cast<uint32_t>(childBegin + c);
+            node.count = static_cast<uint16_t>(count);
+            node.level = static_cast<uint16_t>(level);
+            node.minX = node.minY = std::numeric_limits<float>::max();
+            node.maxX = node.maxY = std::numeric_limits<float>::lowest();
+
+            for (std::size_t k = 0; k < count; ++k)
+            {
+                float cminX, cminY, cmaxX, cmaxY;
+                if (level == 0)
+                {
+                    const Item& ch = outItems[childBegin + c + k];
+                    cminX = ch.minX; cminY = ch.minY; cmaxX = ch.maxX; cmaxY = ch.maxY;
+                }
+                else
+                {
+                    const Node& ch = outNodes[childBegin + c + k];
+                    cminX = ch.minX; cminY = ch.minY; cmaxX = ch.maxX; cmaxY = ch.maxY;
+                }
+                node.minX = std::min(node.minX, cminX);
+                node.minY = std::min(node.minY, cminY);
+                node.maxX = std::max(node.maxX, cmaxX);
+                node.maxY = std::max(node.maxY, cmaxY);
+            }
+
+            outNodes[nodeAt++] = node;
+        }
+
+        childBegin = levelBegin;
+        childCount = nodeAt - levelBegin;
+    }
+
+    return index;
+}
+
+std::shared_ptr<FlatGeometryIndex> FlatGeometryIndex::Open(const std::string& path)
+{
+    std::size_t size = 0;
+    Mapping* mapping = Mapping::Open(path, size);
+    if (!mapping)
+        return nullptr;
+
+    std::shared_ptr<FlatGeometryIndex> index(new FlatGeometryIndex());
+    index->m_mapping = mapping;
+    index->m_data = static_cast<const uint8_t*>(mapping->view);
+    index->m_size = size;
+
+    if (!index->Validate())
+    {
+        std::printf("[FlatGeometryIndex] ignoring malformed index file '%s'\n", path.c_str());
+        return nullptr;
+    }
+
+    return index;
+}
+
+bool FlatGeometryIndex::WriteFile(const std::string& path) const
+{
+    const std::string tmp = path + ".tmp";
+
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+
+    const bool written = std::fwrite(m_data, 1, m_size, f) == m_size;
+    const bool closed = std::fclose(f) == 0;
+
+    std::error_code ec;
+    if (!written || !closed)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool FlatGeometryIndex::Validate() const
+{
+    if (!m_data || m_size < sizeof(Header))
+        return false;
+
+    const Header& h = GetHeader();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.nodeSize != kNodeSize)
+        return false;
+
+    const uint64_t expected = sizeof(Header) + h.itemCount * sizeof(Item) + uint64_t(h.nodeCount) * sizeof(Node);
+    if (expected != m_size)
+        return false;
+
+    if (h.itemCount == 0)
+        return h.nodeCount == 0;
+
+    if (h.nodeCount == 0 || h.rootIndex != h.nodeCount - 1)
+        return false;
+
+    // Child ranges must stay inside the image, or a corrupt file could walk off the end.
+    const Node* nodes = GetNodes();
+    for (uint32_t i = 0; i < h.nodeCount; ++i)
+    {
+        const Node& node = nodes[i];
+        const uint64_t limit = (node.level == 0) ? h.itemCount : i;
+        if (node.count == 0 || uint64_t(node.first) + node.count > limit)
+            return false;
+    }
+    return true;
+}
+
+uint64_t FlatGeometryIndex::GetContentHash() const
+{
+    return GetHeader().contentHash;
+}
+
+std::size_t FlatGeometryIndex::GetItemCount() const
+{
+    return static_cast<std::size_t>(GetHeader().itemCount);
+}
+
+// ------------------------------------------------------------
+// Queries
+// ------------------------------------------------------------
+template <typename Visit>
+void FlatGeometryIndex::Query(const BoundingBox& box, Visit&& visit) const
+{
+    const Header& h = GetHeader();
+    if (h.nodeCount == 0)
+        return;
+
+    const Item* items = GetItems();
+    const Node* nodes = GetNodes();
+
+    // Depth-first; at most (kNodeSize - 1) siblings pending per level.
+    uint32_t stack[kNodeSize * 32];
+    int top = 0;
+    stack[top++] = h.rootIndex;
+
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (!Overlaps(node.minX, node.minY, node.maxX, node.maxY, box))
+            continue;
+
+        if (node.level == 0)
+        {
+            for (uint32_t k = 0; k < node.count; ++k)
+            {
+                const Item& it = items[node.first + k];
+                if (Overlaps(it.minX, it.minY, it.maxX, it.maxY, box) && !visit(it.payload))
+                    return;
+            }
+            continue;
+        }
+
+        // Push in reverse so children are visited in stored (Hilbert) order.
+        for (uint32_t k = node.count; k-- > 0; )
+            if (top < static_cast<int>(kNodeSize * 32))
+                stack[top++] = node.first + k;
+    }
+}
+
+std::optional<std::size_t> FlatGeometryIndex::QueryFirstIntersect(const BoundingBox& box) const
+{
+    std::optional<std::size_t> hit;
+    Query(box, [&hit](uint64_t payload)
+        {
+            hit = static_cast<std::size_t>(payload);
+            return false;
+        });
+    return hit;
+}
+
+void FlatGeometryIndex::QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const
+{
+    Query(box, [&out](uint64_t payload)
+        {
+            out.push_back(static_cast<std::size_t>(payload));
+            return true;
+        });
+}
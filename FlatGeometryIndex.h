@@ -0,0 +1,104 @@
+// FlatGeometryIndex.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BoundingBox.h"
+
+// Packed, read-only 2D R-tree stored as one flat, relocatable byte image:
+//
+//   [Header][Item x itemCount][Node x nodeCount]
+//
+// Items are Hilbert-sorted leaf boxes with their payload; nodes reference their
+// children by index (never by pointer), level 0 first, root last. The same image
+// is written to disk and can be memory-mapped and queried in place on open, so a
+// saved drawing gets picking without rebuilding anything.
+//
+// contentHash identifies the (box, payload) set the index was built from; callers
+// compare it to the hash of the live items to detect a stale file.
+class FlatGeometryIndex
+{
+public:
+    using Items = std::vector<std::pair<BoundingBox, std::size_t>>;
+
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kNodeSize = 16;
+
+    ~FlatGeometryIndex();
+
+    FlatGeometryIndex(const FlatGeometryIndex&) = delete;
+    FlatGeometryIndex& operator=(const FlatGeometryIndex&) = delete;
+
+    // Order-independent hash of the items (x/y extents and payload).
+    static uint64_t ComputeHash(const Items& items);
+
+    // Builds an in-memory image (same layout as the file).
+    static std::shared_ptr<FlatGeometryIndex> Build(const Items& items, uint64_t contentHash);
+
+    // Maps an index file read-only. Returns nullptr if missing or malformed.
+    static std::shared_ptr<FlatGeometryIndex> Open(const std::string& path);
+
+    // Writes the image to path (via a temp file + rename). Returns false on failure,
+    // which on Windows includes path being mapped (Open) at the time.
+    bool WriteFile(const std::string& path) const;
+
+    uint64_t GetContentHash() const;
+    std::size_t GetItemCount() const;
+    bool IsMapped() const { return m_mapping != nullptr; }
+
+    std::optional<std::size_t> QueryFirstIntersect(const BoundingBox& box) const;
+    void QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const;
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t nodeCount;
+        uint64_t contentHash;
+        uint64_t itemCount;
+        uint32_t rootIndex;
+        uint32_t nodeSize;
+    };
+
+    struct Item
+    {
+        float minX, minY, maxX, maxY;
+        uint64_t payload;
+    };
+
+    struct Node
+    {
+        float minX, minY, maxX, maxY;
+        uint32_t first;   // first child (item index on level 0, node index above)
+        uint16_t count;
+        uint16_t level;
+    };
+
+    static_assert(sizeof(Header) == 40, "FlatGeometryIndex header layout");
+    static_assert(sizeof(Item) == 24, "FlatGeometryIndex item layout");
+    static_assert(sizeof(Node) == 24, "FlatGeometryIndex node layout");
+
+    struct Mapping; // platform file mapping (Win32 / POSIX)
+
+    FlatGeometryIndex() = default;
+
+    bool Validate() const;
+
+    const Header& GetHeader() const { return *reinterpret_cast<const Header*>(m_data); }
+    const Item* GetItems() const { return reinterpret_cast<const Item*>(m_data + sizeof(Header)); }
+    const Node* GetNodes() const { return reinterpret_cast<const Node*>(m_data + sizeof(Header) + GetHeader().itemCount * sizeof(Item)); }
+
+    template <typename Visit>
+    void Query(const BoundingBox& box, Visit&& visit) const;
+
+    const uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+
+    std::vector<uint64_t> m_owned;    // in-memory image (8-byte aligned)
+    Mapping* m_mapping = nullptr;     // mapped image
+};
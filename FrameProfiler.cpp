@@ -0,0 +1,240 @@
+// FrameProfiler.cpp
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+
+// ------------------------------------------------------------
+// FrameStats
+// ------------------------------------------------------------
+void FrameStats::Add(double ms)
+{
+    last = ms;
+    if (samples.size() < FRAME_STATS_WINDOW)
+    {
+        samples.push_back(ms);
+        return;
+    }
+
+    samples[next] = ms;
+    next = (next + 1) % samples.size();
+}
+
+void FrameStats::Clear()
+{
+    samples.clear();
+    next = 0;
+    last = 0.0;
+}
+
+double FrameStats::GetMin() const
+{
+    return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end());
+}
+
+double FrameStats::GetAvg() const
+{
+    if (samples.empty())
+        return 0.0;
+
+    double total = 0.0;
+    for (double ms : samples)
+        total += ms;
+    return total / (double)samples.size();
+}
+
+double FrameStats::GetP99() const
+{
+    if (samples.empty())
+        return 0.0;
+
+    sorted = samples;
+    const std::size_t i = std::min(sorted.size() - 1, (std::size_t)(0.99 * (double)(sorted.size() - 1) + 0.5));
+    std::nth_element(sorted.begin(), sorted.begin() + (std::ptrdiff_t)i, sorted.end());
+    return sorted[i];
+}
+
+// ------------------------------------------------------------
+// GpuTimer
+// ------------------------------------------------------------
+void GpuTimer::Begin()
+{
+    if (!queries[0])
+        glGenQueries(GPU_TIMER_QUERIES, queries);
+
+    if (pending == GPU_TIMER_QUERIES)
+    {
+        ++skipped;
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[head]);
+    active = true;
+}
+
+void GpuTimer::End()
+{
+    if (!active)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    head = (head + 1) % GPU_TIMER_QUERIES;
+    ++pending;
+    active = false;
+}
+
+void GpuTimer::Poll(FrameStats& out)
+{
+    // Oldest first; results become available in issue order.
+    while (pending > 0)
+    {
+        const GLuint query = queries[(head + GPU_TIMER_QUERIES - pending) % GPU_TIMER_QUERIES];
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        out.Add((double)ns * 1e-6);
+        --pending;
+    }
+}
+
+void GpuTimer::Release()
+{
+    if (queries[0])
+        glDeleteQueries(GPU_TIMER_QUERIES, queries);
+
+    std::fill(std::begin(queries), std::end(queries), 0u);
+    head = 0;
+    pending = 0;
+    active = false;
+}
+
+// ------------------------------------------------------------
+// FrameProfiler
+// ------------------------------------------------------------
+namespace
+{
+    struct Section
+    {
+        std::string name;
+        bool gpu = false;
+        FrameStats stats;
+        GpuTimer timer; // GPU sections
+    };
+
+    struct Profiler
+    {
+        FrameStats frame;
+        std::deque<Section> sections; // stable addresses for activeGpu
+        Section* activeGpu = nullptr;
+    };
+
+    Profiler& Get()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Section& FindSection(const char* name, bool gpu)
+    {
+        auto& sections = Get().sections;
+        for (Section& s : sections)
+        {
+            if (s.gpu == gpu && s.name == name)
+                return s;
+        }
+
+        Section& s = sections.emplace_back();
+        s.name = name;
+        s.gpu = gpu;
+        return s;
+    }
+}
+
+namespace FrameProfiler
+{
+    void BeginFrame()
+    {
+        for (Section& s : Get().sections)
+        {
+            if (s.gpu)
+                s.timer.Poll(s.stats);
+        }
+    }
+
+    void EndFrame(double frameMilliseconds)
+    {
+        Get().frame.Add(frameMilliseconds);
+    }
+
+    void AddCpuSample(const char* section, double ms)
+    {
+        FindSection(section, false).stats.Add(ms);
+    }
+
+    bool BeginGpu(const char* section)
+    {
+        Profiler& p = Get();
+        if (!section || p.activeGpu)
+            return false;
+
+        p.activeGpu = &FindSection(section, true);
+        p.activeGpu->timer.Begin();
+        return true;
+    }
+
+    void EndGpu()
+    {
+        Profiler& p = Get();
+        if (!p.activeGpu)
+            return;
+
+        p.activeGpu->timer.End();
+        p.activeGpu = nullptr;
+    }
+
+    const FrameStats& GetFrameStats()
+    {
+        return Get().frame;
+    }
+
+    std::string Format()
+    {
+        const Profiler& p = Get();
+
+        std::string out;
+        char line[128];
+        auto append = [&](const char* kind, const std::string& name, const FrameStats& s)
+            {
+                std::snprintf(line, sizeof(line), "%s %-22s %7.2f %7.2f %7.2f\n",
+                    kind, name.c_str(), s.GetMin(), s.GetAvg(), s.GetP99());
+                out += line;
+            };
+
+        std::snprintf(line, sizeof(line), "    %-22s %7s %7s %7s\n", "ms", "min", "avg", "p99");
+        out += line;
+        append("   ", "frame", p.frame);
+        for (const Section& s : p.sections)
+        {
+            if (s.stats.GetCount() > 0)
+                append(s.gpu ? "gpu" : "cpu", s.name, s.stats);
+        }
+        return out;
+    }
+
+    void Release()
+    {
+        Profiler& p = Get();
+        for (Section& s : p.sections)
+        {
+            if (s.gpu)
+                s.timer.Release();
+        }
+        p.activeGpu = nullptr;
+    }
+}
@@ -0,0 +1,132 @@
+// FrameProfiler.h
+#pragma once
+#include "glad.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef FRAME_STATS_WINDOW
+// Samples (frames) kept for the rolling min/avg/p99.
+#define FRAME_STATS_WINDOW 240
+#endif
+
+#ifndef GPU_TIMER_QUERIES
+// GL_TIME_ELAPSED queries in flight per GPU section. Results are read a few
+// frames late; when all are still pending the frame goes untimed instead of
+// waiting for one.
+#define GPU_TIMER_QUERIES 4
+#endif
+
+// Rolling window of millisecond samples.
+class FrameStats
+{
+public:
+    void Add(double ms);
+    void Clear();
+
+    std::size_t GetCount() const { return samples.size(); }
+    double GetLast() const { return last; }
+    double GetMin() const;
+    double GetAvg() const;
+    double GetP99() const;
+
+private:
+    std::vector<double> samples;
+    std::size_t next = 0;
+    double last = 0.0;
+    mutable std::vector<double> sorted;
+};
+
+// GPU time of one section per frame via a ring of GL_TIME_ELAPSED queries,
+// read back only once GL_QUERY_RESULT_AVAILABLE says so. Only one
+// GL_TIME_ELAPSED query can be active at a time, so sections must not nest.
+class GpuTimer
+{
+public:
+    void Begin();
+    void End();
+
+    // Moves finished results into out (never blocks).
+    void Poll(FrameStats& out);
+    void Release();
+
+    uint64_t GetSkipped() const { return skipped; }
+
+private:
+    GLuint queries[GPU_TIMER_QUERIES]{};
+    std::size_t head = 0;    // next query to issue
+    std::size_t pending = 0; // issued, result not read yet
+    bool active = false;
+    uint64_t skipped = 0;    // frames with every query still in flight
+};
+
+// Named CPU and GPU sections with rolling stats, for the frame statistics HUD
+// and vk_headless. Main thread only; GPU sections need a current GL context.
+// Sections are listed in the order they are first recorded.
+namespace FrameProfiler
+{
+    // Polls GPU queries from earlier frames; call once per frame before drawing.
+    void BeginFrame();
+    void EndFrame(double frameMilliseconds);
+
+    void AddCpuSample(const char* section, double ms);
+
+    // Nested GPU sections are ignored (the outer one includes their time), as
+    // are null names; returns whether a section was started.
+    bool BeginGpu(const char* section);
+    void EndGpu();
+
+    const FrameStats& GetFrameStats();
+
+    // One "name  min avg p99" line per section, frame time first.
+    std::string Format();
+
+    // Deletes GPU queries; call while the context is still current.
+    void Release();
+}
+
+class ScopedCpuTimer
+{
+public:
+    explicit ScopedCpuTimer(const char* section)
+        : section(section), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedCpuTimer()
+    {
+        const auto end = std::chrono::steady_clock::now();
+        FrameProfiler::AddCpuSample(section, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    ScopedCpuTimer(const ScopedCpuTimer&) = delete;
+    ScopedCpuTimer& operator=(const ScopedCpuTimer&) = delete;
+
+private:
+    const char* section;
+    std::chrono::steady_clock::time_point start;
+};
+
+class ScopedGpuTimer
+{
+public:
+    explicit ScopedGpuTimer(const char* section)
+        : started(FrameProfiler::BeginGpu(section))
+    {
+    }
+
+    ~ScopedGpuTimer()
+    {
+        if (started)
+            FrameProfiler::EndGpu();
+    }
+
+    ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+    ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+private:
+    bool started;
+};
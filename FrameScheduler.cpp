@@ -0,0 +1,67 @@
+// FrameScheduler.cpp
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler()
+{
+    SetFrameCap(FRAME_SCHEDULER_MAX_FPS);
+}
+
+void FrameScheduler::SetFrameCap(double framesPerSecond)
+{
+    frameCap = std::max(0.0, framesPerSecond);
+    minInterval = (frameCap > 0.0)
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameCap))
+        : Clock::duration::zero();
+}
+
+void FrameScheduler::Invalidate()
+{
+    InvalidateAt(Clock::time_point::min());
+}
+
+void FrameScheduler::InvalidateAt(Clock::time_point when)
+{
+    ++stats.invalidations;
+    if (!requested || when < requestedAt)
+        requestedAt = when;
+    requested = true;
+}
+
+// ------------------------------------------------------------
+// Scheduling
+// ------------------------------------------------------------
+FrameScheduler::Clock::time_point FrameScheduler::DueTime() const
+{
+    if (!hasLastFrame)
+        return requestedAt;
+    return std::max(requestedAt, lastFrame + minInterval);
+}
+
+bool FrameScheduler::IsFrameDue(Clock::time_point now) const
+{
+    return requested && DueTime() <= now;
+}
+
+bool FrameScheduler::GetWaitTime(Clock::time_point now, Clock::duration& wait) const
+{
+    if (!requested)
+        return false;
+
+    const Clock::time_point due = DueTime();
+    wait = (due > now) ? due - now : Clock::duration::zero();
+    return true;
+}
+
+float FrameScheduler::BeginFrame(Clock::time_point now)
+{
+    const float dt = hasLastFrame ? std::chrono::duration<float>(now - lastFrame).count() : 0.0f;
+
+    requested = false;
+    requestedAt = Clock::time_point::min();
+    hasLastFrame = true;
+    lastFrame = now;
+    ++stats.frames;
+    return dt;
+}
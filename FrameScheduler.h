@@ -0,0 +1,79 @@
+// FrameScheduler.h
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#ifndef FRAME_SCHEDULER_MAX_FPS
+// Default frame cap while frames are requested back to back (0 = uncapped).
+#define FRAME_SCHEDULER_MAX_FPS 120.0
+#endif
+
+#ifndef FRAME_SCHEDULER_POLL_MS
+// Frame interval while background work (pick tree, LOD pyramids, raster
+// tiles) is in flight; finished results are picked up by the next frame.
+#define FRAME_SCHEDULER_POLL_MS 50
+#endif
+
+// Decides when the platform loop renders: only after something invalidated the
+// frame (input, an entity change, an animation step, pending background work),
+// never faster than the frame cap, and otherwise not at all so the loop can
+// block on events. Time is always passed in, so nothing here touches the OS
+// clock or window system and the schedule is reproducible headless.
+//
+// Vsync is only recorded here; the platform layer applies it to its swap chain.
+// Main thread only.
+class FrameScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameScheduler();
+
+    struct Stats
+    {
+        uint64_t frames = 0;        // frames rendered
+        uint64_t invalidations = 0; // Invalidate/InvalidateAt calls
+    };
+
+    void SetFrameCap(double framesPerSecond); // 0 = uncapped
+    double GetFrameCap() const { return frameCap; }
+
+    void SetVSync(bool enabled) { vsync = enabled; }
+    bool IsVSync() const { return vsync; }
+
+    // Render as soon as the frame cap allows.
+    void Invalidate();
+
+    // Render no later than when (timers, polling); earlier requests win.
+    void InvalidateAt(Clock::time_point when);
+
+    bool IsFrameDue(Clock::time_point now) const;
+
+    // Time the loop may block for events before a frame is due. Returns false
+    // when nothing is scheduled (wait for events indefinitely).
+    bool GetWaitTime(Clock::time_point now, Clock::duration& wait) const;
+
+    // Starts a due frame: clears the request and returns seconds since the
+    // previous frame (0 for the first one).
+    float BeginFrame(Clock::time_point now);
+
+    Clock::time_point GetLastFrameTime() const { return lastFrame; }
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    Clock::time_point DueTime() const;
+
+private:
+    double frameCap = 0.0;
+    Clock::duration minInterval{};
+    bool vsync = true;
+
+    bool requested = true; // the first frame is always due
+    Clock::time_point requestedAt = Clock::time_point::min();
+
+    bool hasLastFrame = false;
+    Clock::time_point lastFrame{};
+
+    Stats stats;
+};
@@ -0,0 +1,531 @@
+// GLStateCache.cpp
+#include "GLStateCache.h"
+#include "StreamRingBuffer.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    constexpr GLuint kUnknown = ~0u;
+
+    // std140 layout of the Camera block.
+    struct CameraBlock
+    {
+        glm::mat4 mvp{ 1.0f };
+        glm::vec4 viewport{ 0.0f };
+    };
+
+    struct UniformValue
+    {
+        std::array<uint32_t, 16> bits{};
+        uint32_t size = 0; // in 32-bit words
+    };
+
+    struct State
+    {
+        GLuint program = kUnknown;
+        GLuint vao = kUnknown;
+        GLenum activeTexture = 0; // 0 = unknown
+
+        std::unordered_map<GLenum, GLuint> buffers;   // target -> buffer
+        std::unordered_map<uint64_t, GLuint> textures; // (unit, target) -> texture
+        std::unordered_map<GLenum, bool> enables;
+
+        GLuint drawFramebuffer = kUnknown;
+        GLuint readFramebuffer = kUnknown;
+        GLStateCache::Rect viewport;
+        GLStateCache::Rect scissor;
+        GLStateCache::BlendFactors blend;
+        glm::vec4 clearColor{ 0.0f };
+        bool viewportValid = false;
+        bool scissorValid = false;
+        bool blendValid = false;
+        bool clearColorValid = false;
+
+        std::unordered_map<uint64_t, UniformValue> uniforms; // (program, location)
+
+        StreamRingBuffer cameraRing;
+        CameraBlock camera;
+        bool cameraValid = false; // camera holds what is bound at the binding point
+        std::size_t uniformAlignment = 256;
+
+        GLStateCache::Stats stats;
+    };
+
+    State& Get()
+    {
+        static State state;
+        return state;
+    }
+
+    uint64_t TextureKey(GLenum unit, GLenum target)
+    {
+        return ((uint64_t)unit << 32) | target;
+    }
+
+    // True (and counted as skipped) when the cached value already matches.
+    template <typename Map, typename Key, typename Value>
+    bool Unchanged(Map& map, const Key& key, const Value& value)
+    {
+        State& s = Get();
+        auto it = map.find(key);
+        if (it != map.end() && it->second == value)
+        {
+            ++s.stats.skipped;
+            return true;
+        }
+        map[key] = value;
+        ++s.stats.issued;
+        return false;
+    }
+
+    bool SameRect(const GLStateCache::Rect& a, const GLStateCache::Rect& b)
+    {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    }
+
+    GLStateCache::Rect QueryRect(GLenum name)
+    {
+        GLint v[4] = { 0, 0, 0, 0 };
+        glGetIntegerv(name, v);
+        return GLStateCache::Rect{ v[0], v[1], v[2], v[3] };
+    }
+
+    bool UniformUnchanged(GLint location, const void* data, uint32_t words)
+    {
+        State& s = Get();
+        if (location < 0)
+            return true; // not active in this program; GL ignores it anyway
+
+        UniformValue& v = s.uniforms[((uint64_t)s.program << 32) | (uint32_t)location];
+        if (v.size == words && std::memcmp(v.bits.data(), data, words * sizeof(uint32_t)) == 0)
+        {
+            ++s.stats.skipped;
+            return true;
+        }
+        v.size = words;
+        std::memcpy(v.bits.data(), data, words * sizeof(uint32_t));
+        ++s.stats.issued;
+        return false;
+    }
+}
+
+namespace GLStateCache
+{
+    void UseProgram(GLuint program)
+    {
+        State& s = Get();
+        if (s.program == program)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glUseProgram(program);
+        s.program = program;
+        ++s.stats.issued;
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+        State& s = Get();
+        if (s.vao == vao)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glBindVertexArray(vao);
+        s.vao = vao;
+        ++s.stats.issued;
+    }
+
+    void BindBuffer(GLenum target, GLuint buffer)
+    {
+        if (!Unchanged(Get().buffers, target, buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    void ActiveTexture(GLenum unit)
+    {
+        State& s = Get();
+        if (s.activeTexture == unit)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glActiveTexture(unit);
+        s.activeTexture = unit;
+        ++s.stats.issued;
+    }
+
+    void BindTexture(GLenum target, GLuint texture)
+    {
+        State& s = Get();
+        if (s.activeTexture == 0)
+        {
+            // Unit unknown: bind without caching.
+            glBindTexture(target, texture);
+            ++s.stats.issued;
+            return;
+        }
+        if (!Unchanged(s.textures, TextureKey(s.activeTexture, target), texture))
+            glBindTexture(target, texture);
+    }
+
+    // ------------------------------------------------------------
+    // Framebuffer and fixed-function state
+    // ------------------------------------------------------------
+    void BindFramebuffer(GLenum target, GLuint fbo)
+    {
+        State& s = Get();
+        const bool draw = target != GL_READ_FRAMEBUFFER;
+        const bool read = target != GL_DRAW_FRAMEBUFFER;
+        if ((!draw || s.drawFramebuffer == fbo) && (!read || s.readFramebuffer == fbo))
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glBindFramebuffer(target, fbo);
+        if (draw)
+            s.drawFramebuffer = fbo;
+        if (read)
+            s.readFramebuffer = fbo;
+        ++s.stats.issued;
+    }
+
+    GLuint GetFramebuffer(GLenum target)
+    {
+        State& s = Get();
+        GLuint& tracked = target == GL_READ_FRAMEBUFFER ? s.readFramebuffer : s.drawFramebuffer;
+        if (tracked == kUnknown)
+        {
+            GLint fbo = 0;
+            glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+            tracked = (GLuint)fbo;
+        }
+        return tracked;
+    }
+
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        State& s = Get();
+        const Rect r{ x, y, width, height };
+        if (s.viewportValid && SameRect(s.viewport, r))
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glViewport(x, y, width, height);
+        s.viewport = r;
+        s.viewportValid = true;
+        ++s.stats.issued;
+    }
+
+    Rect GetViewport()
+    {
+        State& s = Get();
+        if (!s.viewportValid)
+        {
+            s.viewport = QueryRect(GL_VIEWPORT);
+            s.viewportValid = true;
+        }
+        return s.viewport;
+    }
+
+    void Scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        State& s = Get();
+        const Rect r{ x, y, width, height };
+        if (s.scissorValid && SameRect(s.scissor, r))
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glScissor(x, y, width, height);
+        s.scissor = r;
+        s.scissorValid = true;
+        ++s.stats.issued;
+    }
+
+    Rect GetScissor()
+    {
+        State& s = Get();
+        if (!s.scissorValid)
+        {
+            s.scissor = QueryRect(GL_SCISSOR_BOX);
+            s.scissorValid = true;
+        }
+        return s.scissor;
+    }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+        BlendFuncSeparate(BlendFactors{ src, dst, src, dst });
+    }
+
+    void BlendFuncSeparate(const BlendFactors& factors)
+    {
+        State& s = Get();
+        if (s.blendValid && s.blend.srcRgb == factors.srcRgb && s.blend.dstRgb == factors.dstRgb &&
+            s.blend.srcAlpha == factors.srcAlpha && s.blend.dstAlpha == factors.dstAlpha)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glBlendFuncSeparate(factors.srcRgb, factors.dstRgb, factors.srcAlpha, factors.dstAlpha);
+        s.blend = factors;
+        s.blendValid = true;
+        ++s.stats.issued;
+    }
+
+    BlendFactors GetBlendFunc()
+    {
+        State& s = Get();
+        if (!s.blendValid)
+        {
+            GLint v[4] = { GL_ONE, GL_ZERO, GL_ONE, GL_ZERO };
+            glGetIntegerv(GL_BLEND_SRC_RGB, &v[0]);
+            glGetIntegerv(GL_BLEND_DST_RGB, &v[1]);
+            glGetIntegerv(GL_BLEND_SRC_ALPHA, &v[2]);
+            glGetIntegerv(GL_BLEND_DST_ALPHA, &v[3]);
+            s.blend = BlendFactors{ (GLenum)v[0], (GLenum)v[1], (GLenum)v[2], (GLenum)v[3] };
+            s.blendValid = true;
+        }
+        return s.blend;
+    }
+
+    void ClearColor(float r, float g, float b, float a)
+    {
+        State& s = Get();
+        const glm::vec4 color(r, g, b, a);
+        if (s.clearColorValid && s.clearColor == color)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+        glClearColor(r, g, b, a);
+        s.clearColor = color;
+        s.clearColorValid = true;
+        ++s.stats.issued;
+    }
+
+    glm::vec4 GetClearColor()
+    {
+        State& s = Get();
+        if (!s.clearColorValid)
+        {
+            GLfloat v[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, v);
+            s.clearColor = glm::vec4(v[0], v[1], v[2], v[3]);
+            s.clearColorValid = true;
+        }
+        return s.clearColor;
+    }
+
+    void SetEnabled(GLenum cap, bool enabled)
+    {
+        if (Unchanged(Get().enables, cap, enabled))
+            return;
+
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+
+    bool IsEnabled(GLenum cap)
+    {
+        State& s = Get();
+        auto it = s.enables.find(cap);
+        if (it != s.enables.end())
+            return it->second;
+        const bool enabled = glIsEnabled(cap) == GL_TRUE;
+        s.enables[cap] = enabled;
+        return enabled;
+    }
+
+    void Uniform1i(GLint location, GLint value)
+    {
+        if (!UniformUnchanged(location, &value, 1))
+            glUniform1i(location, value);
+    }
+
+    void Uniform2f(GLint location, float x, float y)
+    {
+        const float v[2] = { x, y };
+        if (!UniformUnchanged(location, v, 2))
+            glUniform2f(location, x, y);
+    }
+
+    void Uniform4f(GLint location, float x, float y, float z, float w)
+    {
+        const float v[4] = { x, y, z, w };
+        if (!UniformUnchanged(location, v, 4))
+            glUniform4f(location, x, y, z, w);
+    }
+
+    void UniformMatrix4(GLint location, const glm::mat4& value)
+    {
+        if (!UniformUnchanged(location, glm::value_ptr(value), 16))
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    // ------------------------------------------------------------
+    // Camera block
+    // ------------------------------------------------------------
+    const char* CameraBlockSource()
+    {
+        return R"(
+        layout(std140) uniform Camera
+        {
+            mat4 mvp;
+            vec4 viewport; // xy = framebuffer size in pixels
+        };
+    )";
+    }
+
+    void BindCameraBlock(GLuint program)
+    {
+        const GLuint index = glGetUniformBlockIndex(program, "Camera");
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, GL_STATE_CAMERA_BINDING);
+    }
+
+    void SetCamera(const glm::mat4& mvp, const glm::vec2& viewportSize)
+    {
+        State& s = Get();
+
+        CameraBlock block;
+        block.mvp = mvp;
+        block.viewport = glm::vec4(viewportSize.x, viewportSize.y, 0.0f, 0.0f);
+
+        if (s.cameraValid && std::memcmp(&block, &s.camera, sizeof(block)) == 0)
+        {
+            ++s.stats.skipped;
+            return;
+        }
+
+        if (!s.cameraRing.GetBuffer())
+        {
+            GLint alignment = 256;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            s.uniformAlignment = (std::size_t)std::max(alignment, 16);
+            s.cameraRing.Init(GL_UNIFORM_BUFFER, 64 * 1024);
+        }
+
+        // Draws reading the previous camera are all issued by now.
+        s.cameraRing.Fence();
+        const GLintptr offset = s.cameraRing.Upload(&block, sizeof(block), s.uniformAlignment);
+
+        // Also sets the generic GL_UNIFORM_BUFFER binding.
+        glBindBufferRange(GL_UNIFORM_BUFFER, GL_STATE_CAMERA_BINDING, s.cameraRing.GetBuffer(), offset, sizeof(block));
+        s.buffers[GL_UNIFORM_BUFFER] = s.cameraRing.GetBuffer();
+
+        s.camera = block;
+        s.cameraValid = true;
+        ++s.stats.issued;
+        ++s.stats.cameraUploads;
+    }
+
+    // ------------------------------------------------------------
+    // Object lifetime
+    // ------------------------------------------------------------
+    void DeleteProgram(GLuint program)
+    {
+        State& s = Get();
+        if (s.program == program)
+            s.program = kUnknown;
+        for (auto it = s.uniforms.begin(); it != s.uniforms.end(); )
+        {
+            if ((GLuint)(it->first >> 32) == program)
+                it = s.uniforms.erase(it);
+            else
+                ++it;
+        }
+        glDeleteProgram(program);
+    }
+
+    void DeleteVertexArray(GLuint vao)
+    {
+        State& s = Get();
+        if (s.vao == vao)
+            s.vao = kUnknown;
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    void DeleteBuffer(GLuint buffer)
+    {
+        State& s = Get();
+        for (auto it = s.buffers.begin(); it != s.buffers.end(); )
+        {
+            if (it->second == buffer)
+                it = s.buffers.erase(it);
+            else
+                ++it;
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+
+    void DeleteTexture(GLuint texture)
+    {
+        State& s = Get();
+        for (auto it = s.textures.begin(); it != s.textures.end(); )
+        {
+            if (it->second == texture)
+                it = s.textures.erase(it);
+            else
+                ++it;
+        }
+        glDeleteTextures(1, &texture);
+    }
+
+    void DeleteFramebuffer(GLuint fbo)
+    {
+        State& s = Get();
+        if (s.drawFramebuffer == fbo)
+            s.drawFramebuffer = kUnknown;
+        if (s.readFramebuffer == fbo)
+            s.readFramebuffer = kUnknown;
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    void Invalidate()
+    {
+        State& s = Get();
+        s.program = kUnknown;
+        s.vao = kUnknown;
+        s.activeTexture = 0;
+        s.buffers.clear();
+        s.textures.clear();
+        s.enables.clear();
+        s.drawFramebuffer = kUnknown;
+        s.readFramebuffer = kUnknown;
+        s.viewportValid = false;
+        s.scissorValid = false;
+        s.blendValid = false;
+        s.clearColorValid = false;
+        s.cameraValid = false;
+        // Uniform values are program state; nothing outside the cache sets them.
+    }
+
+    void Release()
+    {
+        State& s = Get();
+        s.cameraRing.Release();
+        Invalidate();
+    }
+
+    const Stats& GetStats()
+    {
+        return Get().stats;
+    }
+
+    void ResetStats()
+    {
+        Get().stats = Stats{};
+    }
+}
@@ -0,0 +1,112 @@
+// GLStateCache.h
+#pragma once
+#include "glad.h"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#ifndef GL_STATE_CAMERA_BINDING
+// Uniform buffer binding point of the shared Camera block.
+#define GL_STATE_CAMERA_BINDING 0
+#endif
+
+// Thin shadow of the GL state the renderers touch: bound program, vertex
+// array, buffers per target, textures per unit, framebuffers, viewport,
+// scissor box, blend factors, clear color, capability enables and uniform
+// values per (program, location). Calls that would not change the tracked
+// state are skipped and counted.
+//
+// Everything starts unknown, so the first call of each kind always goes to GL
+// and the first Get*/IsEnabled of an unknown value queries it once.
+// Code that changes tracked state behind the cache must call Invalidate()
+// afterwards; objects must be deleted through the Delete* helpers so a
+// recycled name is not mistaken for a binding that is still current.
+//
+// The camera (model-view-projection and viewport size) lives in one shared
+// uniform buffer, streamed only when it changes and bound at
+// GL_STATE_CAMERA_BINDING for every program that declares CameraBlockSource().
+// Main thread only.
+namespace GLStateCache
+{
+    struct Stats
+    {
+        uint64_t issued = 0;        // calls forwarded to GL
+        uint64_t skipped = 0;       // redundant calls dropped
+        uint64_t cameraUploads = 0; // Camera block updates
+    };
+
+    struct Rect
+    {
+        GLint x = 0;
+        GLint y = 0;
+        GLsizei width = 0;
+        GLsizei height = 0;
+    };
+
+    struct BlendFactors
+    {
+        GLenum srcRgb = GL_ONE;
+        GLenum dstRgb = GL_ZERO;
+        GLenum srcAlpha = GL_ONE;
+        GLenum dstAlpha = GL_ZERO;
+    };
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+
+    // Not GL_ELEMENT_ARRAY_BUFFER, which is vertex array state.
+    void BindBuffer(GLenum target, GLuint buffer);
+
+    void ActiveTexture(GLenum unit);
+    void BindTexture(GLenum target, GLuint texture); // on the active unit
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer.
+    void BindFramebuffer(GLenum target, GLuint fbo);
+    GLuint GetFramebuffer(GLenum target); // GL_FRAMEBUFFER reads the draw binding
+
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    Rect GetViewport();
+
+    void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+    Rect GetScissor();
+
+    void BlendFunc(GLenum src, GLenum dst);
+    void BlendFuncSeparate(const BlendFactors& factors);
+    BlendFactors GetBlendFunc();
+
+    void ClearColor(float r, float g, float b, float a);
+    glm::vec4 GetClearColor();
+
+    void SetEnabled(GLenum cap, bool enabled);
+    bool IsEnabled(GLenum cap);
+
+    // Uniforms of the current program.
+    void Uniform1i(GLint location, GLint value);
+    void Uniform2f(GLint location, float x, float y);
+    void Uniform4f(GLint location, float x, float y, float z, float w);
+    void UniformMatrix4(GLint location, const glm::mat4& value);
+
+    // GLSL declaration of the Camera block (mvp; viewport.xy = size in pixels).
+    const char* CameraBlockSource();
+
+    // Points the program's Camera block (if any) at GL_STATE_CAMERA_BINDING.
+    void BindCameraBlock(GLuint program);
+
+    // Streams and binds the camera unless it equals the bound one.
+    void SetCamera(const glm::mat4& mvp, const glm::vec2& viewportSize);
+
+    void DeleteProgram(GLuint program);
+    void DeleteVertexArray(GLuint vao);
+    void DeleteBuffer(GLuint buffer);
+    void DeleteTexture(GLuint texture);
+    void DeleteFramebuffer(GLuint fbo);
+
+    // Forget all tracked state (the next call of each kind goes to GL).
+    void Invalidate();
+
+    // Deletes the camera buffer; call while the context is still current.
+    void Release();
+
+    const Stats& GetStats();
+    void ResetStats();
+}
@@ -0,0 +1,304 @@
+// HeadlessContext.cpp
+#include "HeadlessContext.h"
+#include "GLStateCache.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace
+{
+    bool HasExtension(const char* list, const char* name)
+    {
+        if (!list)
+            return false;
+
+        const std::size_t len = std::strlen(name);
+        for (const char* p = std::strstr(list, name); p; p = std::strstr(p + len, name))
+        {
+            const bool startOk = (p == list) || (p[-1] == ' ');
+            const bool endOk = (p[len] == ' ') || (p[len] == '\0');
+            if (startOk && endOk)
+                return true;
+        }
+        return false;
+    }
+
+    EGLDisplay OpenDisplay()
+    {
+        // Client extensions (EGL 1.5 / EGL_EXT_client_extensions).
+        const char* clientExts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (HasExtension(clientExts, "EGL_MESA_platform_surfaceless"))
+        {
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (getPlatformDisplay)
+            {
+                EGLDisplay dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (dpy != EGL_NO_DISPLAY)
+                    return dpy;
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    Release();
+}
+
+bool HeadlessContext::Init(int w, int h)
+{
+    EGLDisplay dpy = OpenDisplay();
+    EGLint major = 0, minor = 0;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor))
+    {
+        std::printf("[Headless] eglInitialize failed (0x%x)\n", eglGetError());
+        return false;
+    }
+    display = dpy;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::printf("[Headless] desktop OpenGL is not supported by this EGL\n");
+        Release();
+        return false;
+    }
+
+    // Prefer a pbuffer-capable config; surfaceless displays may only offer
+    // configs without surface types, which is fine since we draw to an FBO.
+    const EGLint pbufferConfig[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint anyConfig[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config = nullptr;
+    EGLint count = 0;
+    bool pbuffer = eglChooseConfig(dpy, pbufferConfig, &config, 1, &count) && count > 0;
+    if (!pbuffer && !(eglChooseConfig(dpy, anyConfig, &config, 1, &count) && count > 0))
+    {
+        std::printf("[Headless] no EGL config with OpenGL support\n");
+        Release();
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT)
+    {
+        std::printf("[Headless] eglCreateContext (3.3 core) failed (0x%x)\n", eglGetError());
+        Release();
+        return false;
+    }
+    context = ctx;
+
+    EGLSurface surf = EGL_NO_SURFACE;
+    if (pbuffer)
+    {
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surf = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+    }
+    surface = (surf == EGL_NO_SURFACE) ? nullptr : surf;
+
+    // Without a surface this relies on EGL_KHR_surfaceless_context.
+    if (!eglMakeCurrent(dpy, surf, surf, ctx))
+    {
+        std::printf("[Headless] eglMakeCurrent failed (0x%x)\n", eglGetError());
+        Release();
+        return false;
+    }
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+    {
+        std::printf("[Headless] failed to load OpenGL via glad\n");
+        Release();
+        return false;
+    }
+
+    std::printf("[Headless] EGL %d.%d, GL %s | %s\n", major, minor,
+        reinterpret_cast<const char*>(glGetString(GL_VERSION)), GetRendererName());
+
+    Resize(w, h);
+    return true;
+}
+
+void HeadlessContext::Release()
+{
+    if (!display)
+        return;
+
+    EGLDisplay dpy = static_cast<EGLDisplay>(display);
+    if (context)
+    {
+        DestroyFramebuffer();
+        eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(dpy, static_cast<EGLContext>(context));
+    }
+    if (surface)
+        eglDestroySurface(dpy, static_cast<EGLSurface>(surface));
+    eglTerminate(dpy);
+
+    context = nullptr;
+    surface = nullptr;
+    display = nullptr;
+}
+
+// ------------------------------------------------------------
+// Framebuffer
+// ------------------------------------------------------------
+void HeadlessContext::Resize(int w, int h)
+{
+    w = std::max(1, w);
+    h = std::max(1, h);
+    if (fbo && w == width && h == height)
+        return;
+
+    width = w;
+    height = h;
+
+    DestroyFramebuffer();
+    CreateFramebuffer();
+}
+
+void HeadlessContext::CreateFramebuffer()
+{
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        std::printf("[Headless] framebuffer %dx%d incomplete (0x%x)\n", width, height, status);
+
+    GLStateCache::Viewport(0, 0, width, height);
+}
+
+void HeadlessContext::DestroyFramebuffer()
+{
+    if (fbo)
+    {
+        GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLStateCache::DeleteFramebuffer(fbo);
+    }
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+
+    fbo = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+}
+
+void HeadlessContext::BindFramebuffer() const
+{
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+const char* HeadlessContext::GetRendererName() const
+{
+    const GLubyte* name = context ? glGetString(GL_RENDERER) : nullptr;
+    return name ? reinterpret_cast<const char*>(name) : "(none)";
+}
+
+// ------------------------------------------------------------
+// Readback
+// ------------------------------------------------------------
+void HeadlessContext::ReadPixels(std::vector<uint8_t>& rgba) const
+{
+    const std::size_t stride = (std::size_t)width * 4;
+    rgba.resize(stride * (std::size_t)height);
+    if (!fbo)
+        return;
+
+    const GLuint prevRead = GLStateCache::GetFramebuffer(GL_READ_FRAMEBUFFER);
+    GLint prevAlign = 0;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &prevAlign);
+
+    GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    glPixelStorei(GL_PACK_ALIGNMENT, prevAlign);
+    GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, prevRead);
+
+    // GL rows are bottom-up.
+    std::vector<uint8_t> row(stride);
+    for (int y = 0; y < height / 2; ++y)
+    {
+        uint8_t* a = rgba.data() + (std::size_t)y * stride;
+        uint8_t* b = rgba.data() + (std::size_t)(height - 1 - y) * stride;
+        std::memcpy(row.data(), a, stride);
+        std::memcpy(a, b, stride);
+        std::memcpy(b, row.data(), stride);
+    }
+}
+
+bool HeadlessContext::WritePPM(const std::string& path) const
+{
+    std::vector<uint8_t> rgba;
+    ReadPixels(rgba);
+    return WritePPM(path, rgba, width, height);
+}
+
+bool HeadlessContext::WritePPM(const std::string& path, const std::vector<uint8_t>& rgba, int width, int height)
+{
+    if (rgba.size() < (std::size_t)width * (std::size_t)height * 4)
+        return false;
+
+    FILE* fp = std::fopen(path.c_str(), "wb");
+    if (!fp)
+    {
+        std::printf("[Headless] cannot write %s\n", path.c_str());
+        return false;
+    }
+
+    std::fprintf(fp, "P6\n%d %d\n255\n", width, height);
+
+    std::vector<uint8_t> rgb((std::size_t)width * 3);
+    bool ok = true;
+    for (int y = 0; y < height && ok; ++y)
+    {
+        const uint8_t* src = rgba.data() + (std::size_t)y * width * 4;
+        for (int x = 0; x < width; ++x)
+        {
+            rgb[(std::size_t)x * 3 + 0] = src[x * 4 + 0];
+            rgb[(std::size_t)x * 3 + 1] = src[x * 4 + 1];
+            rgb[(std::size_t)x * 3 + 2] = src[x * 4 + 2];
+        }
+        ok = std::fwrite(rgb.data(), 1, rgb.size(), fp) == rgb.size();
+    }
+
+    ok = (std::fclose(fp) == 0) && ok;
+    if (!ok)
+        std::printf("[Headless] error writing %s\n", path.c_str());
+    return ok;
+}
@@ -0,0 +1,61 @@
+// HeadlessContext.h
+#pragma once
+#include "glad.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Windowless OpenGL 3.3 core context for Linux (EGL) with an offscreen
+// framebuffer, so the renderers can run on machines without a display or GPU
+// (Mesa llvmpipe).
+//
+// The display is EGL_PLATFORM_SURFACELESS_MESA when available, otherwise the
+// default EGL display (set EGL_PLATFORM=surfaceless for Mesa). Drawing goes to
+// an RGBA8 + depth/stencil framebuffer object of the requested size; it stays
+// bound as GL_FRAMEBUFFER after Init()/Resize(), so code written for the
+// default framebuffer renders into it unchanged.
+class HeadlessContext
+{
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates the context, makes it current and loads GL. Prints and returns
+    // false on failure.
+    bool Init(int width, int height);
+    void Release();
+
+    void Resize(int width, int height);
+    void BindFramebuffer() const;
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const char* GetRendererName() const;
+
+    // Framebuffer contents as tightly packed RGBA8, top row first.
+    void ReadPixels(std::vector<uint8_t>& rgba) const;
+
+    // Binary PPM (P6) of the framebuffer, or of a top-down RGBA8 image.
+    bool WritePPM(const std::string& path) const;
+    static bool WritePPM(const std::string& path, const std::vector<uint8_t>& rgba, int width, int height);
+
+private:
+    void CreateFramebuffer();
+    void DestroyFramebuffer();
+
+private:
+    void* display = nullptr; // EGLDisplay
+    void* surface = nullptr; // EGLSurface (1x1 pbuffer, or none when surfaceless)
+    void* context = nullptr; // EGLContext
+
+    GLuint fbo = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+
+    int width = 0;
+    int height = 0;
+};
@@ -0,0 +1,399 @@
+// HeadlessMain.cpp
+//
+// Windowless driver for Linux: runs Application::Update and
+// StatefulVectorRenderer::Redraw into an offscreen framebuffer for a fixed
+// number of frames, prints frame-time statistics and optionally writes the last
+// frame as a PPM for verification. --cpu draws with SoftwareLineRasterizer
+// instead (no GL context is created); --compare diffs the last GL frame
+// against the CPU rasterizer. Per-section FrameProfiler numbers are printed at
+// the end; --stats also draws them as the HUD overlay. --on-demand runs the
+// frames through FrameScheduler on a simulated 60 Hz clock, so only ticks with
+// pan/zoom input or pending background work are rendered. --batch-threads
+// sets the workers used for batch rebuilds (1 = serial); --async-batches
+// rebuilds the scene batches in the background whatever the book size.
+//
+//   vk_headless [--size WxH] [--frames N] [--warmup N] [--pan DX,DY]
+//               [--zoom F] [--tile-cache] [--cpu] [--no-aa] [--compare]
+//               [--stats] [--on-demand] [--batch-threads N] [--async-batches]
+//               [--out frame.ppm]
+#include "glad.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Application.h"
+#include "FrameProfiler.h"
+#include "FrameScheduler.h"
+#include "GLStateCache.h"
+#include "HeadlessContext.h"
+#include "HersheyTextCache.h"
+#include "RenderContext.h"
+#include "SoftwareLineRasterizer.h"
+#include "StatefulVectorRenderer.h"
+
+namespace
+{
+    struct Options
+    {
+        int width = 1280;
+        int height = 720;
+        int frames = 300;
+        int warmup = 10;        // not included in the statistics
+        int panX = 0;           // pixels per frame
+        int panY = 0;
+        float zoom = 1.0f;      // factor per frame, about the view center
+        bool tileCache = false;
+        bool cpu = false;       // software rasterizer instead of GL
+        bool antialias = true;  // software rasterizer
+        bool compare = false;   // GL vs software on the last frame
+        bool stats = false;     // frame statistics HUD overlay
+        bool onDemand = false;  // render only scheduled frames
+        int batchThreads = -1;  // renderer default
+        bool asyncBatches = false; // scene rebuilds in the background
+        std::string out;        // PPM of the last frame
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "usage: vk_headless [--size WxH] [--frames N] [--warmup N] [--pan DX,DY]\n"
+            "                   [--zoom F] [--tile-cache] [--cpu] [--no-aa] [--compare]\n"
+            "                   [--stats] [--on-demand] [--batch-threads N] [--async-batches]\n"
+            "                   [--out frame.ppm]\n");
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            bool ok = true;
+
+            if (std::strcmp(arg, "--tile-cache") == 0 || std::strcmp(arg, "--cpu") == 0 ||
+                std::strcmp(arg, "--no-aa") == 0 || std::strcmp(arg, "--compare") == 0 ||
+                std::strcmp(arg, "--stats") == 0 || std::strcmp(arg, "--on-demand") == 0 ||
+                std::strcmp(arg, "--async-batches") == 0)
+            {
+                o.tileCache |= std::strcmp(arg, "--tile-cache") == 0;
+                o.cpu |= std::strcmp(arg, "--cpu") == 0;
+                o.antialias &= std::strcmp(arg, "--no-aa") != 0;
+                o.compare |= std::strcmp(arg, "--compare") == 0;
+                o.stats |= std::strcmp(arg, "--stats") == 0;
+                o.onDemand |= std::strcmp(arg, "--on-demand") == 0;
+                o.asyncBatches |= std::strcmp(arg, "--async-batches") == 0;
+                continue;
+            }
+            if (!value)
+                return false;
+
+            if (std::strcmp(arg, "--size") == 0)
+                ok = std::sscanf(value, "%dx%d", &o.width, &o.height) == 2 && o.width > 0 && o.height > 0;
+            else if (std::strcmp(arg, "--frames") == 0)
+                ok = std::sscanf(value, "%d", &o.frames) == 1 && o.frames > 0;
+            else if (std::strcmp(arg, "--warmup") == 0)
+                ok = std::sscanf(value, "%d", &o.warmup) == 1 && o.warmup >= 0;
+            else if (std::strcmp(arg, "--pan") == 0)
+                ok = std::sscanf(value, "%d,%d", &o.panX, &o.panY) == 2;
+            else if (std::strcmp(arg, "--zoom") == 0)
+                ok = std::sscanf(value, "%f", &o.zoom) == 1 && o.zoom > 0.0f;
+            else if (std::strcmp(arg, "--batch-threads") == 0)
+                ok = std::sscanf(value, "%d", &o.batchThreads) == 1 && o.batchThreads >= 0;
+            else if (std::strcmp(arg, "--out") == 0)
+                o.out = value;
+            else
+                ok = false;
+
+            if (!ok)
+                return false;
+            ++i;
+        }
+        return !(o.cpu && (o.compare || o.tileCache));
+    }
+
+    struct Timing
+    {
+        std::vector<double> frame;  // Update + Redraw + glFinish
+        double update = 0.0;        // sums
+        double submit = 0.0;
+        double finish = 0.0;        // GL only
+    };
+
+    double Percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+        const std::size_t i = (std::size_t)std::min<double>((double)sorted.size() - 1.0, p * (double)(sorted.size() - 1) + 0.5);
+        return sorted[i];
+    }
+
+    void PrintTiming(const Timing& t)
+    {
+        std::vector<double> sorted = t.frame;
+        std::sort(sorted.begin(), sorted.end());
+        if (sorted.empty())
+            return;
+
+        const double n = (double)sorted.size();
+        double total = 0.0;
+        for (double ms : sorted)
+            total += ms;
+
+        std::printf("[Headless] %zu frames: min=%.3f avg=%.3f p50=%.3f p99=%.3f max=%.3f ms (%.1f fps)\n",
+            sorted.size(), sorted.front(), total / n, Percentile(sorted, 0.50), Percentile(sorted, 0.99),
+            sorted.back(), total > 0.0 ? 1000.0 * n / total : 0.0);
+        std::printf("[Headless] avg update=%.3f submit=%.3f gpu-wait=%.3f ms\n",
+            t.update / n, t.submit / n, t.finish / n);
+    }
+
+    RenderContext MakeContext(const Application& app)
+    {
+        RenderContext ctx;
+        ctx.projection = app.GetProjectionMatrix();
+        ctx.view = app.GetViewMatrix();
+        ctx.model = app.GetModelMatrix();
+        ctx.viewportSize = glm::vec2(app.GetClientSize());
+        return ctx;
+    }
+
+    void PrintDiff(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+    {
+        const std::size_t pixels = std::min(a.size(), b.size()) / 4;
+        uint64_t sum = 0;
+        std::size_t differing = 0;
+        int maxDiff = 0;
+        for (std::size_t i = 0; i < pixels; ++i)
+        {
+            int d = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                const int v = std::abs((int)a[i * 4 + c] - (int)b[i * 4 + c]);
+                d = std::max(d, v);
+                sum += (uint64_t)v;
+            }
+            maxDiff = std::max(maxDiff, d);
+            differing += (d > 32) ? 1u : 0u;
+        }
+
+        std::printf("[Headless] gl vs cpu: mean |diff|=%.3f max=%d, %zu of %zu pixels differ by more than 32 (%.2f%%)\n",
+            pixels ? (double)sum / (double)(pixels * 3) : 0.0, maxDiff, differing, pixels,
+            pixels ? 100.0 * (double)differing / (double)pixels : 0.0);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    HeadlessContext gl;
+    if (!opt.cpu && !gl.Init(opt.width, opt.height))
+        return 1;
+
+    Application app;
+    StatefulVectorRenderer renderer;
+    if (!opt.cpu)
+        renderer.Init();
+
+    SoftwareLineRasterizer raster;
+    raster.Resize(opt.width, opt.height);
+    raster.SetAntialiasing(opt.antialias);
+
+    const glm::vec4 clearColor(0.07f, 0.07f, 0.08f, 1.0f);
+
+    app.Init(opt.width, opt.height);
+    app.SetMouseClient(opt.width / 2, opt.height / 2);
+    renderer.SetEntityBook(&app.GetEntityBook());
+    renderer.SetOverlayLines(&app.GetOverlayLines());
+
+    if (opt.batchThreads >= 0)
+        renderer.SetBatchThreads((unsigned)opt.batchThreads);
+    if (opt.asyncBatches)
+        renderer.SetAsyncBatchMin(0);
+    if (opt.tileCache)
+        renderer.ToggleTileCache();
+    if (opt.stats)
+        app.ToggleFrameStats();
+
+    // Fixed step so runs are repeatable.
+    const float dt = 1.0f / 60.0f;
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    Timing timing;
+    timing.frame.reserve((std::size_t)opt.frames);
+
+    FrameScheduler scheduler;
+    const bool input = opt.panX != 0 || opt.panY != 0 || opt.zoom != 1.0f;
+
+    for (int frame = 0; frame < opt.warmup + opt.frames; ++frame)
+    {
+        if (frame > 0)
+        {
+            if (opt.panX != 0 || opt.panY != 0)
+                app.PanByPixels(opt.panX, opt.panY);
+            if (opt.zoom != 1.0f)
+                app.ZoomAtClient(opt.width / 2, opt.height / 2, opt.zoom);
+        }
+
+        if (opt.onDemand)
+        {
+            const auto tick = FrameScheduler::Clock::time_point{} +
+                std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::duration<double>(frame * dt));
+            if (frame > 0 && input)
+                scheduler.Invalidate();
+            if (!scheduler.IsFrameDue(tick))
+                continue;
+
+            scheduler.BeginFrame(tick);
+        }
+
+        FrameProfiler::BeginFrame();
+        if (frame == opt.warmup)
+        {
+            GLStateCache::ResetStats();
+            HersheyTextCache::ResetStats();
+        }
+
+        const auto t0 = Clock::now();
+        app.Update(dt);
+
+        const auto t1 = Clock::now();
+        const RenderContext ctx = MakeContext(app);
+        if (opt.cpu)
+        {
+            raster.Clear(clearColor);
+            renderer.RasterizeSoftware(ctx, raster);
+        }
+        else
+        {
+            gl.BindFramebuffer();
+            GLStateCache::Viewport(0, 0, opt.width, opt.height);
+            GLStateCache::ClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            renderer.Redraw(ctx);
+        }
+
+        const auto t2 = Clock::now();
+        if (!opt.cpu)
+            glFinish();
+        const auto t3 = Clock::now();
+        FrameProfiler::EndFrame(ms(t0, t3));
+
+        if (opt.onDemand)
+        {
+            // Same follow-up frames as the Win32 loop, on the simulated clock.
+            const auto last = scheduler.GetLastFrameTime();
+            if (app.HasPendingWork() || renderer.HasPendingWork())
+                scheduler.InvalidateAt(last + std::chrono::milliseconds(FRAME_SCHEDULER_POLL_MS));
+            if (app.IsFrameStatsVisible())
+                scheduler.InvalidateAt(last + std::chrono::duration_cast<FrameScheduler::Clock::duration>(
+                    std::chrono::duration<float>(FRAME_STATS_HUD_INTERVAL)));
+        }
+
+        if (frame < opt.warmup)
+            continue;
+
+        timing.frame.push_back(ms(t0, t3));
+        timing.update += ms(t0, t1);
+        timing.submit += ms(t1, t2);
+        timing.finish += ms(t2, t3);
+    }
+
+    PrintTiming(timing);
+    if (opt.onDemand)
+    {
+        const auto& ss = scheduler.GetStats();
+        std::printf("[Headless] on-demand: rendered %llu of %d ticks (%llu invalidations)\n",
+            (unsigned long long)ss.frames, opt.warmup + opt.frames, (unsigned long long)ss.invalidations);
+    }
+    FrameProfiler::BeginFrame(); // collect the last frames' GPU queries
+    std::printf("[Headless] sections (rolling, last %d frames):\n%s", FRAME_STATS_WINDOW, FrameProfiler::Format().c_str());
+
+    const HersheyTextCache::Stats text = HersheyTextCache::GetStats();
+    std::printf("[Headless] text cache: hits=%llu misses=%llu evictions=%llu entries=%zu segments=%zu\n",
+        (unsigned long long)text.hits, (unsigned long long)text.misses, (unsigned long long)text.evictions,
+        text.entries, text.segments);
+
+    if (opt.cpu)
+    {
+        const auto& rs = raster.GetStats();
+        std::printf("[Headless] cpu raster: %zu segments, %zu tile refs, setup=%.3f raster=%.3f ms (last frame)\n",
+            rs.segments, rs.tileRefs, rs.setupMilliseconds, rs.rasterMilliseconds);
+
+        if (!opt.out.empty())
+        {
+            std::vector<uint8_t> rgba;
+            raster.ReadPixels(rgba);
+            if (!HeadlessContext::WritePPM(opt.out, rgba, raster.GetWidth(), raster.GetHeight()))
+                return 1;
+            std::printf("[Headless] wrote %s (%dx%d)\n", opt.out.c_str(), raster.GetWidth(), raster.GetHeight());
+        }
+        return 0;
+    }
+
+    const auto& lod = renderer.GetLodStats();
+    std::printf("[Headless] lod chunks=%zu simplified=%zu packed=%zu culled=%zu instances=%zu/%zu static=%.1f KiB\n",
+        lod.chunks, lod.simplifiedChunks, lod.packedChunks, lod.culledChunks, lod.drawnInstances, lod.sourceInstances,
+        lod.staticBytes / 1024.0);
+    if (opt.asyncBatches)
+    {
+        const auto& ab = renderer.GetAsyncBatchStats();
+        std::printf("[Headless] async batches: requested=%llu swapped=%llu upload frames=%llu\n",
+            (unsigned long long)ab.requested, (unsigned long long)ab.swapped, (unsigned long long)ab.uploadFrames);
+    }
+    if (renderer.IsTileCacheEnabled())
+    {
+        const auto& tiles = renderer.GetTileStats();
+        std::printf("[Headless] tiles=%zu visible=%zu pending=%zu evicted=%zu\n",
+            tiles.tiles, tiles.visible, tiles.pending, tiles.evicted);
+    }
+
+    std::printf("[Headless] overlay: %zu lines, %llu bytes streamed (last frame)\n",
+        app.GetOverlayLines().size(), (unsigned long long)renderer.GetOverlayStreamStats().frameBytes);
+
+    const auto& gs = GLStateCache::GetStats();
+    const double perFrame = 1.0 / (double)std::max(opt.frames, 1);
+    std::printf("[Headless] gl state: issued=%.1f skipped=%.1f camera=%.1f per frame\n",
+        gs.issued * perFrame, gs.skipped * perFrame, gs.cameraUploads * perFrame);
+
+    const GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+        std::printf("[Headless] GL error 0x%x\n", err);
+
+    if (opt.compare)
+    {
+        // Same batches and levels of detail as the GL frame, same camera.
+        std::vector<uint8_t> glPixels, cpuPixels;
+        gl.ReadPixels(glPixels);
+
+        raster.Clear(clearColor);
+        renderer.RasterizeSoftware(MakeContext(app), raster);
+        raster.ReadPixels(cpuPixels);
+
+        PrintDiff(glPixels, cpuPixels);
+    }
+
+    if (!opt.out.empty())
+    {
+        if (!gl.WritePPM(opt.out))
+            return 1;
+        std::printf("[Headless] wrote %s (%dx%d)\n", opt.out.c_str(), gl.GetWidth(), gl.GetHeight());
+    }
+
+    return err == GL_NO_ERROR ? 0 : 1;
+}
@@ -113,13 +113,13 @@ namespace
         return lines;
     }
 
-    static void EmitGlyphLines(
+    // Calls emit(a, b) for every stroke of a glyph, offset by penOrigin.
+    template <typename Emit>
+    static void EmitGlyphStrokes(
         const hershey_glyph* g,
         float scale,
-        const glm::vec3& penOrigin,
-        const glm::vec4& color,
-        float strokeWidth,
-        std::vector<LineEntity>& out)
+        const glm::vec2& penOrigin,
+        Emit&& emit)
     {
         if (!g) return;
 
@@ -129,57 +129,35 @@ namespace
 
             for (unsigned int i = 0; i + 1 < p->nverts; ++i)
             {
-                glm::vec3 a(
+                const glm::vec2 a(
                     penOrigin.x + (float)p->verts[i].x * scale,
-                    penOrigin.y + (float)p->verts[i].y * scale,
-                    penOrigin.z);
+                    penOrigin.y + (float)p->verts[i].y * scale);
 
-                glm::vec3 b(
+                const glm::vec2 b(
                     penOrigin.x + (float)p->verts[i + 1].x * scale,
-                    penOrigin.y + (float)p->verts[i + 1].y * scale,
-                    penOrigin.z);
+                    penOrigin.y + (float)p->verts[i + 1].y * scale);
 
-                LineEntity e;
-                e.start = a;
-                e.end = b;
-                e.color = color;
-                e.width = strokeWidth;
-                out.push_back(e);
+                emit(a, b);
             }
         }
     }
-}
-
-namespace HersheyTextBuilder
-{
-    float MeasureTextWidth(const std::string& s, hershey_font* font, float scale)
-    {
-        return StringWidth(font, s, scale);
-    }
-
-    std::vector<std::string> BuildTextLines(const TextEntity& text)
-    {
-        if (text.wordWrapEnabled)
-            return WrapTextWords(text.text, text.font, text.scale, text.boxWidth);
-        return SplitExplicitLines(text.text);
-    }
 
-    void BuildLines(const TextEntity& text, std::vector<LineEntity>& outLines)
+    // Lays the text out with its box's top-left corner at origin (the position
+    // of its first line's left edge and the top of the box).
+    template <typename Emit>
+    static void LayoutStrokes(const TextEntity& text, const glm::vec2& origin, Emit&& emit)
     {
-        if (!text.font) return;
-
         const float scale = text.scale;
 
-        const float topY = text.position.y + text.boxHeight;
-        float yTop = topY - (kTopPadding * scale);
+        float yTop = origin.y - (kTopPadding * scale);
 
-        std::vector<std::string> lines = BuildTextLines(text);
+        std::vector<std::string> lines = HersheyTextBuilder::BuildTextLines(text);
 
         for (const std::string& line : lines)
         {
             const float lineW = StringWidth(text.font, line, scale);
 
-            float x = text.position.x;
+            float x = origin.x;
             if (text.hAlign == TextHAlign::Right)
                 x += std::max(0.0f, text.boxWidth - lineW);
             else if (text.hAlign == TextHAlign::Center)
@@ -194,15 +172,7 @@ namespace HersheyTextBuilder
 
                 hershey_glyph* g = hershey_font_glyph(text.font, (unsigned int)c);
                 if (g)
-                {
-                    EmitGlyphLines(
-                        g,
-                        scale,
-                        glm::vec3(x, baselineY, text.position.z),
-                        text.color,
-                        text.strokeWidth,
-                        outLines);
-                }
+                    EmitGlyphStrokes(g, scale, glm::vec2(x, baselineY), emit);
 
                 x += GlyphAdvance(text.font, c, scale);
             }
@@ -212,3 +182,49 @@ namespace HersheyTextBuilder
     }
 }
 
+namespace HersheyTextBuilder
+{
+    float MeasureTextWidth(const std::string& s, hershey_font* font, float scale)
+    {
+        return StringWidth(font, s, scale);
+    }
+
+    std::vector<std::string> BuildTextLines(const TextEntity& text)
+    {
+        if (text.wordWrapEnabled)
+            return WrapTextWords(text.text, text.font, text.scale, text.boxWidth);
+        return SplitExplicitLines(text.text);
+    }
+
+    void BuildLines(const TextEntity& text, std::vector<LineEntity>& outLines)
+    {
+        if (!text.font) return;
+
+        const float z = text.position.z;
+        LayoutStrokes(text, GetLayoutOrigin(text), [&](const glm::vec2& a, const glm::vec2& b)
+            {
+                LineEntity e;
+                e.start = glm::vec3(a, z);
+                e.end = glm::vec3(b, z);
+                e.color = text.color;
+                e.width = text.strokeWidth;
+                outLines.push_back(e);
+            });
+    }
+
+    glm::vec2 GetLayoutOrigin(const TextEntity& text)
+    {
+        return glm::vec2(text.position.x, text.position.y + text.boxHeight);
+    }
+
+    void BuildLocalStrokes(const TextEntity& text, std::vector<glm::vec2>& outPoints)
+    {
+        if (!text.font) return;
+
+        LayoutStrokes(text, glm::vec2(0.0f), [&](const glm::vec2& a, const glm::vec2& b)
+            {
+                outPoints.push_back(a);
+                outPoints.push_back(b);
+            });
+    }
+}
@@ -16,5 +16,14 @@ namespace HersheyTextBuilder
 
     // Expand the text into line segments.
     void BuildLines(const TextEntity& text, std::vector<LineEntity>& outLines);
+
+    // Where BuildLocalStrokes' (0, 0) lands in world space for this text.
+    glm::vec2 GetLayoutOrigin(const TextEntity& text);
+
+    // The same strokes relative to GetLayoutOrigin(), as endpoint pairs. They
+    // depend only on the string, font, scale, box width, wrapping and
+    // alignment; position, box height, color and stroke width are applied by
+    // the caller (see HersheyTextCache).
+    void BuildLocalStrokes(const TextEntity& text, std::vector<glm::vec2>& outPoints);
 }
 
@@ -0,0 +1,176 @@
+// HersheyTextCache.cpp
+#include "HersheyTextCache.h"
+#include "HersheyTextBuilder.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+    struct Key
+    {
+        std::string text;
+        const hershey_font* font = nullptr;
+        float scale = 0.0f;
+        float boxWidth = 0.0f;
+        bool wrap = false;
+        TextHAlign align = TextHAlign::Left;
+
+        bool operator==(const Key& o) const
+        {
+            return text == o.text && font == o.font && scale == o.scale &&
+                boxWidth == o.boxWidth && wrap == o.wrap && align == o.align;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& k) const
+        {
+            std::size_t h = std::hash<std::string>()(k.text);
+            auto mix = [&h](std::size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+            mix(std::hash<const void*>()(k.font));
+            mix(std::hash<float>()(k.scale));
+            mix(std::hash<float>()(k.boxWidth));
+            mix((std::size_t)k.wrap | ((std::size_t)k.align << 1));
+            return h;
+        }
+    };
+
+    // Endpoint pairs relative to HersheyTextBuilder::GetLayoutOrigin().
+    using Strokes = std::vector<glm::vec2>;
+
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<const Strokes> strokes;
+    };
+
+    struct State
+    {
+        std::mutex mutex;
+        std::list<Entry> lru; // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        std::size_t segments = 0;
+        HersheyTextCache::Stats stats;
+    };
+
+    State& Get()
+    {
+        static State state;
+        return state;
+    }
+
+    Key MakeKey(const TextEntity& text)
+    {
+        Key k;
+        k.text = text.text;
+        k.font = text.font;
+        k.scale = text.scale;
+        k.wrap = text.wordWrapEnabled;
+        k.align = text.hAlign;
+
+        // The box width only matters to wrapping and alignment.
+        if (k.wrap || k.align != TextHAlign::Left)
+            k.boxWidth = text.boxWidth;
+        return k;
+    }
+}
+
+namespace HersheyTextCache
+{
+    void BuildLines(const TextEntity& text, std::vector<LineEntity>& outLines)
+    {
+        if (!text.font)
+            return;
+
+        State& s = Get();
+        Key key = MakeKey(text);
+        std::shared_ptr<const Strokes> strokes;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto it = s.index.find(key);
+            if (it != s.index.end())
+            {
+                s.lru.splice(s.lru.begin(), s.lru, it->second);
+                strokes = it->second->strokes;
+                ++s.stats.hits;
+            }
+            else
+            {
+                ++s.stats.misses;
+            }
+        }
+
+        if (!strokes)
+        {
+            auto built = std::make_shared<Strokes>();
+            HersheyTextBuilder::BuildLocalStrokes(text, *built);
+            strokes = built;
+
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.index.find(key) == s.index.end()) // another thread may have won
+            {
+                const std::size_t segments = built->size() / 2;
+                s.lru.push_front(Entry{ key, strokes });
+                s.index.emplace(std::move(key), s.lru.begin());
+                s.segments += segments;
+
+                while (s.segments > HERSHEY_TEXT_CACHE_SEGMENTS && s.lru.size() > 1)
+                {
+                    const Entry& victim = s.lru.back();
+                    s.segments -= victim.strokes->size() / 2;
+                    s.index.erase(victim.key);
+                    s.lru.pop_back();
+                    ++s.stats.evictions;
+                }
+            }
+        }
+
+        const glm::vec2 origin = HersheyTextBuilder::GetLayoutOrigin(text);
+        const float z = text.position.z;
+        const Strokes& points = *strokes;
+        outLines.reserve(outLines.size() + points.size() / 2);
+        for (std::size_t i = 0; i + 1 < points.size(); i += 2)
+        {
+            LineEntity e;
+            e.start = glm::vec3(origin + points[i], z);
+            e.end = glm::vec3(origin + points[i + 1], z);
+            e.color = text.color;
+            e.width = text.strokeWidth;
+            outLines.push_back(e);
+        }
+    }
+
+    void Clear()
+    {
+        State& s = Get();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.lru.clear();
+        s.index.clear();
+        s.segments = 0;
+    }
+
+    Stats GetStats()
+    {
+        State& s = Get();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        Stats stats = s.stats;
+        stats.entries = s.index.size();
+        stats.segments = s.segments;
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        State& s = Get();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.stats.hits = 0;
+        s.stats.misses = 0;
+        s.stats.evictions = 0;
+    }
+}
@@ -0,0 +1,40 @@
+// HersheyTextCache.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "LineEntity.h"
+#include "TextEntity.h"
+
+#ifndef HERSHEY_TEXT_CACHE_SEGMENTS
+// Segments kept across all cached strings; the least recently used strings
+// are evicted past it.
+#define HERSHEY_TEXT_CACHE_SEGMENTS (256u << 10)
+#endif
+
+// Tessellated Hershey text, reused across frames and rebuilds. Entries hold
+// HersheyTextBuilder::BuildLocalStrokes() output keyed by everything the layout
+// depends on (string, font, scale, box width, wrapping, alignment), so a hit
+// only has to translate the strokes to the text's position and apply its color
+// and stroke width. Thread-safe; a miss lays the text out without holding the
+// lock.
+namespace HersheyTextCache
+{
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        std::size_t entries = 0;
+        std::size_t segments = 0; // cached, all entries
+    };
+
+    // Same output as HersheyTextBuilder::BuildLines (appended to outLines).
+    void BuildLines(const TextEntity& text, std::vector<LineEntity>& outLines);
+
+    void Clear();
+
+    Stats GetStats();
+    void ResetStats(); // counters only; entries stay
+}
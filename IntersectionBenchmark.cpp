@@ -0,0 +1,104 @@
+// IntersectionBenchmark.cpp
+#include "IntersectionBenchmark.h"
+#include "SegmentIntersector.h"
+#include "SegmentMath.h"
+#include "DragonCurve.h"
+#include "ParallelFor.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::vector<IntersectSegment> MakeDragon(int iterations)
+    {
+        DragonCurve curve;
+        const auto segs = curve.Build(iterations, glm::vec3(0.0f));
+
+        std::vector<IntersectSegment> out;
+        out.reserve(segs.size());
+        for (std::size_t i = 0; i < segs.size(); ++i)
+            out.push_back({ glm::vec2(segs[i].a), glm::vec2(segs[i].b), i + 1 });
+        return out;
+    }
+
+    // Random segments of roughly maxLen inside a square of the given extent.
+    std::vector<IntersectSegment> MakeSoup(std::size_t count, float extent, float maxLen, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> pos(0.0f, extent);
+        std::uniform_real_distribution<float> off(-maxLen, maxLen);
+
+        std::vector<IntersectSegment> out;
+        out.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const glm::vec2 a(pos(rng), pos(rng));
+            out.push_back({ a, a + glm::vec2(off(rng), off(rng)), i + 1 });
+        }
+        return out;
+    }
+
+    std::size_t BruteForceCount(const std::vector<IntersectSegment>& segs, const SegmentIntersector::Options& o)
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < segs.size(); ++i)
+            for (std::size_t j = i + 1; j < segs.size(); ++j)
+            {
+                glm::vec2 pts[2];
+                count += (std::size_t)SegmentMath::Intersect(segs[i].a, segs[i].b, segs[j].a, segs[j].b, pts,
+                    o.includeVertexTouches, o.includeOverlaps);
+            }
+        return count;
+    }
+
+    void RunCase(const char* name, const std::vector<IntersectSegment>& segs, bool includeVertexTouches)
+    {
+        SegmentIntersector::Options opt;
+        opt.includeVertexTouches = includeVertexTouches;
+
+        SegmentIntersector::Stats single{}, multi{};
+
+        opt.threads = 1;
+        const auto r1 = SegmentIntersector::FindAll(segs, opt, &single);
+
+        opt.threads = 0;
+        const auto rN = SegmentIntersector::FindAll(segs, opt, &multi);
+
+        const bool same = (r1.size() == rN.size());
+
+        std::string check = "skipped";
+        if (segs.size() <= 5000)
+            check = (BruteForceCount(segs, opt) == rN.size()) ? "ok" : "MISMATCH";
+
+        std::printf("[IntersectBench] %-22s segs=%8zu hits=%8zu tiles=%zux%zu tests=%10zu  1T=%8.2fms  %uT=%8.2fms  (%.1fx)  threads-agree=%s brute=%s\n",
+            name, segs.size(), rN.size(), multi.tilesX, multi.tilesY, multi.pairTests,
+            single.milliseconds, DefaultWorkerCount(), multi.milliseconds,
+            multi.milliseconds > 0.0 ? single.milliseconds / multi.milliseconds : 0.0,
+            same ? "yes" : "NO", check.c_str());
+    }
+}
+
+namespace IntersectionBenchmark
+{
+    void Run()
+    {
+        std::printf("[IntersectBench] starting (%u hardware threads)\n", DefaultWorkerCount());
+
+        // Dragon curve: polyline joints + corner touches are the interesting part.
+        RunCase("dragon 12 (joints)", MakeDragon(12), true);
+        RunCase("dragon 16 (joints)", MakeDragon(16), true);
+        RunCase("dragon 20 (crossings)", MakeDragon(20), false);
+
+        // Random soups: short segments (local density) and long ones (many tiles each).
+        RunCase("soup 4k short", MakeSoup(4000, 1000.0f, 20.0f, 1u), false);
+        RunCase("soup 4k long", MakeSoup(4000, 1000.0f, 200.0f, 2u), false);
+        RunCase("soup 1M short", MakeSoup(1000000, 100000.0f, 60.0f, 3u), false);
+        RunCase("soup 100k long", MakeSoup(100000, 100000.0f, 2000.0f, 4u), false);
+
+        std::printf("[IntersectBench] done\n");
+    }
+}
@@ -0,0 +1,9 @@
+// IntersectionBenchmark.h
+#pragma once
+
+// Console benchmark for SegmentIntersector: dragon curves and random line soups,
+// single-threaded vs. all cores, cross-checked against brute force on small inputs.
+namespace IntersectionBenchmark
+{
+    void Run();
+}
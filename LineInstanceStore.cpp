@@ -0,0 +1,529 @@
+// LineInstanceStore.cpp
+#include "LineInstanceStore.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Dirty ranges closer than this (in instances) are uploaded as one call;
+    // re-sending a few clean instances is cheaper than another driver call.
+    constexpr uint32_t kMergeGap = 256;
+
+    // Compact an arena once holes exceed this many instances and a quarter of it.
+    constexpr std::size_t kCompactMinHoles = 4096;
+
+    constexpr uint32_t kMinCapacity = 1024;
+}
+
+void SetupLineInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset)
+{
+    GLStateCache::BindVertexArray(vao);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // All attributes advance per instance; the quad corner comes from gl_VertexID.
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(LineInstance), (void*)(baseOffset + offsetof(LineInstance, p0)));
+    glVertexAttribDivisor(0, 1);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LineInstance), (void*)(baseOffset + offsetof(LineInstance, p1)));
+    glVertexAttribDivisor(1, 1);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineInstance), (void*)(baseOffset + offsetof(LineInstance, color)));
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(LineInstance), (void*)(baseOffset + offsetof(LineInstance, width)));
+    glVertexAttribDivisor(3, 1);
+}
+
+void SetupPackedLineInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset)
+{
+    GLStateCache::BindVertexArray(vao);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // Same locations as LineInstance; positions are raw int16 steps (converted
+    // to float, not normalized) and the chunk index stays an integer.
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(PackedLineInstance), (void*)(baseOffset + offsetof(PackedLineInstance, p0)));
+    glVertexAttribDivisor(0, 1);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(PackedLineInstance), (void*)(baseOffset + offsetof(PackedLineInstance, p1)));
+    glVertexAttribDivisor(1, 1);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedLineInstance), (void*)(baseOffset + offsetof(PackedLineInstance, color)));
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedLineInstance), (void*)(baseOffset + offsetof(PackedLineInstance, width)));
+    glVertexAttribDivisor(3, 1);
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_SHORT, sizeof(PackedLineInstance), (void*)(baseOffset + offsetof(PackedLineInstance, chunk)));
+    glVertexAttribDivisor(4, 1);
+}
+
+namespace
+{
+    void SetupInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset, const LineInstance*)
+    {
+        SetupLineInstanceAttributes(vao, vbo, baseOffset);
+    }
+
+    void SetupInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset, const PackedLineInstance*)
+    {
+        SetupPackedLineInstanceAttributes(vao, vbo, baseOffset);
+    }
+}
+
+// ------------------------------------------------------------
+// Keys
+// ------------------------------------------------------------
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Set(uint64_t key, int layer, const Instance* data, std::size_t count)
+{
+    const uint32_t n = static_cast<uint32_t>(count);
+
+    auto it = m_slots.find(key);
+    if (it != m_slots.end() && it->second.layer == layer && n <= it->second.range.count)
+    {
+        // Fits in place: upload only the instances that actually changed.
+        Slot& slot = it->second;
+        Arena& a = m_arenas[layer];
+
+        uint32_t lo = UINT32_MAX, hi = 0;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            Instance& dst = a.shadow[slot.range.first + i];
+            if (std::memcmp(&dst, &data[i], sizeof(Instance)) != 0)
+            {
+                dst = data[i];
+                lo = std::min(lo, i);
+                hi = std::max(hi, i);
+            }
+        }
+        if (lo <= hi)
+            MarkDirty(a, slot.range.first + lo, hi - lo + 1);
+
+        if (n < slot.range.count)
+        {
+            Free(a, Range{ slot.range.first + n, slot.range.count - n });
+            slot.range.count = n;
+        }
+
+        slot.stamp = m_syncStamp;
+        return;
+    }
+
+    Instance* dst = Emplace(key, layer, count);
+    if (n > 0)
+        std::memcpy(dst, data, n * sizeof(Instance));
+}
+
+template <typename Instance>
+Instance* BasicLineInstanceStore<Instance>::Emplace(uint64_t key, int layer, std::size_t count)
+{
+    const uint32_t n = static_cast<uint32_t>(count);
+
+    auto it = m_slots.find(key);
+    if (it != m_slots.end())
+        Free(m_arenas[it->second.layer], it->second.range);
+
+    Arena& a = m_arenas[layer];
+    const Range r = Allocate(a, n);
+    if (n > 0)
+        MarkDirty(a, r.first, n);
+
+    Slot& slot = m_slots[key];
+    slot.layer = layer;
+    slot.range = r;
+    slot.stamp = m_syncStamp;
+    return (n > 0) ? &a.shadow[r.first] : nullptr;
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Remove(uint64_t key)
+{
+    auto it = m_slots.find(key);
+    if (it == m_slots.end())
+        return;
+
+    Free(m_arenas[it->second.layer], it->second.range);
+    m_slots.erase(it);
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Clear()
+{
+    for (auto& kv : m_arenas)
+    {
+        Arena& a = kv.second;
+        a.shadow.clear();
+        a.freeList.clear();
+        a.dirty.clear();
+        a.holes = 0;
+    }
+    m_slots.clear();
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::EndSync()
+{
+    std::vector<uint64_t> stale;
+    for (const auto& kv : m_slots)
+        if (kv.second.stamp != m_syncStamp)
+            stale.push_back(kv.first);
+
+    for (uint64_t key : stale)
+        Remove(key);
+}
+
+// ------------------------------------------------------------
+// Ranges
+// ------------------------------------------------------------
+template <typename Instance>
+typename BasicLineInstanceStore<Instance>::Range BasicLineInstanceStore<Instance>::Allocate(Arena& a, uint32_t count)
+{
+    if (count == 0)
+        return Range{};
+
+    // First fit keeps low addresses packed.
+    for (std::size_t i = 0; i < a.freeList.size(); ++i)
+    {
+        Range& hole = a.freeList[i];
+        if (hole.count < count)
+            continue;
+
+        const Range r{ hole.first, count };
+        hole.first += count;
+        hole.count -= count;
+        if (hole.count == 0)
+            a.freeList.erase(a.freeList.begin() + i);
+        a.holes -= count;
+        return r;
+    }
+
+    const Range r{ static_cast<uint32_t>(a.shadow.size()), count };
+    a.shadow.resize(a.shadow.size() + count);
+    return r;
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Free(Arena& a, Range r)
+{
+    if (r.count == 0)
+        return;
+
+    // Blank the range so it draws nothing until reused.
+    const Instance blank{};
+    std::fill(a.shadow.begin() + r.first, a.shadow.begin() + r.first + r.count, blank);
+
+    if (r.first + r.count == a.shadow.size())
+    {
+        // Tail: just lower the high-water mark (and swallow any hole now at the end).
+        a.shadow.resize(r.first);
+        while (!a.freeList.empty() && a.freeList.back().first + a.freeList.back().count == a.shadow.size())
+        {
+            a.shadow.resize(a.freeList.back().first);
+            a.holes -= a.freeList.back().count;
+            a.freeList.pop_back();
+        }
+        return;
+    }
+
+    MarkDirty(a, r.first, r.count);
+
+    auto pos = std::lower_bound(a.freeList.begin(), a.freeList.end(), r,
+        [](const Range& x, const Range& y) { return x.first < y.first; });
+    pos = a.freeList.insert(pos, r);
+    a.holes += r.count;
+
+    // Coalesce with the following and preceding holes.
+    auto next = pos + 1;
+    if (next != a.freeList.end() && pos->first + pos->count == next->first)
+    {
+        pos->count += next->count;
+        pos = a.freeList.erase(next) - 1;
+    }
+    if (pos != a.freeList.begin())
+    {
+        auto prev = pos - 1;
+        if (prev->first + prev->count == pos->first)
+        {
+            prev->count += pos->count;
+            a.freeList.erase(pos);
+        }
+    }
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::MarkDirty(Arena& a, uint32_t first, uint32_t count)
+{
+    if (count > 0)
+        a.dirty.push_back(Range{ first, count });
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Compact(int layer, Arena& a)
+{
+    // Keep the current relative order of the live ranges.
+    std::vector<Slot*> live;
+    for (auto& kv : m_slots)
+        if (kv.second.layer == layer && kv.second.range.count > 0)
+            live.push_back(&kv.second);
+
+    std::sort(live.begin(), live.end(),
+        [](const Slot* x, const Slot* y) { return x->range.first < y->range.first; });
+
+    std::vector<Instance> packed;
+    packed.reserve(a.shadow.size() - a.holes);
+    for (Slot* s : live)
+    {
+        const uint32_t first = static_cast<uint32_t>(packed.size());
+        packed.insert(packed.end(), a.shadow.begin() + s->range.first, a.shadow.begin() + s->range.first + s->range.count);
+        s->range.first = first;
+    }
+
+    a.shadow.swap(packed);
+    a.freeList.clear();
+    a.holes = 0;
+    a.dirty.clear();
+    MarkDirty(a, 0, static_cast<uint32_t>(a.shadow.size()));
+
+    ++m_stats.compactions;
+}
+
+// ------------------------------------------------------------
+// GPU
+// ------------------------------------------------------------
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Grow(Arena& a, uint32_t needed)
+{
+    uint32_t capacity = std::max(kMinCapacity, a.capacity);
+    while (capacity < needed)
+        capacity *= 2;
+
+    GLuint vbo = 0;
+    glGenBuffers(1, &vbo);
+    GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+
+    // Keep what is already on the GPU; only dirty ranges get re-sent.
+    if (a.vbo && a.capacity)
+    {
+        GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, a.vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, a.capacity * sizeof(Instance));
+        GLStateCache::DeleteBuffer(a.vbo);
+    }
+
+    a.vbo = vbo;
+    a.capacity = capacity;
+
+    if (!a.vao)
+        glGenVertexArrays(1, &a.vao);
+    SetupInstanceAttributes(a.vao, a.vbo, 0, static_cast<const Instance*>(nullptr));
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Flush()
+{
+    m_stats.uploadCalls = 0;
+    m_stats.uploadedBytes = 0;
+    m_stats.usedInstances = 0;
+    m_stats.capacityInstances = 0;
+    m_stats.capacityBytes = 0;
+    m_stats.liveInstances = 0;
+
+    for (auto& kv : m_arenas)
+    {
+        Arena& a = kv.second;
+
+        if (a.holes >= kCompactMinHoles && a.holes * 4 > a.shadow.size())
+            Compact(kv.first, a);
+
+        const uint32_t used = static_cast<uint32_t>(a.shadow.size());
+        if (used > a.capacity)
+            Grow(a, used);
+
+        if (!a.dirty.empty())
+        {
+            std::sort(a.dirty.begin(), a.dirty.end(),
+                [](const Range& x, const Range& y) { return x.first < y.first; });
+
+            GLStateCache::BindBuffer(GL_ARRAY_BUFFER, a.vbo);
+
+            auto upload = [&](Range r)
+                {
+                    // Ranges past the high-water mark were trimmed; nothing draws there.
+                    if (r.first >= used)
+                        return;
+                    r.count = std::min(r.count, used - r.first);
+                    glBufferSubData(GL_ARRAY_BUFFER, r.first * sizeof(Instance), r.count * sizeof(Instance), &a.shadow[r.first]);
+                    ++m_stats.uploadCalls;
+                    m_stats.uploadedBytes += r.count * sizeof(Instance);
+                };
+
+            Range cur = a.dirty.front();
+            for (std::size_t i = 1; i < a.dirty.size(); ++i)
+            {
+                const Range& r = a.dirty[i];
+                if (r.first <= cur.first + cur.count + kMergeGap)
+                {
+                    cur.count = std::max(cur.first + cur.count, r.first + r.count) - cur.first;
+                    continue;
+                }
+                upload(cur);
+                cur = r;
+            }
+            upload(cur);
+
+            a.dirty.clear();
+        }
+
+        m_stats.usedInstances += used;
+        m_stats.capacityInstances += a.capacity;
+        m_stats.capacityBytes += a.capacity * sizeof(Instance);
+        m_stats.liveInstances += used - a.holes;
+    }
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Draw() const
+{
+    for (const auto& kv : m_arenas)
+    {
+        const Arena& a = kv.second;
+        if (a.shadow.empty() || !a.vao)
+            continue;
+
+        GLStateCache::BindVertexArray(a.vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(a.shadow.size()));
+    }
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Draw(int layer) const
+{
+    auto it = m_arenas.find(layer);
+    if (it == m_arenas.end() || it->second.shadow.empty() || !it->second.vao)
+        return;
+
+    GLStateCache::BindVertexArray(it->second.vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(it->second.shadow.size()));
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::CollectLayers(std::vector<int>& out) const
+{
+    for (const auto& kv : m_arenas)
+        if (!kv.second.shadow.empty())
+            out.push_back(kv.first);
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::DrawKeys(const uint64_t* keys, std::size_t count, std::optional<int> layer) const
+{
+    struct Run
+    {
+        int layer;
+        Range range;
+    };
+
+    std::vector<Run> runs;
+    runs.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto it = m_slots.find(keys[i]);
+        if (it != m_slots.end() && it->second.range.count > 0 && (!layer || it->second.layer == *layer))
+            runs.push_back(Run{ it->second.layer, it->second.range });
+    }
+    if (runs.empty())
+        return;
+
+    std::sort(runs.begin(), runs.end(), [](const Run& x, const Run& y)
+        {
+            return (x.layer != y.layer) ? x.layer < y.layer : x.range.first < y.range.first;
+        });
+
+    // No base-instance draws in GL 3.3: re-point the attributes at each run.
+    auto drawRun = [this](int layer, Range r)
+        {
+            const Arena& a = m_arenas.at(layer);
+            if (!a.vao || r.first >= a.capacity)
+                return;
+            r.count = std::min(r.count, a.capacity - r.first);
+
+            SetupInstanceAttributes(a.vao, a.vbo, (GLintptr)r.first * sizeof(Instance), static_cast<const Instance*>(nullptr));
+            GLStateCache::BindVertexArray(a.vao);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(r.count));
+        };
+
+    // Leave the arena VAOs pointing at the start of their buffers for Draw().
+    auto restore = [this](int layer)
+        {
+            const Arena& a = m_arenas.at(layer);
+            if (a.vao)
+                SetupInstanceAttributes(a.vao, a.vbo, 0, static_cast<const Instance*>(nullptr));
+        };
+
+    Run cur = runs.front();
+    int lastLayer = cur.layer;
+    for (std::size_t i = 1; i < runs.size(); ++i)
+    {
+        const Run& r = runs[i];
+        // Instances in a small gap (holes or other keys) just draw extra.
+        if (r.layer == cur.layer && r.range.first <= cur.range.first + cur.range.count + kMergeGap)
+        {
+            cur.range.count = std::max(cur.range.first + cur.range.count, r.range.first + r.range.count) - cur.range.first;
+            continue;
+        }
+
+        drawRun(cur.layer, cur.range);
+        if (r.layer != lastLayer)
+        {
+            restore(lastLayer);
+            lastLayer = r.layer;
+        }
+        cur = r;
+    }
+    drawRun(cur.layer, cur.range);
+    restore(lastLayer);
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::Read(int layer, std::vector<Instance>& out) const
+{
+    auto it = m_arenas.find(layer);
+    if (it != m_arenas.end())
+        out.insert(out.end(), it->second.shadow.begin(), it->second.shadow.end());
+}
+
+template <typename Instance>
+void BasicLineInstanceStore<Instance>::ReadKeys(const uint64_t* keys, std::size_t count, int layer, std::vector<Instance>& out) const
+{
+    auto arena = m_arenas.find(layer);
+    if (arena == m_arenas.end())
+        return;
+
+    // Buffer order, like DrawKeys (without its gap merging: nothing is drawn extra).
+    std::vector<Range> ranges;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto it = m_slots.find(keys[i]);
+        if (it != m_slots.end() && it->second.range.count > 0 && it->second.layer == layer)
+            ranges.push_back(it->second.range);
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const Range& x, const Range& y) { return x.first < y.first; });
+
+    const std::vector<Instance>& shadow = arena->second.shadow;
+    for (const Range& r : ranges)
+        out.insert(out.end(), shadow.begin() + r.first, shadow.begin() + r.first + r.count);
+}
+
+template class BasicLineInstanceStore<LineInstance>;
+template class BasicLineInstanceStore<PackedLineInstance>;
@@ -0,0 +1,157 @@
+// LineInstanceStore.h
+#pragma once
+#include "glad.h"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Per-instance line data (24 bytes): 2D endpoints, RGBA8 color, width in pixels.
+// An all-zero instance is degenerate (p0 == p1) and draws nothing, which is
+// how unused slots inside a buffer are blanked out.
+struct LineInstance
+{
+    glm::vec2 p0;
+    glm::vec2 p1;
+    uint32_t color;
+    float width;
+};
+
+// Compact instance (16 bytes) for large chunks: endpoints as int16 steps from a
+// per-chunk origin (world = origin + step * scale, from the chunk table), RGBA8
+// color and a half-float width. All zero is degenerate here too.
+struct PackedLineInstance
+{
+    int16_t p0[2];
+    int16_t p1[2];
+    uint32_t color;
+    uint16_t width;  // IEEE half
+    uint16_t chunk;  // chunk table index
+};
+
+// Points attributes 0..3 of vao at LineInstance records in vbo (one per instance),
+// starting baseOffset bytes into the buffer.
+void SetupLineInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset = 0);
+
+// Same for PackedLineInstance records, plus the integer chunk index at 4.
+void SetupPackedLineInstanceAttributes(GLuint vao, GLuint vbo, GLintptr baseOffset = 0);
+
+// Suballocated, persistent GPU store for static line instances.
+//
+// Each caller key (an entity id, a chunk, ...) owns a contiguous range inside the
+// arena for its layer; layers are drawn in ascending order (drawOrder), one
+// instanced draw each. A CPU shadow of every arena lets Set() compare new data
+// against what is already on the GPU, so only changed instances are uploaded.
+// Freed ranges go to a coalescing free list and are blanked on the GPU; dirty
+// ranges are merged into a few glBufferSubData calls per Flush(). Growth keeps
+// the old contents via glCopyBufferSubData, and arenas that become mostly holes
+// are compacted.
+//
+// Within a layer, instances are drawn in buffer order, which follows allocation
+// rather than submission once holes are reused.
+//
+// Instantiated for LineInstance (LineInstanceStore) and PackedLineInstance
+// (PackedLineInstanceStore).
+template <typename Instance>
+class BasicLineInstanceStore
+{
+public:
+    struct Stats
+    {
+        std::size_t liveInstances = 0;     // owned by keys
+        std::size_t usedInstances = 0;     // drawn (live + holes below the high-water mark)
+        std::size_t capacityInstances = 0; // allocated on the GPU
+        std::size_t capacityBytes = 0;
+        std::size_t uploadCalls = 0;       // glBufferSubData calls in the last Flush()
+        std::size_t uploadedBytes = 0;     // bytes uploaded in the last Flush()
+        std::size_t compactions = 0;       // total
+    };
+
+    // Replace the instances owned by key (count may be 0).
+    void Set(uint64_t key, int layer, const Instance* data, std::size_t count);
+
+    // Set() for callers that write the instances themselves: (re)allocates key's
+    // range and returns it in the shadow, to be filled before the next call on
+    // this store. The whole range is uploaded on Flush() (there is nothing to
+    // diff against). Returns null for count 0.
+    Instance* Emplace(uint64_t key, int layer, std::size_t count);
+    void Remove(uint64_t key);
+    void Clear();
+
+    // Sync protocol for callers that re-submit everything: keys not Set() between
+    // BeginSync() and EndSync() are removed.
+    void BeginSync() { ++m_syncStamp; }
+    void EndSync();
+
+    // Apply pending uploads (grow, compact, coalesced sub-data). Needs a GL context.
+    void Flush();
+
+    // One instanced draw per non-empty layer. Caller binds the program/uniforms.
+    void Draw() const;
+    void Draw(int layer) const;
+
+    // Draw only the given keys (layer order, then buffer order), optionally only
+    // those in one layer. Nearby ranges in the same arena are merged into one
+    // draw; call after Flush().
+    void DrawKeys(const uint64_t* keys, std::size_t count, std::optional<int> layer = std::nullopt) const;
+
+    // Appends the layers that have instances, ascending.
+    void CollectLayers(std::vector<int>& out) const;
+
+    // Append from the shadow what Draw(layer) / DrawKeys(keys, count, layer)
+    // would draw, in the same order (blanked holes included), for drawing the
+    // store without GL. Needs no Flush().
+    void Read(int layer, std::vector<Instance>& out) const;
+    void ReadKeys(const uint64_t* keys, std::size_t count, int layer, std::vector<Instance>& out) const;
+
+    bool IsEmpty() const { return m_slots.empty(); }
+    bool Contains(uint64_t key) const { return m_slots.count(key) != 0; }
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct Range
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    struct Arena
+    {
+        std::vector<Instance> shadow;     // CPU mirror, size == used
+        std::vector<Range> freeList;      // sorted by first, coalesced
+        std::vector<Range> dirty;         // unsorted, merged on Flush()
+        std::size_t holes = 0;            // instances in freeList
+
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        uint32_t capacity = 0;
+    };
+
+    struct Slot
+    {
+        int layer = 0;
+        Range range;
+        uint32_t stamp = 0;
+    };
+
+    Range Allocate(Arena& a, uint32_t count);
+    void Free(Arena& a, Range r);
+    void MarkDirty(Arena& a, uint32_t first, uint32_t count);
+    void Compact(int layer, Arena& a);
+    void Grow(Arena& a, uint32_t needed);
+
+    std::map<int, Arena> m_arenas;
+    std::unordered_map<uint64_t, Slot> m_slots;
+    uint32_t m_syncStamp = 0;
+    Stats m_stats;
+};
+
+using LineInstanceStore = BasicLineInstanceStore<LineInstance>;
+using PackedLineInstanceStore = BasicLineInstanceStore<PackedLineInstance>;
+
+extern template class BasicLineInstanceStore<LineInstance>;
+extern template class BasicLineInstanceStore<PackedLineInstance>;
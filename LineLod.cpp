@@ -0,0 +1,261 @@
+// LineLod.cpp
+#include "LineLod.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace
+{
+    constexpr int kMaxLevels = 16;
+
+    uint64_t Mix64(uint64_t x)
+    {
+        // splitmix64 finalizer
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    struct SnappedKey
+    {
+        int64_t ax, ay, bx, by;
+
+        bool operator==(const SnappedKey& o) const
+        {
+            return ax == o.ax && ay == o.ay && bx == o.bx && by == o.by;
+        }
+    };
+
+    struct SnappedKeyHash
+    {
+        std::size_t operator()(const SnappedKey& k) const
+        {
+            uint64_t h = Mix64((uint64_t)k.ax);
+            h = Mix64(h ^ (uint64_t)k.ay);
+            h = Mix64(h ^ (uint64_t)k.bx);
+            return (std::size_t)Mix64(h ^ (uint64_t)k.by);
+        }
+    };
+
+    // One pyramid level: snap endpoints to a grid of the given cell size.
+    void SnapLevel(const LineInstance* data, std::size_t count, float cell, std::vector<LineInstance>& out)
+    {
+        out.clear();
+
+        const double inv = 1.0 / (double)cell;
+        std::unordered_set<SnappedKey, SnappedKeyHash> seen;
+        seen.reserve(count);
+
+        // Grid coordinates of the last emitted segment, for merging continuations.
+        int64_t lastAx = 0, lastAy = 0, lastBx = 0, lastBy = 0;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const LineInstance& src = data[i];
+
+            const int64_t ax = std::llround(src.p0.x * inv);
+            const int64_t ay = std::llround(src.p0.y * inv);
+            const int64_t bx = std::llround(src.p1.x * inv);
+            const int64_t by = std::llround(src.p1.y * inv);
+
+            // Sub-cell segment: covered by its neighbours' endpoints.
+            if (ax == bx && ay == by)
+                continue;
+
+            const bool forward = (ax < bx) || (ax == bx && ay < by);
+            const SnappedKey key = forward ? SnappedKey{ ax, ay, bx, by } : SnappedKey{ bx, by, ax, ay };
+            if (!seen.insert(key).second)
+                continue;
+
+            if (!out.empty())
+            {
+                LineInstance& last = out.back();
+                const int64_t dx0 = lastBx - lastAx, dy0 = lastBy - lastAy;
+                const int64_t dx1 = bx - ax, dy1 = by - ay;
+
+                const bool continues = (lastBx == ax && lastBy == ay);
+                const bool collinear = (dx0 * dy1 - dy0 * dx1) == 0 && (dx0 * dx1 + dy0 * dy1) > 0;
+                if (continues && collinear && last.color == src.color && last.width == src.width)
+                {
+                    last.p1 = glm::vec2((float)(bx * (double)cell), (float)(by * (double)cell));
+                    lastBx = bx;
+                    lastBy = by;
+                    continue;
+                }
+            }
+
+            LineInstance snapped = src;
+            snapped.p0 = glm::vec2((float)(ax * (double)cell), (float)(ay * (double)cell));
+            snapped.p1 = glm::vec2((float)(bx * (double)cell), (float)(by * (double)cell));
+            out.push_back(snapped);
+
+            lastAx = ax; lastAy = ay;
+            lastBx = bx; lastBy = by;
+        }
+    }
+}
+
+// ------------------------------------------------------------
+// LineLodChunk
+// ------------------------------------------------------------
+int LineLodChunk::SelectLevel(float worldPerPixel, float pixelTolerance) const
+{
+    if (levels.empty() || !(baseCell > 0.0f))
+        return -1;
+
+    const float maxCell = pixelTolerance * worldPerPixel;
+    if (baseCell > maxCell)
+        return -1;
+
+    const int level = (int)std::floor(std::log2(maxCell / baseCell));
+    return std::clamp(level, 0, (int)levels.size() - 1);
+}
+
+// ------------------------------------------------------------
+// Building
+// ------------------------------------------------------------
+uint64_t LineLodBuilder::Hash(const LineInstance* data, std::size_t count)
+{
+    static_assert(sizeof(LineInstance) % sizeof(uint64_t) == 0, "LineInstance is hashed as 64-bit words");
+
+    uint64_t h = Mix64(count);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    const std::size_t words = count * (sizeof(LineInstance) / sizeof(uint64_t));
+    for (std::size_t i = 0; i < words; ++i)
+    {
+        uint64_t w = 0;
+        std::memcpy(&w, bytes + i * sizeof(uint64_t), sizeof(w));
+        h = Mix64(h ^ w);
+    }
+    return h;
+}
+
+std::shared_ptr<LineLodChunk> LineLodBuilder::Build(const LineInstance* data, std::size_t count, uint64_t hash)
+{
+    auto chunk = std::make_shared<LineLodChunk>();
+    chunk->hash = hash;
+
+    // The finest useful cell is half an average segment: below that, snapping
+    // barely changes anything.
+    double lengthSum = 0.0;
+    std::size_t nonZero = 0;
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 a(data[i].p0), b(data[i].p1);
+        lo = glm::min(lo, glm::min(a, b));
+        hi = glm::max(hi, glm::max(a, b));
+
+        const float len = glm::length(b - a);
+        if (len > 0.0f)
+        {
+            lengthSum += len;
+            ++nonZero;
+        }
+    }
+
+    if (nonZero == 0)
+        return chunk;
+
+    const float extent = std::max(hi.x - lo.x, hi.y - lo.y);
+    float cell = (float)(0.5 * lengthSum / (double)nonZero);
+    chunk->baseCell = cell;
+
+    for (int level = 0; level < kMaxLevels; ++level, cell *= 2.0f)
+    {
+        chunk->levels.emplace_back();
+        SnapLevel(data, count, cell, chunk->levels.back());
+
+        // Once the whole chunk fits in a cell or two, coarser levels add nothing.
+        if (chunk->levels.back().size() <= 1 || cell > extent)
+            break;
+    }
+
+    return chunk;
+}
+
+// ------------------------------------------------------------
+// Worker
+// ------------------------------------------------------------
+LineLodBuilder::LineLodBuilder()
+{
+    m_worker = std::thread(&LineLodBuilder::WorkerMain, this);
+}
+
+LineLodBuilder::~LineLodBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void LineLodBuilder::Request(uint64_t key, uint64_t hash, const LineInstance* data, std::size_t count)
+{
+    Job job;
+    job.hash = hash;
+    job.lines.assign(data, data + count);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending[key] = std::move(job);
+    }
+    m_wake.notify_one();
+}
+
+bool LineLodBuilder::Poll(std::vector<Result>& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_ready.empty())
+        return false;
+
+    for (auto& r : m_ready)
+        out.push_back(std::move(r));
+    m_ready.clear();
+    return true;
+}
+
+void LineLodBuilder::WorkerMain()
+{
+    for (;;)
+    {
+        std::unordered_map<uint64_t, Job> jobs;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_quit || !m_pending.empty(); });
+            if (m_quit)
+                return;
+
+            jobs.swap(m_pending);
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+
+        std::vector<Result> built;
+        built.reserve(jobs.size());
+        for (auto& kv : jobs)
+            built.emplace_back(kv.first, Build(kv.second.lines.data(), kv.second.lines.size(), kv.second.hash));
+
+#if _DEBUG
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::printf("[LineLod] %zu chunks built in %.2f ms (background)\n", built.size(), ms);
+#else
+        (void)t0;
+#endif
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& r : built)
+            m_ready.push_back(std::move(r));
+    }
+}
@@ -0,0 +1,84 @@
+// LineLod.h
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "LineInstanceStore.h" // LineInstance
+
+#ifndef LOD_CHUNK_SEGMENTS
+// Most world-space line entities in one LOD chunk (a tile with more is split).
+#define LOD_CHUNK_SEGMENTS 512
+#endif
+
+#ifndef LOD_PIXEL_TOLERANCE
+// Coarsest snapping cell (in screen pixels) a chunk may be drawn with.
+#define LOD_PIXEL_TOLERANCE 1.5f
+#endif
+
+// Simplified versions of one chunk of line instances.
+//
+// levels[i] is the chunk with every endpoint snapped to a world grid of cell
+// baseCell * 2^i: segments that collapse into one grid point are dropped,
+// duplicates (in either direction) are kept once, and collinear continuations
+// with the same color/width are merged. A level never holds more segments than
+// there are grid edges under the chunk, so at a cell of ~1 pixel the instance
+// count follows screen coverage rather than drawing complexity.
+struct LineLodChunk
+{
+    uint64_t hash = 0;     // LineLodBuilder::Hash() of the source instances
+    float baseCell = 0.0f; // world cell size of levels[0]
+    std::vector<std::vector<LineInstance>> levels;
+
+    // Level for the given world size of one pixel, or -1 for full detail.
+    int SelectLevel(float worldPerPixel, float pixelTolerance = LOD_PIXEL_TOLERANCE) const;
+};
+
+// Builds LineLodChunk pyramids on a worker thread.
+//
+// Request() queues a copy of a chunk's instances; a newer request for the same
+// key replaces one that has not started yet. Poll() hands finished chunks back
+// on the caller's thread. Callers compare LineLodChunk::hash with the current
+// source and draw full detail while a chunk's pyramid is missing or out of date.
+class LineLodBuilder
+{
+public:
+    using Result = std::pair<uint64_t, std::shared_ptr<const LineLodChunk>>;
+
+    LineLodBuilder();
+    ~LineLodBuilder();
+
+    LineLodBuilder(const LineLodBuilder&) = delete;
+    LineLodBuilder& operator=(const LineLodBuilder&) = delete;
+
+    void Request(uint64_t key, uint64_t hash, const LineInstance* data, std::size_t count);
+
+    // Appends finished (key, chunk) pairs to out. Returns true if any were added.
+    bool Poll(std::vector<Result>& out);
+
+    static uint64_t Hash(const LineInstance* data, std::size_t count);
+    static std::shared_ptr<LineLodChunk> Build(const LineInstance* data, std::size_t count, uint64_t hash);
+
+private:
+    struct Job
+    {
+        uint64_t hash = 0;
+        std::vector<LineInstance> lines;
+    };
+
+    void WorkerMain();
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+    std::unordered_map<uint64_t, Job> m_pending;
+    std::vector<Result> m_ready;
+
+    std::thread m_worker;
+};
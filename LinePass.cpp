@@ -1,57 +1,208 @@
 #include "LinePass.h"
+#include "FrameProfiler.h"
 #include "GLShaderUtil.h"
+#include "GLStateCache.h"
 
-#include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
-
-void LinePass::Init()
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace
 {
-    const char* vs = R"(
-        #version 330 core
-        layout(location = 0) in vec3 aPos;
+    // Quad expansion: corners 0/1 sit on p0, 2/3 on p1; odd corners on the left
+    // of the segment. Both endpoints are projected to pixels, offset by half the
+    // width along the normal (and along the direction, for square caps that close
+    // polyline joints), then mapped back to clip space.
+    // mvp and viewport come from GLStateCache's Camera block.
+    const char* kExpandLine = R"(
+        out vec4 vColor;
+
+        void EmitLine(vec2 p0, vec2 p1, vec4 color, float width)
+        {
+            vColor = color;
+
+            vec4 c0 = mvp * vec4(p0, 0.0, 1.0);
+            vec4 c1 = mvp * vec4(p1, 0.0, 1.0);
+
+            bool atEnd = gl_VertexID >= 2;
+            vec4 c = atEnd ? c1 : c0;
+
+            vec2 halfViewport = 0.5 * viewport.xy;
+            vec2 s0 = (c0.xy / c0.w) * halfViewport;
+            vec2 s1 = (c1.xy / c1.w) * halfViewport;
+
+            vec2 d = s1 - s0;
+            float len = length(d);
+            if (len < 1e-4)
+            {
+                gl_Position = c; // zero-length: collapse (draws nothing, like GL_LINES)
+                return;
+            }
+
+            vec2 dir = d / len;
+            vec2 normal = vec2(-dir.y, dir.x);
+            float halfWidth = 0.5 * max(width, 1.0);
+            float side = ((gl_VertexID & 1) == 0) ? -1.0 : 1.0;
+
+            vec2 s = atEnd ? s1 : s0;
+            s += normal * (side * halfWidth) + dir * (atEnd ? halfWidth : -halfWidth);
+
+            gl_Position = vec4((s / halfViewport) * c.w, c.z, c.w);
+        }
+    )";
+
+    const char* kFloatMain = R"(
+        layout(location = 0) in vec2 aP0;
+        layout(location = 1) in vec2 aP1;
+        layout(location = 2) in vec4 aColor;
+        layout(location = 3) in float aWidth;
+
+        void main()
+        {
+            EmitLine(aP0, aP1, aColor, aWidth);
+        }
+    )";
+
+    // Positions arrive as int16 steps; the chunk table holds (origin.xy, scale.xy).
+    const char* kPackedMain = R"(
+        layout(location = 0) in vec2 aP0;
+        layout(location = 1) in vec2 aP1;
+        layout(location = 2) in vec4 aColor;
+        layout(location = 3) in float aWidth;
+        layout(location = 4) in uint aChunk;
 
-        uniform mat4 projection;
-        uniform mat4 view;
-        uniform mat4 model;
+        uniform samplerBuffer chunkTable;
 
         void main()
         {
-            gl_Position = projection * view * model * vec4(aPos, 1.0);
+            vec4 chunk = texelFetch(chunkTable, int(aChunk));
+            EmitLine(chunk.xy + aP0 * chunk.zw, chunk.xy + aP1 * chunk.zw, aColor, aWidth);
         }
     )";
 
-    const char* fs = R"(
+    const char* kFragment = R"(
         #version 330 core
+        in vec4 vColor;
         out vec4 FragColor;
-        uniform vec4 color;
         void main()
         {
-            FragColor = color;
+            FragColor = vColor;
         }
     )";
 
-    shader = CreateProgram(vs, fs);
+    uint16_t FloatToHalf(float value)
+    {
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const uint32_t sign = (bits >> 16) & 0x8000u;
+        const int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFFu;
+
+        if (exponent <= 0)
+            return (uint16_t)sign; // widths this small draw at the 1 px minimum anyway
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7BFFu); // clamp to the largest finite half
+
+        // Round to nearest; a carry out of the mantissa bumps the exponent.
+        mantissa += 0x1000u;
+        uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x800000u)
+            half = sign | ((uint32_t)(exponent + 1) << 10);
+        return (uint16_t)std::min<uint32_t>(half, sign | 0x7BFFu);
+    }
+
+    float HalfToFloat(uint16_t half)
+    {
+        const uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+        const uint32_t exponent = (half >> 10) & 0x1Fu;
+        const uint32_t mantissa = half & 0x3FFu;
+
+        // FloatToHalf never makes denormals, infinities or NaNs; zero is the only special case.
+        const uint32_t bits = (exponent == 0) ? sign : (sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+        float value = 0.0f;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+void LinePass::Init(std::size_t immediateStreamBytes)
+{
+    const std::string header = std::string("#version 330 core\n") + GLStateCache::CameraBlockSource() + kExpandLine;
+    const std::string floatVs = header + kFloatMain;
+    const std::string packedVs = header + kPackedMain;
+
+    floatProgram.Create(floatVs.c_str(), kFragment);
+    packedProgram.Create(packedVs.c_str(), kFragment);
+
+    GLStateCache::UseProgram(packedProgram.program);
+    GLStateCache::Uniform1i(glGetUniformLocation(packedProgram.program, "chunkTable"), 0);
 
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    // Immediate instances stream through a fenced ring; attributes are re-pointed
+    // at each frame's offset in DrawImmediate().
+    immediateStream.Init(GL_ARRAY_BUFFER, immediateStreamBytes);
+
+    // Chunk table for packed instances (RGBA32F texels), re-uploaded when it changes.
+    glGenBuffers(1, &chunkBuffer);
+    GLStateCache::BindBuffer(GL_TEXTURE_BUFFER, chunkBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glGenTextures(1, &chunkTexture);
+    GLStateCache::ActiveTexture(GL_TEXTURE0);
+    GLStateCache::BindTexture(GL_TEXTURE_BUFFER, chunkTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, chunkBuffer);
+}
+
+void LinePass::LineProgram::Create(const char* vs, const char* fs)
+{
+    program = CreateProgram(vs, fs);
+    GLStateCache::BindCameraBlock(program);
+}
 
-    // Start with some capacity; can grow
-    capacityVerts = 8192;
-    glBufferData(GL_ARRAY_BUFFER, capacityVerts * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+uint32_t LinePass::PackColor(const glm::vec4& c)
+{
+    // RGBA8 in memory order r,g,b,a (little-endian), matching GL_UNSIGNED_BYTE x4.
+    auto u8 = [](float v) { return (uint32_t)(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return u8(c.r) | (u8(c.g) << 8) | (u8(c.b) << 16) | (u8(c.a) << 24);
+}
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+LineInstance LinePass::MakeInstance(const LineEntity& line)
+{
+    return { glm::vec2(line.start), glm::vec2(line.end), PackColor(line.color), line.width };
+}
 
-    glBindVertexArray(0);
+void LinePass::BindAndSetUniforms(const RenderContext& ctx, const LineProgram& p)
+{
+    GLStateCache::UseProgram(p.program);
+
+    GLStateCache::SetEnabled(GL_CULL_FACE, false);
+    GLStateCache::SetEnabled(GL_DEPTH_TEST, false);
+
+    // Pixel widths need the framebuffer size; fall back to the GL viewport.
+    glm::vec2 viewport = ctx.viewportSize;
+    if (viewport.x <= 0.0f || viewport.y <= 0.0f)
+    {
+        GLint vp[4] = { 0, 0, 1, 1 };
+        glGetIntegerv(GL_VIEWPORT, vp);
+        viewport = glm::vec2((float)std::max(1, vp[2]), (float)std::max(1, vp[3]));
+    }
+    GLStateCache::SetCamera(ctx.projection * ctx.view * ctx.model, viewport);
+
+    if (&p == &packedProgram)
+    {
+        GLStateCache::ActiveTexture(GL_TEXTURE0);
+        GLStateCache::BindTexture(GL_TEXTURE_BUFFER, chunkTexture);
+    }
+}
 
-    // Cache uniforms
-    uProjection = glGetUniformLocation(shader, "projection");
-    uView = glGetUniformLocation(shader, "view");
-    uModel = glGetUniformLocation(shader, "model");
-    uColor = glGetUniformLocation(shader, "color");
+void LinePass::DrawInstances(GLsizei count)
+{
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
 }
 
 // ---------------------------
@@ -59,137 +210,299 @@ void LinePass::Init()
 // ---------------------------
 void LinePass::BeginFrame()
 {
-    immediateLines.clear();
+    immediateInstances.clear();
 }
 
 void LinePass::Submit(const LineEntity& line)
 {
-    immediateLines.push_back(line);
+    immediateInstances.push_back(MakeInstance(line));
 }
 
 void LinePass::DrawImmediate(const RenderContext& ctx)
 {
-    if (immediateLines.empty())
+    if (immediateInstances.empty())
         return;
 
-    glUseProgram(shader);
-    glBindVertexArray(vao);
+    ScopedGpuTimer gpuTimer(timerName);
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
+    // One upload + one draw for the whole frame
+    immediateStream.ResetFrameStats();
+    const GLintptr offset = immediateStream.Upload(immediateInstances.data(),
+        immediateInstances.size() * sizeof(LineInstance), sizeof(LineInstance));
+    SetupLineInstanceAttributes(vao, immediateStream.GetBuffer(), offset);
 
-    glUniformMatrix4fv(uProjection, 1, GL_FALSE, glm::value_ptr(ctx.projection));
-    glUniformMatrix4fv(uView, 1, GL_FALSE, glm::value_ptr(ctx.view));
-    glUniformMatrix4fv(uModel, 1, GL_FALSE, glm::value_ptr(ctx.model));
+    BindAndSetUniforms(ctx, floatProgram);
+    DrawInstances((GLsizei)immediateInstances.size());
 
-    // Upload all vertices for this frame
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    immediateStream.Fence();
+}
 
-    const size_t neededVerts = immediateLines.size() * 2;
-    EnsureCapacity(neededVerts);
+// ---------------------------
+// Static-mode (stateful CAD-like)
+// ---------------------------
+void LinePass::BuildStatic(const std::vector<LineEntity>& lines)
+{
+    // Whole-pass replacement: a single key in layer 0. Each instance is written
+    // once, in input order, straight into the shadow Flush() uploads from.
+    staticStore.Clear();
+    packedStore.Clear();
+    chunkSlots.clear();
+    freeChunks.clear();
+    chunkTable.clear();
+
+    LineInstance* dst = staticStore.Emplace(0, 0, lines.size());
+    for (std::size_t i = 0; i < lines.size(); ++i)
+        dst[i] = MakeInstance(lines[i]);
+}
+
+void LinePass::BeginStaticSync()
+{
+    staticStore.BeginSync();
+    packedStore.BeginSync();
+}
+
+void LinePass::SetStatic(uint64_t key, int layer, const std::vector<LineEntity>& lines)
+{
+    staticScratch.clear();
+    staticScratch.reserve(lines.size());
+    for (const auto& l : lines)
+        staticScratch.push_back(MakeInstance(l));
 
-    size_t v = 0;
-    for (const auto& l : immediateLines)
+    SetStaticInstances(key, layer, staticScratch.data(), staticScratch.size());
+}
+
+void LinePass::SetStaticInstances(uint64_t key, int layer, const LineInstance* data, size_t count, float maxError)
+{
+    if (maxError > 0.0f && count >= LINE_PACK_MIN_INSTANCES && Pack(key, data, count, maxError))
     {
-        glm::vec3 verts[2] = { l.start, l.end };
-        glBufferSubData(GL_ARRAY_BUFFER, v * sizeof(glm::vec3), sizeof(verts), verts);
-        v += 2;
+        packedStore.Set(key, layer, packedScratch.data(), packedScratch.size());
+        if (staticStore.Contains(key))
+            staticStore.Remove(key);
+        return;
     }
 
-    // Draw each with its style (color/width)
-    GLint first = 0;
-    for (const auto& l : immediateLines)
+    staticStore.Set(key, layer, data, count);
+    if (packedStore.Contains(key))
     {
-        glUniform4fv(uColor, 1, glm::value_ptr(l.color));
-        glLineWidth(l.width);
-        glDrawArrays(GL_LINES, first, 2);
-        first += 2;
+        packedStore.Remove(key);
+        ReleaseChunk(key);
     }
-
-    glBindVertexArray(0);
 }
 
-// ---------------------------
-// Static-mode (stateful CAD-like)
-// ---------------------------
-void LinePass::BuildStatic(const std::vector<LineEntity>& lines)
+void LinePass::RemoveStatic(uint64_t key)
 {
-    staticVertices.clear();
-    staticBatches.clear();
+    staticStore.Remove(key);
+    packedStore.Remove(key);
+    ReleaseChunk(key);
+}
 
-    if (lines.empty())
-        return;
+void LinePass::EndStaticSync()
+{
+    staticStore.EndSync();
+    packedStore.EndSync();
 
-    // Group by style (color+width)
-    std::unordered_map<StyleKey, std::vector<glm::vec3>, StyleKeyHash> groups;
-    groups.reserve(lines.size());
+    // Chunks of packed keys that were just dropped.
+    for (auto it = chunkSlots.begin(); it != chunkSlots.end(); )
+    {
+        if (!packedStore.Contains(it->first))
+        {
+            freeChunks.push_back(it->second);
+            it = chunkSlots.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
 
-    for (const auto& l : lines)
+// ---------------------------
+// Packed (quantized) instances
+// ---------------------------
+bool LinePass::Pack(uint64_t key, const LineInstance* data, size_t count, float maxError)
+{
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; ++i)
     {
-        StyleKey key{ l.color, l.width };
-        auto& verts = groups[key];
-        verts.push_back(l.start);
-        verts.push_back(l.end);
+        lo = glm::min(lo, glm::min(data[i].p0, data[i].p1));
+        hi = glm::max(hi, glm::max(data[i].p0, data[i].p1));
     }
 
-    // Flatten into one vertex array + record batches
-    staticVertices.reserve(lines.size() * 2);
+    // int16 steps around the center; rounding is off by at most half a step.
+    const glm::vec2 origin = 0.5f * (lo + hi);
+    const glm::vec2 halfExtent = 0.5f * (hi - lo);
+    glm::vec2 scale = halfExtent / 32767.0f;
+    if (!(std::max(scale.x, scale.y) * 0.5f <= maxError))
+        return false;
+    scale = glm::max(scale, glm::vec2(std::numeric_limits<float>::min()));
 
-    for (auto& kv : groups)
+    auto slot = chunkSlots.find(key);
+    if (slot == chunkSlots.end())
     {
-        const StyleKey style = kv.first;
-        auto& verts = kv.second;
-
-        StaticBatch batch;
-        batch.style = style;
-        batch.firstVertex = (GLint)staticVertices.size();
-        batch.vertexCount = (GLsizei)verts.size();
+        uint32_t index = 0;
+        if (!freeChunks.empty())
+        {
+            index = freeChunks.back();
+            freeChunks.pop_back();
+        }
+        else if (chunkTable.size() <= UINT16_MAX)
+        {
+            index = (uint32_t)chunkTable.size();
+            chunkTable.emplace_back(0.0f);
+        }
+        else
+        {
+            return false; // table full: stay in full precision
+        }
+        slot = chunkSlots.emplace(key, (uint16_t)index).first;
+    }
 
-        staticVertices.insert(staticVertices.end(), verts.begin(), verts.end());
-        staticBatches.push_back(batch);
+    const glm::vec4 entry(origin.x, origin.y, scale.x, scale.y);
+    if (chunkTable[slot->second] != entry)
+    {
+        chunkTable[slot->second] = entry;
+        chunkTableDirty = true;
     }
 
-    // Upload once
-    EnsureCapacity(staticVertices.size());
+    const glm::vec2 inv = 1.0f / scale;
+    auto quantize = [&](const glm::vec2& p, int16_t out[2])
+        {
+            const glm::vec2 q = (p - origin) * inv;
+            out[0] = (int16_t)std::lround(std::clamp(q.x, -32767.0f, 32767.0f));
+            out[1] = (int16_t)std::lround(std::clamp(q.y, -32767.0f, 32767.0f));
+        };
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, staticVertices.size() * sizeof(glm::vec3), staticVertices.data());
+    packedScratch.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        PackedLineInstance& dst = packedScratch[i];
+        quantize(data[i].p0, dst.p0);
+        quantize(data[i].p1, dst.p1);
+        dst.color = data[i].color;
+        dst.width = FloatToHalf(data[i].width);
+        dst.chunk = slot->second;
+    }
+    return true;
 }
 
-void LinePass::DrawStatic(const RenderContext& ctx)
+void LinePass::ReleaseChunk(uint64_t key)
 {
-    if (staticBatches.empty())
+    auto it = chunkSlots.find(key);
+    if (it == chunkSlots.end())
         return;
 
-    glUseProgram(shader);
-    glBindVertexArray(vao);
+    freeChunks.push_back(it->second);
+    chunkSlots.erase(it);
+}
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
+void LinePass::FlushStatic()
+{
+    staticStore.Flush();
+    packedStore.Flush();
 
-    glUniformMatrix4fv(uProjection, 1, GL_FALSE, glm::value_ptr(ctx.projection));
-    glUniformMatrix4fv(uView, 1, GL_FALSE, glm::value_ptr(ctx.view));
-    glUniformMatrix4fv(uModel, 1, GL_FALSE, glm::value_ptr(ctx.model));
+    if (chunkTableDirty && !chunkTable.empty())
+    {
+        GLStateCache::BindBuffer(GL_TEXTURE_BUFFER, chunkBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, chunkTable.size() * sizeof(glm::vec4), chunkTable.data(), GL_DYNAMIC_DRAW);
+    }
+    chunkTableDirty = false;
+
+    floatLayers.clear();
+    packedLayers.clear();
+    staticStore.CollectLayers(floatLayers);
+    packedStore.CollectLayers(packedLayers);
+}
 
-    for (const auto& b : staticBatches)
+// Layers ascending; within a layer full-precision instances first, then packed.
+template <typename DrawFn>
+void LinePass::DrawLayers(const RenderContext& ctx, DrawFn&& draw)
+{
+    const LineProgram* bound = nullptr;
+    auto use = [&](const LineProgram& p)
+        {
+            if (bound != &p)
+            {
+                BindAndSetUniforms(ctx, p);
+                bound = &p;
+            }
+        };
+
+    std::size_t f = 0, k = 0;
+    while (f < floatLayers.size() || k < packedLayers.size())
     {
-        glUniform4fv(uColor, 1, glm::value_ptr(b.style.color));
-        glLineWidth(b.style.width);
-        glDrawArrays(GL_LINES, b.firstVertex, b.vertexCount);
+        const int layer = (k == packedLayers.size() || (f < floatLayers.size() && floatLayers[f] <= packedLayers[k]))
+            ? floatLayers[f] : packedLayers[k];
+
+        if (f < floatLayers.size() && floatLayers[f] == layer)
+        {
+            use(floatProgram);
+            draw(staticStore, layer);
+            ++f;
+        }
+        if (k < packedLayers.size() && packedLayers[k] == layer)
+        {
+            use(packedProgram);
+            draw(packedStore, layer);
+            ++k;
+        }
     }
+}
 
-    glBindVertexArray(0);
+void LinePass::DrawStatic(const RenderContext& ctx)
+{
+    ScopedGpuTimer gpuTimer(timerName);
+    FlushStatic();
+    DrawLayers(ctx, [](const auto& store, int layer) { store.Draw(layer); });
 }
 
-void LinePass::EnsureCapacity(size_t vertexCount)
+void LinePass::DrawStaticKeys(const RenderContext& ctx, const std::vector<uint64_t>& keys)
 {
-    if (vertexCount <= capacityVerts)
+    ScopedGpuTimer gpuTimer(timerName);
+    FlushStatic();
+    if (keys.empty())
         return;
 
-    while (capacityVerts < vertexCount)
-        capacityVerts *= 2;
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, capacityVerts * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    DrawLayers(ctx, [&](const auto& store, int layer) { store.DrawKeys(keys.data(), keys.size(), layer); });
 }
 
+void LinePass::ReadStatic(const std::vector<uint64_t>* keys, std::vector<LineInstance>& out)
+{
+    // floatLayers/packedLayers only follow FlushStatic(), which needs GL.
+    std::vector<int> layers;
+    staticStore.CollectLayers(layers);
+    packedStore.CollectLayers(layers);
+    std::sort(layers.begin(), layers.end());
+    layers.erase(std::unique(layers.begin(), layers.end()), layers.end());
+
+    // Full-precision keys before packed ones within a layer, like DrawLayers.
+    for (const int layer : layers)
+    {
+        if (keys)
+            staticStore.ReadKeys(keys->data(), keys->size(), layer, out);
+        else
+            staticStore.Read(layer, out);
+
+        packedScratch.clear();
+        if (keys)
+            packedStore.ReadKeys(keys->data(), keys->size(), layer, packedScratch);
+        else
+            packedStore.Read(layer, packedScratch);
+
+        for (const PackedLineInstance& p : packedScratch)
+        {
+            // Blanked holes (all zero) and other zero-length instances draw
+            // nothing; a chunk index outside the table would be a bug.
+            if (p.p0[0] == p.p1[0] && p.p0[1] == p.p1[1])
+                continue;
+            assert(p.chunk < chunkTable.size());
+            if (p.chunk >= chunkTable.size())
+                continue;
+            const glm::vec4& chunk = chunkTable[p.chunk];
+            const glm::vec2 origin(chunk.x, chunk.y);
+            const glm::vec2 scale(chunk.z, chunk.w);
+            out.push_back({ origin + glm::vec2(p.p0[0], p.p0[1]) * scale, origin + glm::vec2(p.p1[0], p.p1[1]) * scale,
+                p.color, HalfToFloat(p.width) });
+        }
+    }
+}
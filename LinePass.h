@@ -2,18 +2,42 @@
 #include "glad.h"
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 
 #include "LineEntity.h"
+#include "LineInstanceStore.h"
 #include "RenderContext.h"
+#include "StreamRingBuffer.h"
+
+#ifndef LINE_PACK_MIN_INSTANCES
+// Static keys with fewer instances stay in full precision (not worth a chunk slot).
+#define LINE_PACK_MIN_INSTANCES 64
+#endif
+
+#ifndef LINE_PACK_PIXEL_ERROR
+// Largest position error, in pixels at the current zoom, accepted for packed keys.
+#define LINE_PACK_PIXEL_ERROR 0.125f
+#endif
 
 // Shared line renderer used by BOTH:
 //  - Render-loop renderer (BeginFrame/Submit each frame)
 //  - Stateful vector renderer (BuildStatic when dirty)
+//
+// Each segment is one instance; the vertex shader expands it into a
+// screen-space quad (4-vertex strip) of the requested pixel width. Any mix of
+// colors and widths draws in a single instanced call, in submission order,
+// without relying on glLineWidth (which core profiles may clamp to 1).
+//
+// Static keys come in two vertex formats: 2D float instances (24 bytes), and
+// packed instances (16 bytes) with int16 positions relative to a per-key chunk
+// origin/scale held in a small texture buffer. A key is packed when the caller
+// passes a tolerance that its extent can meet at int16 resolution.
 class LinePass
 {
 public:
-    void Init();
+    // immediateStreamBytes sizes the ring behind DrawImmediate().
+    void Init(std::size_t immediateStreamBytes = 3u << 20);
 
     // Immediate-mode API (UI / per-frame)
     void BeginFrame();
@@ -24,64 +48,85 @@ public:
     void BuildStatic(const std::vector<LineEntity>& lines);
     void DrawStatic(const RenderContext& ctx);
 
+    // Draw only the given static keys (e.g. the ones overlapping a tile).
+    void DrawStaticKeys(const RenderContext& ctx, const std::vector<uint64_t>& keys);
+
+    // Incremental stateful API: each key (entity id) owns a range of the static
+    // store in its layer (drawOrder). Only changed instances are uploaded.
+    // Keys not set between BeginStaticSync() and EndStaticSync() are removed.
+    void BeginStaticSync();
+    void SetStatic(uint64_t key, int layer, const std::vector<LineEntity>& lines);
+    // maxError > 0 (world units) allows packing; see LINE_PACK_PIXEL_ERROR.
+    void SetStaticInstances(uint64_t key, int layer, const LineInstance* data, size_t count, float maxError = 0.0f);
+    void RemoveStatic(uint64_t key);
+    void EndStaticSync();
+
+    // Uploads pending static changes now instead of at the next draw (e.g. to
+    // spread a large sync over several frames before the pass is drawn).
+    void FlushStatic();
+
+    // Appends what DrawStatic (keys null) or DrawStaticKeys would draw, in the
+    // same order and with packed keys decoded like the packed shader does, for
+    // drawing the retained batches without GL (SoftwareLineRasterizer).
+    void ReadStatic(const std::vector<uint64_t>* keys, std::vector<LineInstance>& out);
+
+    const LineInstanceStore::Stats& GetStaticStats() const { return staticStore.GetStats(); }
+    const PackedLineInstanceStore::Stats& GetPackedStats() const { return packedStore.GetStats(); }
+    const StreamRingBuffer::Stats& GetStreamStats() const { return immediateStream.GetStats(); }
+
+    static LineInstance MakeInstance(const LineEntity& line);
+
+    // Times DrawStatic/DrawStaticKeys/DrawImmediate as this FrameProfiler GPU
+    // section (the string must outlive the pass; null = untimed).
+    void SetTimerName(const char* name) { timerName = name; }
+
 private:
-    struct StyleKey
+    // Matrices and viewport come from GLStateCache's shared Camera block.
+    struct LineProgram
     {
-        glm::vec4 color;
-        float width;
+        GLuint program = 0;
 
-        bool operator==(const StyleKey& other) const
-        {
-            return color == other.color && width == other.width;
-        }
+        void Create(const char* vs, const char* fs);
     };
 
-    struct StyleKeyHash
-    {
-        std::size_t operator()(const StyleKey& k) const noexcept
-        {
-            auto h1 = std::hash<float>{}(k.color.r);
-            auto h2 = std::hash<float>{}(k.color.g);
-            auto h3 = std::hash<float>{}(k.color.b);
-            auto h4 = std::hash<float>{}(k.color.a);
-            auto h5 = std::hash<float>{}(k.width);
-
-            std::size_t h = h1;
-            h ^= (h2 + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
-            h ^= (h3 + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
-            h ^= (h4 + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
-            h ^= (h5 + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
-            return h;
-        }
-    };
+    void BindAndSetUniforms(const RenderContext& ctx, const LineProgram& p);
+    void DrawInstances(GLsizei count);
 
-    struct StaticBatch
-    {
-        StyleKey style{};
-        GLint firstVertex = 0;    // starting vertex in VBO
-        GLsizei vertexCount = 0;  // number of vertices
-    };
+    // Quantizes into packedScratch and assigns the key's chunk; false when the
+    // extent is too large for maxError or the chunk table is full.
+    bool Pack(uint64_t key, const LineInstance* data, size_t count, float maxError);
+    void ReleaseChunk(uint64_t key);
 
-private:
-    void EnsureCapacity(size_t vertexCount);
+    template <typename DrawFn>
+    void DrawLayers(const RenderContext& ctx, DrawFn&& draw);
+
+    static uint32_t PackColor(const glm::vec4& c);
 
 private:
-    GLuint shader = 0;
+    LineProgram floatProgram;
+    LineProgram packedProgram;
     GLuint vao = 0;
-    GLuint vbo = 0;
+    const char* timerName = nullptr;
 
-    // Uniform locations (cached)
-    GLint uProjection = -1;
-    GLint uView = -1;
-    GLint uModel = -1;
-    GLint uColor = -1;
+    // Immediate-mode working set (per-frame): packed on Submit, streamed once.
+    std::vector<LineInstance> immediateInstances;
+    StreamRingBuffer immediateStream;
 
-    // Immediate-mode working set (per-frame)
-    std::vector<LineEntity> immediateLines;
+    // Static-mode GPU data (suballocated, updated incrementally)
+    LineInstanceStore staticStore;
+    std::vector<LineInstance> staticScratch;
 
-    // Static-mode cached GPU data (rebuilt only when dirty)
-    std::vector<glm::vec3> staticVertices;
-    std::vector<StaticBatch> staticBatches;
-    size_t capacityVerts = 0;
-};
+    // Packed static keys and their chunk table (origin.xy, scale.xy per slot).
+    PackedLineInstanceStore packedStore;
+    std::vector<PackedLineInstance> packedScratch;
+    std::unordered_map<uint64_t, uint16_t> chunkSlots;
+    std::vector<uint16_t> freeChunks;
+    std::vector<glm::vec4> chunkTable;
+    bool chunkTableDirty = false;
+    GLuint chunkBuffer = 0;
+    GLuint chunkTexture = 0;
 
+    // Non-empty layers of each store, refreshed by FlushStatic().
+    std::vector<int> floatLayers;
+    std::vector<int> packedLayers;
+};
@@ -0,0 +1,84 @@
+// ParallelFor.cpp
+#include "ParallelFor.h"
+
+WorkerPool& WorkerPool::Shared()
+{
+    static WorkerPool* pool = new WorkerPool(DefaultWorkerCount() - 1);
+    return *pool;
+}
+
+WorkerPool::WorkerPool(unsigned threadCount)
+{
+    threads.reserve(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t)
+        threads.emplace_back(&WorkerPool::WorkerMain, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void WorkerPool::Run(unsigned workers, JobFn fn, void* context)
+{
+    if (workers <= 1 || threads.empty())
+    {
+        fn(context, 0);
+        return;
+    }
+
+    Job job{ fn, context, workers };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+    }
+    if (workers - 1 < threads.size())
+    {
+        for (unsigned w = 1; w < workers; ++w)
+            wake.notify_one();
+    }
+    else
+    {
+        wake.notify_all();
+    }
+
+    fn(context, 0);
+
+    // The caller's share ends when no work is left, so threads that have not
+    // joined by now would find nothing to do.
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = std::find(jobs.begin(), jobs.end(), &job);
+    if (it != jobs.end())
+        jobs.erase(it);
+    done.wait(lock, [&job] { return job.active == 0; });
+}
+
+void WorkerPool::WorkerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this] { return quit || !jobs.empty(); });
+        if (quit)
+            return;
+
+        Job* job = jobs.front();
+        const unsigned worker = job->joined++;
+        ++job->active;
+        if (job->joined == job->workers)
+            jobs.pop_front();
+
+        lock.unlock();
+        job->fn(job->context, worker);
+        lock.lock();
+
+        if (--job->active == 0)
+            done.notify_all();
+    }
+}
@@ -0,0 +1,99 @@
+// ParallelFor.h
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of workers to use when the caller passes 0.
+inline unsigned DefaultWorkerCount()
+{
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 4u;
+}
+
+// Threads that stay alive between ParallelFor calls. A job runs on its caller
+// (worker 0) plus whichever pool threads pick it up before the caller has
+// finished its own share, so jobs from several threads (or nested ones) share
+// the pool without waiting for each other.
+class WorkerPool
+{
+public:
+    using JobFn = void (*)(void* context, unsigned worker);
+
+    // DefaultWorkerCount() - 1 threads, started on first use. Never destroyed:
+    // background builds may still run while statics are torn down.
+    static WorkerPool& Shared();
+
+    explicit WorkerPool(unsigned threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Calls fn(context, worker) on the calling thread with worker 0 and on up
+    // to workers - 1 pool threads with distinct workers in [1, workers);
+    // returns once every call has returned.
+    void Run(unsigned workers, JobFn fn, void* context);
+
+private:
+    struct Job
+    {
+        JobFn fn;
+        void* context;
+        unsigned workers;
+        unsigned joined = 1; // next worker index (the caller is 0)
+        unsigned active = 0; // pool threads inside fn
+    };
+
+    void WorkerMain();
+
+    std::mutex mutex;
+    std::condition_variable wake; // a job was queued, or quit
+    std::condition_variable done; // a pool thread left a job
+    std::deque<Job*> jobs;        // open to more workers
+    bool quit = false;
+    std::vector<std::thread> threads;
+};
+
+// Runs fn(begin, end, worker) over [0, count), handing out chunks of `grain`
+// items dynamically so uneven work (dense tiles, long texts) balances out.
+// Worker 0 is the calling thread, the others come from WorkerPool::Shared();
+// fn must be safe to call concurrently.
+template <typename Fn>
+void ParallelFor(std::size_t count, std::size_t grain, Fn&& fn, unsigned threads = 0)
+{
+    if (count == 0)
+        return;
+
+    grain = std::max<std::size_t>(1, grain);
+    const std::size_t chunks = (count + grain - 1) / grain;
+
+    unsigned workers = threads ? threads : DefaultWorkerCount();
+    workers = (unsigned)std::min<std::size_t>(workers, chunks);
+
+    if (workers <= 1)
+    {
+        fn(std::size_t(0), count, 0u);
+        return;
+    }
+
+    std::atomic<std::size_t> next{ 0 };
+    auto run = [&](unsigned worker)
+        {
+            for (;;)
+            {
+                const std::size_t begin = next.fetch_add(grain);
+                if (begin >= count)
+                    break;
+                fn(begin, std::min(count, begin + grain), worker);
+            }
+        };
+
+    using Run = decltype(run);
+    WorkerPool::Shared().Run(workers, [](void* context, unsigned worker) { (*static_cast<Run*>(context))(worker); }, &run);
+}
@@ -1,5 +1,7 @@
 #include "RGeometryTree.h"
 
+#include <boost/iterator/function_output_iterator.hpp>
+
 void RGeometryTree::Clear()
 {
     m_tree.clear();
@@ -19,3 +21,8 @@ std::optional<std::size_t> RGeometryTree::QueryFirstIntersect(const BoundingBox&
     return out.front().second;
 }
 
+void RGeometryTree::QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const
+{
+    m_tree.query(bgi::intersects(box),
+        boost::make_function_output_iterator([&out](const Value& v) { out.push_back(v.second); }));
+}
@@ -19,6 +19,9 @@ public:
     // Query with an AABB (picker square in world space). Returns the first hit (best-effort).
     std::optional<std::size_t> QueryFirstIntersect(const BoundingBox& box) const;
 
+    // All payloads whose box intersects the query, in tree order (appended to out).
+    void QueryIntersects(const BoundingBox& box, std::vector<std::size_t>& out) const;
+
 private:
     using Value = std::pair<BoundingBox, std::size_t>;
     bgi::rtree<Value, bgi::quadratic<16>> m_tree;
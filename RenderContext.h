@@ -6,5 +6,8 @@ struct RenderContext
     glm::mat4 projection{ 1.0f };
     glm::mat4 view{ 1.0f };
     glm::mat4 model{ 1.0f };
+
+    // Framebuffer size in pixels (screen-space line widths). 0 = query GL_VIEWPORT.
+    glm::vec2 viewportSize{ 0.0f, 0.0f };
 };
 
@@ -1,10 +1,11 @@
 #include "RenderLoopRenderer.h"
 #include "EntityType.h"
-#include "HersheyTextBuilder.h"
+#include "HersheyTextCache.h"
 
-void RenderLoopRenderer::Init()
+void RenderLoopRenderer::Init(std::size_t streamBytes)
 {
-    linePass.Init();
+    linePass.Init(streamBytes);
+    linePass.SetTimerName("immediate");
 }
 
 void RenderLoopRenderer::BeginFrame()
@@ -22,9 +23,9 @@ void RenderLoopRenderer::Submit(const Entity& e)
 
     case EntityType::Text:
     {
-        std::vector<LineEntity> textLines;
-        textLines.reserve(e.text.text.size() * 8);
-        HersheyTextBuilder::BuildLines(e.text, textLines);
+        // Layout comes from the cache; only placement is redone per frame.
+        textLines.clear();
+        HersheyTextCache::BuildLines(e.text, textLines);
 
         for (const auto& l : textLines)
             linePass.Submit(l);
@@ -36,6 +37,11 @@ void RenderLoopRenderer::Submit(const Entity& e)
     }
 }
 
+void RenderLoopRenderer::Submit(const LineEntity& line)
+{
+    linePass.Submit(line);
+}
+
 void RenderLoopRenderer::Draw(const RenderContext& ctx)
 {
     linePass.DrawImmediate(ctx);
@@ -8,12 +8,20 @@
 class RenderLoopRenderer
 {
 public:
-    void Init();
+    // streamBytes sizes the fenced ring the submissions are streamed through.
+    void Init(std::size_t streamBytes = 3u << 20);
     void BeginFrame();
     void Submit(const Entity& e);
+    void Submit(const LineEntity& line);
     void Draw(const RenderContext& ctx);
 
+    // FrameProfiler GPU section for Draw() (default "immediate").
+    void SetTimerName(const char* name) { linePass.SetTimerName(name); }
+
+    const StreamRingBuffer::Stats& GetStreamStats() const { return linePass.GetStreamStats(); }
+
 private:
     LinePass linePass;
+    std::vector<LineEntity> textLines; // Submit() scratch
 };
 
@@ -1,7 +1,7 @@
 #include "Renderer.h"
 #include "glad.h"
+#include "GLStateCache.h"
 
-#include <glm/gtc/type_ptr.hpp>
 #include <cstdio>
 
 // -----------------------------
@@ -59,7 +59,7 @@ void Renderer::Init()
 void Renderer::BeginFrame()
 {
     // Clear once per frame (keep your nice dark background)
-    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    GLStateCache::ClearColor(0.05f, 0.05f, 0.05f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     linePass.BeginFrame();
@@ -115,22 +115,16 @@ void Renderer::LinePass::Init()
     )";
 
     shader = CreateProgram(vs, fs);
+    projectionLoc = glGetUniformLocation(shader, "projection");
+    viewLoc = glGetUniformLocation(shader, "view");
+    modelLoc = glGetUniformLocation(shader, "model");
+    colorLoc = glGetUniformLocation(shader, "color");
 
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    // Reserve room for a bunch of line vertices (each line = 2 verts).
-    // You can bump this if you need more.
-    const size_t maxVerts = 8192;
-    glBufferData(GL_ARRAY_BUFFER, maxVerts * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-
-    glBindVertexArray(0);
+    // Vertices stream through a fenced ring (no fixed vertex limit); the
+    // attribute is re-pointed at each frame's offset in Draw().
+    stream.Init(GL_ARRAY_BUFFER);
 }
 
 void Renderer::LinePass::BeginFrame()
@@ -159,40 +153,40 @@ void Renderer::LinePass::Draw(const glm::mat4& projection,
     if (lines.empty())
         return;
 
-    glUseProgram(shader);
-    glBindVertexArray(vao);
+    GLStateCache::UseProgram(shader);
+    GLStateCache::BindVertexArray(vao);
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
+    GLStateCache::SetEnabled(GL_CULL_FACE, false);
+    GLStateCache::SetEnabled(GL_DEPTH_TEST, false);
 
-    glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-
-    // Upload all line vertices (batched) into the VBO
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLStateCache::UniformMatrix4(projectionLoc, projection);
+    GLStateCache::UniformMatrix4(viewLoc, view);
+    GLStateCache::UniformMatrix4(modelLoc, model);
 
+    // Upload all line vertices in one go
+    vertices.clear();
+    vertices.reserve(lines.size() * 2);
     for (const auto& l : lines)
     {
-        glm::vec3 verts[2] = { l.start, l.end };
-
-        glBufferSubData(
-            GL_ARRAY_BUFFER,
-            l.vboOffset * sizeof(glm::vec3),
-            sizeof(verts),
-            verts
-        );
+        vertices.push_back(l.start);
+        vertices.push_back(l.end);
     }
 
+    stream.ResetFrameStats();
+    const GLintptr offset = stream.Upload(vertices.data(), vertices.size() * sizeof(glm::vec3));
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)offset);
+
     // Draw each line with its own color/width
     for (const auto& l : lines)
     {
-        glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(l.color));
+        GLStateCache::Uniform4f(colorLoc, l.color.r, l.color.g, l.color.b, l.color.a);
         glLineWidth(l.width);
 
         glDrawArrays(GL_LINES, (int)l.vboOffset, 2);
     }
 
-    glBindVertexArray(0);
+    stream.Fence();
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Entity.h"
+#include "StreamRingBuffer.h"
 #include <glm/glm.hpp>
 #include <vector>
 
@@ -45,10 +46,17 @@ private:
             const glm::mat4& model);
 
         unsigned int vao = 0;
-        unsigned int vbo = 0;
         unsigned int shader = 0;
 
+        // Looked up once in Init().
+        int projectionLoc = -1;
+        int viewLoc = -1;
+        int modelLoc = -1;
+        int colorLoc = -1;
+
         std::vector<GPULine> lines;
+        std::vector<glm::vec3> vertices; // per-frame scratch, streamed once
+        StreamRingBuffer stream;
     };
 
     LinePass linePass;
@@ -0,0 +1,235 @@
+// SegmentIntersector.cpp
+#include "SegmentIntersector.h"
+#include "SegmentMath.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    struct SegBox
+    {
+        float minX, minY, maxX, maxY;
+    };
+
+    struct TileGrid
+    {
+        float minX = 0.0f;
+        float minY = 0.0f;
+        float scaleX = 0.0f; // tiles per world unit
+        float scaleY = 0.0f;
+        int nx = 1;
+        int ny = 1;
+
+        int TileX(float x) const { return std::clamp((int)std::floor((x - minX) * scaleX), 0, nx - 1); }
+        int TileY(float y) const { return std::clamp((int)std::floor((y - minY) * scaleY), 0, ny - 1); }
+    };
+
+    TileGrid MakeGrid(const std::vector<SegBox>& boxes, std::size_t segmentsPerTile)
+    {
+        float minX = std::numeric_limits<float>::max(), minY = minX;
+        float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        for (const SegBox& b : boxes)
+        {
+            minX = std::min(minX, b.minX); minY = std::min(minY, b.minY);
+            maxX = std::max(maxX, b.maxX); maxY = std::max(maxY, b.maxY);
+        }
+
+        TileGrid g;
+        g.minX = minX;
+        g.minY = minY;
+
+        const double w = (double)maxX - minX;
+        const double h = (double)maxY - minY;
+        const double tiles = std::clamp((double)boxes.size() / (double)std::max<std::size_t>(1, segmentsPerTile), 1.0, 1048576.0);
+
+        if (w > 0.0 && h > 0.0)
+        {
+            g.nx = std::clamp((int)std::lround(std::sqrt(tiles * w / h)), 1, 4096);
+            g.ny = std::clamp((int)std::ceil(tiles / g.nx), 1, 4096);
+        }
+        else if (w > 0.0)
+        {
+            g.nx = std::clamp((int)tiles, 1, 4096);
+        }
+        else if (h > 0.0)
+        {
+            g.ny = std::clamp((int)tiles, 1, 4096);
+        }
+
+        g.scaleX = (w > 0.0) ? (float)(g.nx / w) : 0.0f;
+        g.scaleY = (h > 0.0) ? (float)(g.ny / h) : 0.0f;
+        return g;
+    }
+}
+
+void SegmentIntersector::CollectSegments(const EntityBook& book, std::vector<IntersectSegment>& out)
+{
+    for (const Entity& e : book.GetEntities())
+    {
+        if (e.tag != EntityTag::Scene || e.type != EntityType::Line)
+            continue;
+
+        IntersectSegment s;
+        s.a = glm::vec2(e.line.start);
+        s.b = glm::vec2(e.line.end);
+        s.id = e.id;
+        out.push_back(s);
+    }
+}
+
+std::vector<SegmentIntersection> SegmentIntersector::FindAll(
+    const std::vector<IntersectSegment>& segments,
+    const Options& options,
+    Stats* stats)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<SegmentIntersection> result;
+    if (segments.size() < 2)
+    {
+        if (stats) *stats = Stats{};
+        return result;
+    }
+
+    const std::size_t n = segments.size();
+
+    std::vector<SegBox> boxes(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const IntersectSegment& s = segments[i];
+        boxes[i] = { std::min(s.a.x, s.b.x), std::min(s.a.y, s.b.y),
+                     std::max(s.a.x, s.b.x), std::max(s.a.y, s.b.y) };
+    }
+
+    const TileGrid grid = MakeGrid(boxes, options.segmentsPerTile);
+    const std::size_t tileCount = (std::size_t)grid.nx * (std::size_t)grid.ny;
+
+    // Bin by box (CSR layout): count, prefix-sum, fill.
+    // Long diagonals land in every tile of their box; that only costs extra tests.
+    std::vector<uint32_t> tileStart(tileCount + 1, 0);
+    for (const SegBox& b : boxes)
+    {
+        const int x0 = grid.TileX(b.minX), x1 = grid.TileX(b.maxX);
+        const int y0 = grid.TileY(b.minY), y1 = grid.TileY(b.maxY);
+        for (int ty = y0; ty <= y1; ++ty)
+            for (int tx = x0; tx <= x1; ++tx)
+                ++tileStart[(std::size_t)ty * grid.nx + tx + 1];
+    }
+    for (std::size_t t = 0; t < tileCount; ++t)
+        tileStart[t + 1] += tileStart[t];
+
+    std::vector<uint32_t> tileItems(tileStart[tileCount]);
+    {
+        std::vector<uint32_t> cursor(tileStart.begin(), tileStart.end() - 1);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const SegBox& b = boxes[i];
+            const int x0 = grid.TileX(b.minX), x1 = grid.TileX(b.maxX);
+            const int y0 = grid.TileY(b.minY), y1 = grid.TileY(b.maxY);
+            for (int ty = y0; ty <= y1; ++ty)
+                for (int tx = x0; tx <= x1; ++tx)
+                    tileItems[cursor[(std::size_t)ty * grid.nx + tx]++] = (uint32_t)i;
+        }
+    }
+
+    const unsigned workers = options.threads ? options.threads : DefaultWorkerCount();
+    std::vector<std::vector<SegmentIntersection>> perWorker(workers);
+    std::vector<std::size_t> testsPerWorker(workers, 0);
+
+    ParallelFor(tileCount, 16, [&](std::size_t begin, std::size_t end, unsigned worker)
+        {
+            auto& out = perWorker[worker];
+            std::size_t tests = 0;
+            std::vector<uint32_t> local;
+
+            for (std::size_t tile = begin; tile < end; ++tile)
+            {
+                const uint32_t first = tileStart[tile];
+                const uint32_t last = tileStart[tile + 1];
+                if (last - first < 2)
+                    continue;
+
+                const int tx = (int)(tile % (std::size_t)grid.nx);
+                const int ty = (int)(tile / (std::size_t)grid.nx);
+
+                // Sweep along X inside the tile.
+                local.assign(tileItems.begin() + first, tileItems.begin() + last);
+                std::sort(local.begin(), local.end(),
+                    [&](uint32_t a, uint32_t b) { return boxes[a].minX < boxes[b].minX; });
+
+                for (std::size_t i = 0; i < local.size(); ++i)
+                {
+                    const SegBox& bi = boxes[local[i]];
+                    for (std::size_t j = i + 1; j < local.size(); ++j)
+                    {
+                        const SegBox& bj = boxes[local[j]];
+                        if (bj.minX > bi.maxX)
+                            break;
+                        if (bj.minY > bi.maxY || bj.maxY < bi.minY)
+                            continue;
+
+                        const IntersectSegment& si = segments[local[i]];
+                        const IntersectSegment& sj = segments[local[j]];
+
+                        ++tests;
+                        glm::vec2 pts[2];
+                        const int count = SegmentMath::Intersect(si.a, si.b, sj.a, sj.b, pts,
+                            options.includeVertexTouches, options.includeOverlaps);
+
+                        for (int k = 0; k < count; ++k)
+                        {
+                            // Only the tile that owns the point reports it. Ownership is
+                            // decided on the point clamped into both boxes, so float
+                            // rounding can never push it into a tile that lacks the pair.
+                            const float ox = std::clamp(pts[k].x, std::max(bi.minX, bj.minX), std::min(bi.maxX, bj.maxX));
+                            const float oy = std::clamp(pts[k].y, std::max(bi.minY, bj.minY), std::min(bi.maxY, bj.maxY));
+                            if (grid.TileX(ox) != tx || grid.TileY(oy) != ty)
+                                continue;
+
+                            SegmentIntersection hit;
+                            hit.point = pts[k];
+                            hit.idA = std::min(si.id, sj.id);
+                            hit.idB = std::max(si.id, sj.id);
+                            out.push_back(hit);
+                        }
+                    }
+                }
+            }
+
+            testsPerWorker[worker] += tests;
+        }, workers);
+
+    std::size_t total = 0;
+    for (const auto& v : perWorker)
+        total += v.size();
+
+    result.reserve(total);
+    for (auto& v : perWorker)
+        result.insert(result.end(), v.begin(), v.end());
+
+    std::sort(result.begin(), result.end(),
+        [](const SegmentIntersection& a, const SegmentIntersection& b)
+        {
+            if (a.idA != b.idA) return a.idA < b.idA;
+            if (a.idB != b.idB) return a.idB < b.idB;
+            if (a.point.x != b.point.x) return a.point.x < b.point.x;
+            return a.point.y < b.point.y;
+        });
+
+    if (stats)
+    {
+        stats->tilesX = (std::size_t)grid.nx;
+        stats->tilesY = (std::size_t)grid.ny;
+        stats->binnedRefs = tileItems.size();
+        stats->pairTests = 0;
+        for (std::size_t t : testsPerWorker)
+            stats->pairTests += t;
+        stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    return result;
+}
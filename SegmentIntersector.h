@@ -0,0 +1,63 @@
+// SegmentIntersector.h
+#pragma once
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "EntityBook.h"
+
+struct IntersectSegment
+{
+    glm::vec2 a{ 0.0f };
+    glm::vec2 b{ 0.0f };
+    std::size_t id = 0; // caller-defined (entity id for EntityBook input)
+};
+
+struct SegmentIntersection
+{
+    glm::vec2 point{ 0.0f };
+    std::size_t idA = 0; // idA < idB
+    std::size_t idB = 0;
+};
+
+// All-pairs segment intersection over a uniform tile grid.
+//
+// Segments are binned into every tile their box overlaps; each tile is then
+// swept along X independently (tiles run in parallel). A crossing is only
+// reported by the tile that contains the crossing point, so pairs sharing
+// several tiles are never reported twice and no global merge/dedupe is needed.
+class SegmentIntersector
+{
+public:
+    struct Options
+    {
+        unsigned threads = 0;               // 0 = hardware concurrency
+        std::size_t segmentsPerTile = 64;   // grid is sized from this
+        bool includeVertexTouches = false;  // polyline joints, corner touches
+        bool includeOverlaps = true;        // ends of collinear overlaps
+    };
+
+    struct Stats
+    {
+        std::size_t tilesX = 0;
+        std::size_t tilesY = 0;
+        std::size_t binnedRefs = 0;   // segment references across all tiles
+        std::size_t pairTests = 0;    // exact segment/segment tests
+        double milliseconds = 0.0;
+    };
+
+    // Results are sorted by (idA, idB, x, y), independent of thread count.
+    static std::vector<SegmentIntersection> FindAll(
+        const std::vector<IntersectSegment>& segments,
+        const Options& options,
+        Stats* stats = nullptr);
+
+    static std::vector<SegmentIntersection> FindAll(const std::vector<IntersectSegment>& segments)
+    {
+        return FindAll(segments, Options{});
+    }
+
+    // Scene line entities of the book (world space), keyed by entity id.
+    static void CollectSegments(const EntityBook& book, std::vector<IntersectSegment>& out);
+};
@@ -0,0 +1,81 @@
+// SegmentMath.h
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+// 2D segment helpers shared by the snap index and the intersection engine.
+// Math is done in double so results are stable for large world coordinates.
+namespace SegmentMath
+{
+    // Intersect segments a0-a1 and b0-b1.
+    // Returns the number of points written to out: 0, 1, or 2 (collinear overlap).
+    //  - includeVertexTouches: report touches where both segments meet at an end
+    //    (shared vertices of a polyline); off for snaps, where endpoints cover them.
+    //  - includeOverlaps: report the two ends of a collinear overlap.
+    inline int Intersect(
+        const glm::vec2& a0, const glm::vec2& a1,
+        const glm::vec2& b0, const glm::vec2& b1,
+        glm::vec2 out[2],
+        bool includeVertexTouches = false,
+        bool includeOverlaps = false)
+    {
+        const double rx = (double)a1.x - a0.x, ry = (double)a1.y - a0.y;
+        const double sx = (double)b1.x - b0.x, sy = (double)b1.y - b0.y;
+        const double qx = (double)b0.x - a0.x, qy = (double)b0.y - a0.y;
+
+        const double rr = rx * rx + ry * ry;
+        const double ss = sx * sx + sy * sy;
+        if (rr == 0.0 || ss == 0.0)
+            return 0;
+
+        const double denom = rx * sy - ry * sx;
+        const double lenProd = std::sqrt(rr * ss);
+        constexpr double eps = 1e-9;
+
+        if (std::abs(denom) <= 1e-12 * lenProd)
+        {
+            // Parallel: only collinear overlaps are of interest.
+            if (!includeOverlaps || std::abs(qx * ry - qy * rx) > 1e-9 * rr)
+                return 0;
+
+            const double t0 = (qx * rx + qy * ry) / rr;
+            const double t1 = t0 + (sx * rx + sy * ry) / rr;
+            const double lo = std::max(0.0, std::min(t0, t1));
+            const double hi = std::min(1.0, std::max(t0, t1));
+            if (hi - lo <= eps)
+                return 0; // disjoint, or a single shared end (vertex touch)
+
+            out[0] = glm::vec2((float)(a0.x + rx * lo), (float)(a0.y + ry * lo));
+            out[1] = glm::vec2((float)(a0.x + rx * hi), (float)(a0.y + ry * hi));
+            return 2;
+        }
+
+        const double t = (qx * sy - qy * sx) / denom;
+        const double u = (qx * ry - qy * rx) / denom;
+
+        if (t < -eps || t > 1.0 + eps || u < -eps || u > 1.0 + eps)
+            return 0;
+
+        if (!includeVertexTouches)
+        {
+            const bool tAtEnd = (t <= eps || t >= 1.0 - eps);
+            const bool uAtEnd = (u <= eps || u >= 1.0 - eps);
+            if (tAtEnd && uAtEnd)
+                return 0;
+        }
+
+        out[0] = glm::vec2((float)(a0.x + rx * t), (float)(a0.y + ry * t));
+        return 1;
+    }
+
+    inline glm::vec2 ClosestPoint(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b)
+    {
+        const glm::vec2 ab = b - a;
+        const float len2 = glm::dot(ab, ab);
+        if (len2 <= 0.0f)
+            return a;
+        const float t = std::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f);
+        return a + ab * t;
+    }
+}
@@ -0,0 +1,290 @@
+// SnapIndex.cpp
+#include "SnapIndex.h"
+#include "SegmentIntersector.h"
+#include "SegmentMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+// ------------------------------------------------------------
+// Small helpers
+// ------------------------------------------------------------
+namespace
+{
+    // Lower rank wins.
+    int SnapRank(SnapType t)
+    {
+        switch (t)
+        {
+        case SnapType::Endpoint:     return 0;
+        case SnapType::Intersection: return 1;
+        case SnapType::Midpoint:     return 2;
+        case SnapType::Nearest:      return 3;
+        default:                     return 4;
+        }
+    }
+}
+
+// ------------------------------------------------------------
+// SnapIndex
+// ------------------------------------------------------------
+BoundingBox SnapIndex::SegmentBox(const glm::vec2& a, const glm::vec2& b)
+{
+    return BoundingBox(
+        std::min(a.x, b.x), std::min(a.y, b.y), -1.0f,
+        std::max(a.x, b.x), std::max(a.y, b.y), 1.0f);
+}
+
+void SnapIndex::Clear()
+{
+    ++m_generation;
+    m_segments.clear();
+    m_points.clear();
+    m_records.clear();
+}
+
+void SnapIndex::Sync(const EntityBook& book)
+{
+    const uint32_t stamp = ++m_syncStamp;
+
+    auto isLine = [](const Entity& e) { return e.tag == EntityTag::Scene && e.type == EntityType::Line; };
+    auto unchanged = [this](const Entity& e)
+        {
+            auto it = m_records.find(e.id);
+            return it != m_records.end() && it->second.a == glm::vec2(e.line.start) && it->second.b == glm::vec2(e.line.end);
+        };
+
+    // Inserting one by one tests every new segment against the old ones it
+    // replaces (crossings that are thrown away again on Remove), so once a
+    // sizeable part of the index would change, packing both trees from
+    // scratch is cheaper.
+    bool bulk = m_records.empty();
+    if (!bulk)
+    {
+        std::size_t lines = 0;
+        std::size_t kept = 0;
+        for (const Entity& e : book.GetEntities())
+        {
+            if (!isLine(e))
+                continue;
+            ++lines;
+            kept += unchanged(e) ? 1 : 0;
+        }
+        const std::size_t changed = lines - kept;
+        const std::size_t stale = m_records.size() - kept;
+        bulk = (changed + stale) * SNAP_BULK_RELOAD_DIVISOR > std::max(m_records.size(), lines);
+    }
+
+    if (bulk)
+    {
+        Clear();
+
+        std::vector<std::pair<std::size_t, Record>> added;
+        for (const Entity& e : book.GetEntities())
+        {
+            if (!isLine(e))
+                continue;
+
+            Record rec;
+            rec.a = glm::vec2(e.line.start);
+            rec.b = glm::vec2(e.line.end);
+            rec.syncStamp = stamp;
+            added.emplace_back(e.id, std::move(rec));
+        }
+        BulkLoad(added);
+        return;
+    }
+
+    for (const Entity& e : book.GetEntities())
+    {
+        if (!isLine(e))
+            continue;
+
+        if (!unchanged(e))
+            Insert(e.id, glm::vec2(e.line.start), glm::vec2(e.line.end));
+        m_records[e.id].syncStamp = stamp;
+    }
+
+    std::vector<std::size_t> stale;
+    for (const auto& kv : m_records)
+        if (kv.second.syncStamp != stamp)
+            stale.push_back(kv.first);
+
+    for (std::size_t id : stale)
+        Remove(id);
+}
+
+void SnapIndex::BulkLoad(const std::vector<std::pair<std::size_t, Record>>& added)
+{
+    ++m_generation;
+    std::vector<SegValue> segs;
+    segs.reserve(added.size());
+    for (const auto& kv : added)
+    {
+        segs.emplace_back(SegmentBox(kv.second.a, kv.second.b), kv.first);
+        m_records.emplace(kv.first, kv.second);
+    }
+
+    // Packing constructor (STR) is much faster than repeated inserts.
+    m_segments = bgi::rtree<SegValue, bgi::quadratic<16>>(segs.begin(), segs.end());
+
+    std::vector<PointValue> points;
+    points.reserve(added.size() * 3);
+
+    std::vector<IntersectSegment> input;
+    input.reserve(added.size());
+
+    for (const auto& kv : m_records)
+    {
+        const std::size_t id = kv.first;
+        const Record& rec = kv.second;
+
+        points.emplace_back(MakePoint(rec.a), PointRef{ SnapType::Endpoint, id, 0 });
+        points.emplace_back(MakePoint(rec.b), PointRef{ SnapType::Endpoint, id, 0 });
+        points.emplace_back(MakePoint((rec.a + rec.b) * 0.5f), PointRef{ SnapType::Midpoint, id, 0 });
+
+        input.push_back({ rec.a, rec.b, id });
+    }
+
+    // Precomputed crossings come from the tiled parallel engine (same rules as Insert).
+    SegmentIntersector::Options opt;
+    opt.includeVertexTouches = false;
+    opt.includeOverlaps = false;
+
+    for (const SegmentIntersection& x : SegmentIntersector::FindAll(input, opt))
+    {
+        m_records[x.idA].crossings.push_back({ x.idB, x.point });
+        m_records[x.idB].crossings.push_back({ x.idA, x.point });
+        points.emplace_back(MakePoint(x.point), PointRef{ SnapType::Intersection, x.idA, x.idB });
+    }
+
+    m_points = bgi::rtree<PointValue, bgi::quadratic<16>>(points.begin(), points.end());
+}
+
+void SnapIndex::Insert(std::size_t id, const glm::vec2& a, const glm::vec2& b)
+{
+    Remove(id);
+    ++m_generation;
+
+    Record rec;
+    rec.a = a;
+    rec.b = b;
+
+    // Partners are found before this segment is in the tree, so it never meets itself.
+    InsertCrossings(id, rec);
+
+    m_segments.insert(SegValue(SegmentBox(a, b), id));
+    m_points.insert(PointValue(MakePoint(a), PointRef{ SnapType::Endpoint, id, 0 }));
+    m_points.insert(PointValue(MakePoint(b), PointRef{ SnapType::Endpoint, id, 0 }));
+    m_points.insert(PointValue(MakePoint((a + b) * 0.5f), PointRef{ SnapType::Midpoint, id, 0 }));
+
+    m_records[id] = std::move(rec);
+}
+
+void SnapIndex::InsertCrossings(std::size_t id, Record& rec)
+{
+    std::vector<SegValue> hits;
+    m_segments.query(bgi::intersects(SegmentBox(rec.a, rec.b)), std::back_inserter(hits));
+
+    for (const SegValue& h : hits)
+    {
+        auto it = m_records.find(h.second);
+        if (it == m_records.end())
+            continue;
+
+        glm::vec2 pts[2];
+        if (SegmentMath::Intersect(rec.a, rec.b, it->second.a, it->second.b, pts) != 1)
+            continue;
+
+        const glm::vec2 x = pts[0];
+
+        rec.crossings.push_back({ h.second, x });
+        it->second.crossings.push_back({ id, x });
+
+        m_points.insert(PointValue(MakePoint(x),
+            PointRef{ SnapType::Intersection, std::min(id, h.second), std::max(id, h.second) }));
+    }
+}
+
+void SnapIndex::Remove(std::size_t id)
+{
+    auto it = m_records.find(id);
+    if (it == m_records.end())
+        return;
+    ++m_generation;
+
+    const Record& rec = it->second;
+
+    m_segments.remove(SegValue(SegmentBox(rec.a, rec.b), id));
+    m_points.remove(PointValue(MakePoint(rec.a), PointRef{ SnapType::Endpoint, id, 0 }));
+    m_points.remove(PointValue(MakePoint(rec.b), PointRef{ SnapType::Endpoint, id, 0 }));
+    m_points.remove(PointValue(MakePoint((rec.a + rec.b) * 0.5f), PointRef{ SnapType::Midpoint, id, 0 }));
+
+    for (const Crossing& c : rec.crossings)
+    {
+        m_points.remove(PointValue(MakePoint(c.point),
+            PointRef{ SnapType::Intersection, std::min(id, c.other), std::max(id, c.other) }));
+
+        auto ot = m_records.find(c.other);
+        if (ot == m_records.end())
+            continue;
+
+        auto& oc = ot->second.crossings;
+        oc.erase(std::remove_if(oc.begin(), oc.end(),
+            [id](const Crossing& x) { return x.other == id; }), oc.end());
+    }
+
+    m_records.erase(it);
+}
+
+std::optional<SnapResult> SnapIndex::FindBest(const glm::vec2& p, float radius, unsigned mask) const
+{
+    const BoundingBox box(p.x - radius, p.y - radius, -1.0f, p.x + radius, p.y + radius, 1.0f);
+
+    std::optional<SnapResult> best;
+    int bestRank = 0;
+
+    auto consider = [&](SnapType type, const glm::vec2& pt, std::size_t a, std::size_t b)
+        {
+            const float d = glm::length(pt - p);
+            if (d > radius)
+                return;
+
+            const int rank = SnapRank(type);
+            if (best && (rank > bestRank || (rank == bestRank && d >= best->distance)))
+                return;
+
+            best = SnapResult{ type, pt, d, a, b };
+            bestRank = rank;
+        };
+
+    std::vector<PointValue> points;
+    m_points.query(bgi::intersects(box), std::back_inserter(points));
+
+    for (const PointValue& v : points)
+    {
+        if (!(mask & SnapMask(v.second.type)))
+            continue;
+
+        const glm::vec2 pt(bg::get<0>(v.first), bg::get<1>(v.first));
+        consider(v.second.type, pt, v.second.a, v.second.b);
+    }
+
+    if (best || !(mask & SnapMask(SnapType::Nearest)))
+        return best;
+
+    std::vector<SegValue> segs;
+    m_segments.query(bgi::intersects(box), std::back_inserter(segs));
+
+    for (const SegValue& s : segs)
+    {
+        auto it = m_records.find(s.second);
+        if (it == m_records.end())
+            continue;
+
+        consider(SnapType::Nearest, SegmentMath::ClosestPoint(p, it->second.a, it->second.b), s.second, 0);
+    }
+
+    return best;
+}
@@ -0,0 +1,122 @@
+// SnapIndex.h
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "BoundingBox.h"
+#include "EntityBook.h"
+
+namespace bgi = boost::geometry::index;
+
+#ifndef SNAP_BULK_RELOAD_DIVISOR
+// Sync repacks the whole index once more than 1/N of its records are new,
+// moved or gone; one-by-one updates get slower than that past a few percent.
+#define SNAP_BULK_RELOAD_DIVISOR 32
+#endif
+
+enum class SnapType : uint8_t
+{
+    Endpoint,
+    Midpoint,
+    Intersection,
+    Nearest
+};
+
+// Bit mask of enabled snap types (1 << SnapType).
+constexpr unsigned SnapMask(SnapType t) { return 1u << static_cast<unsigned>(t); }
+constexpr unsigned kSnapMaskAll =
+    SnapMask(SnapType::Endpoint) | SnapMask(SnapType::Midpoint) |
+    SnapMask(SnapType::Intersection) | SnapMask(SnapType::Nearest);
+
+struct SnapResult
+{
+    SnapType type = SnapType::Nearest;
+    glm::vec2 point{ 0.0f };     // world space
+    float distance = 0.0f;       // world units from the query point
+    std::size_t entityId = 0;    // entity that produced the snap
+    std::size_t otherId = 0;     // second entity (intersections only)
+};
+
+// Object-snap index kept next to RGeometryTree.
+//
+// Holds two R-trees: one of segment boxes (for "nearest" and for finding
+// intersection partners) and one of precomputed snap points (endpoints,
+// midpoints, intersections). Everything is keyed by entity id rather than
+// EntityBook index, so sorting the book does not invalidate it and single
+// entities can be inserted/removed without a rebuild.
+class SnapIndex
+{
+public:
+    void Clear();
+
+    // Bring the index in line with the book's Scene line entities.
+    // Only entities that are new, removed, or whose endpoints moved are touched;
+    // when that is a sizeable part of them (see SNAP_BULK_RELOAD_DIVISOR) the
+    // index is rebuilt in one go instead.
+    void Sync(const EntityBook& book);
+
+    // Incremental updates (Insert replaces an existing entry with the same id).
+    void Insert(std::size_t id, const glm::vec2& a, const glm::vec2& b);
+    void Remove(std::size_t id);
+
+    // Best snap within radius (world units) of p.
+    // Priority: endpoint > intersection > midpoint > nearest; ties go to the closest.
+    std::optional<SnapResult> FindBest(const glm::vec2& p, float radius, unsigned mask = kSnapMaskAll) const;
+
+    std::size_t GetSegmentCount() const { return m_records.size(); }
+    std::size_t GetPointCount() const { return m_points.size(); }
+
+    // Bumped by every change to the index (a Sync that changes nothing keeps it).
+    uint64_t GetGeneration() const { return m_generation; }
+
+private:
+    using Point = bg::model::point<float, 3, bg::cs::cartesian>;
+
+    struct PointRef
+    {
+        SnapType type = SnapType::Endpoint;
+        std::size_t a = 0;
+        std::size_t b = 0;
+
+        bool operator==(const PointRef& o) const { return type == o.type && a == o.a && b == o.b; }
+    };
+
+    using PointValue = std::pair<Point, PointRef>;
+    using SegValue = std::pair<BoundingBox, std::size_t>;
+
+    struct Crossing
+    {
+        std::size_t other = 0;
+        glm::vec2 point{ 0.0f };
+    };
+
+    struct Record
+    {
+        glm::vec2 a{ 0.0f };
+        glm::vec2 b{ 0.0f };
+        std::vector<Crossing> crossings;
+        uint32_t syncStamp = 0;
+    };
+
+    static Point MakePoint(const glm::vec2& p) { return Point(p.x, p.y, 0.0f); }
+    static BoundingBox SegmentBox(const glm::vec2& a, const glm::vec2& b);
+
+    void InsertCrossings(std::size_t id, Record& rec);
+    void BulkLoad(const std::vector<std::pair<std::size_t, Record>>& added);
+
+private:
+    bgi::rtree<SegValue, bgi::quadratic<16>> m_segments;
+    bgi::rtree<PointValue, bgi::quadratic<16>> m_points;
+
+    std::unordered_map<std::size_t, Record> m_records;
+    uint32_t m_syncStamp = 0;
+    uint64_t m_generation = 0;
+};
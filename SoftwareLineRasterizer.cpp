@@ -0,0 +1,428 @@
+// SoftwareLineRasterizer.cpp
+#include "SoftwareLineRasterizer.h"
+#include "LineInstanceStore.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SW_RASTER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SW_RASTER_SSE2 0
+#endif
+
+namespace
+{
+    uint32_t PackColor(const glm::vec4& c)
+    {
+        // Same rounding as LinePass::PackColor.
+        auto u8 = [](float v) { return (uint32_t)(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+        return u8(c.r) | (u8(c.g) << 8) | (u8(c.b) << 16) | (u8(c.a) << 24);
+    }
+
+    // std::floor/ceil are library calls without SSE4.1.
+    inline int FloorToInt(float v)
+    {
+        const int i = (int)v;
+        return i - (v < (float)i ? 1 : 0);
+    }
+
+    inline int CeilToInt(float v)
+    {
+        const int i = (int)v;
+        return i + (v > (float)i ? 1 : 0);
+    }
+
+    // Mesa's fill convention for GL (lower-left origin): a pixel center exactly
+    // on an edge belongs to the quad if it is a left or bottom edge. In this
+    // Y-down buffer that is an outward normal pointing left, or down for
+    // horizontal edges.
+    bool IncludesEdge(float nx, float ny)
+    {
+        return nx < 0.0f || (nx == 0.0f && ny > 0.0f);
+    }
+
+    // Pixel columns [x0, x1] whose centers fall in [lo, hi] (offsets from cx),
+    // clamped to [minX, maxX]. Empty when x0 > x1.
+    inline void ColumnRange(float cx, float lo, float hi, int minX, int maxX, int& x0, int& x1)
+    {
+        x0 = CeilToInt(std::max(cx + lo - 0.5f, (float)minX));
+        x1 = FloorToInt(std::min(cx + hi - 0.5f, (float)maxX));
+    }
+}
+
+// ------------------------------------------------------------
+// Target
+// ------------------------------------------------------------
+void SoftwareLineRasterizer::Resize(int w, int h)
+{
+    width = std::max(1, w);
+    height = std::max(1, h);
+    stride = (width + 3) & ~3;
+    pixels.assign((std::size_t)stride * (std::size_t)height, 0u);
+
+    tilesX = (width + SW_RASTER_TILE_PX - 1) / SW_RASTER_TILE_PX;
+    tilesY = (height + SW_RASTER_TILE_PX - 1) / SW_RASTER_TILE_PX;
+    jobBins.clear();
+}
+
+void SoftwareLineRasterizer::Clear(const glm::vec4& color)
+{
+    std::fill(pixels.begin(), pixels.end(), PackColor(color));
+}
+
+void SoftwareLineRasterizer::ReadPixels(std::vector<uint8_t>& rgba) const
+{
+    rgba.resize((std::size_t)width * (std::size_t)height * 4);
+    for (int y = 0; y < height; ++y)
+        std::memcpy(rgba.data() + (std::size_t)y * width * 4, pixels.data() + (std::size_t)y * stride, (std::size_t)width * 4);
+}
+
+// ------------------------------------------------------------
+// Setup + binning
+// ------------------------------------------------------------
+inline void SoftwareLineRasterizer::RowSpan(const Segment& s, float ry, float& lo, float& hi)
+{
+    const float centerA = s.slopeA * ry;
+    const float centerB = s.slopeB * ry;
+    lo = std::max(centerA - s.halfA, centerB - s.halfB);
+    hi = std::min(centerA + s.halfA, centerB + s.halfB);
+}
+
+bool SoftwareLineRasterizer::Setup(const LineEntity& line, const glm::mat4& mvp, Segment& out) const
+{
+    return Setup(mvp * glm::vec4(line.p0, 1.0f), mvp * glm::vec4(line.p1, 1.0f), PackColor(line.color), line.width, out);
+}
+
+bool SoftwareLineRasterizer::Setup(const LineInstance& line, const glm::mat4& mvp, Segment& out) const
+{
+    return Setup(mvp * glm::vec4(line.p0.x, line.p0.y, 0.0f, 1.0f), mvp * glm::vec4(line.p1.x, line.p1.y, 0.0f, 1.0f), line.color, line.width, out);
+}
+
+// c0/c1: endpoints in clip space.
+bool SoftwareLineRasterizer::Setup(const glm::vec4& c0, const glm::vec4& c1, uint32_t color, float lineWidth, Segment& out) const
+{
+    if (c0.w <= 0.0f || c1.w <= 0.0f)
+        return false;
+
+    // NDC -> pixels with row 0 at the top (GL framebuffers are read back flipped).
+    const glm::vec2 s0(((c0.x / c0.w) * 0.5f + 0.5f) * (float)width, (0.5f - (c0.y / c0.w) * 0.5f) * (float)height);
+    const glm::vec2 s1(((c1.x / c1.w) * 0.5f + 0.5f) * (float)width, (0.5f - (c1.y / c1.w) * 0.5f) * (float)height);
+
+    const glm::vec2 d = s1 - s0;
+    const float len = std::sqrt(d.x * d.x + d.y * d.y);
+    if (!(len >= 1e-4f) || !std::isfinite(len))
+        return false; // zero-length: LinePass collapses these too
+
+    const float halfWidth = 0.5f * std::max(lineWidth, 1.0f);
+    const float pad = antialias ? 0.5f : 0.0f;
+
+    out.cx = 0.5f * (s0.x + s1.x);
+    out.cy = 0.5f * (s0.y + s1.y);
+    out.dx = d.x / len;
+    out.dy = d.y / len;
+    out.extentA = 0.5f * len + halfWidth + pad;
+    out.extentB = halfWidth + pad;
+    out.color = color;
+    return true;
+}
+
+void SoftwareLineRasterizer::Bin(Segment& s, std::vector<std::vector<Segment>>& bins) const
+{
+    const float a = s.extentA;
+    const float b = s.extentB;
+
+    // Row spans: |rx*dx + ry*dy| <= a and |ry*dx - rx*dy| <= b are two slabs in
+    // rx whose centers move linearly with ry. Padded by a pixel; the per-pixel
+    // test is exact.
+    const bool steepA = std::fabs(s.dx) < 1e-4f;
+    const bool flatB = std::fabs(s.dy) < 1e-4f;
+    s.slopeA = steepA ? 0.0f : -s.dy / s.dx;
+    s.halfA = steepA ? 1e30f : std::fabs(a / s.dx) + 1.0f;
+    s.slopeB = flatB ? 0.0f : s.dx / s.dy;
+    s.halfB = flatB ? 1e30f : std::fabs(b / s.dy) + 1.0f;
+
+    // Corners of the (padded) rectangle.
+    const float ax = s.dx * a, ay = s.dy * a;
+    const float bx = -s.dy * b, by = s.dx * b;
+    const float cornerX[4] = { s.cx - ax - bx, s.cx - ax + bx, s.cx + ax - bx, s.cx + ax + bx };
+    const float cornerY[4] = { s.cy - ay - by, s.cy - ay + by, s.cy + ay - by, s.cy + ay + by };
+
+    const float minX = std::min(std::min(cornerX[0], cornerX[1]), std::min(cornerX[2], cornerX[3]));
+    const float maxX = std::max(std::max(cornerX[0], cornerX[1]), std::max(cornerX[2], cornerX[3]));
+    const float minY = std::min(std::min(cornerY[0], cornerY[1]), std::min(cornerY[2], cornerY[3]));
+    const float maxY = std::max(std::max(cornerY[0], cornerY[1]), std::max(cornerY[2], cornerY[3]));
+
+    // Rows/columns whose pixel centers (+ 0.5) can be covered.
+    const int y0 = CeilToInt(std::max(minY - 0.5f, 0.0f));
+    const int y1 = FloorToInt(std::min(maxY - 0.5f, (float)(height - 1)));
+    const int x0 = CeilToInt(std::max(minX - 0.5f, 0.0f));
+    const int x1 = FloorToInt(std::min(maxX - 0.5f, (float)(width - 1)));
+    if (y0 > y1 || x0 > x1)
+        return;
+
+    s.rowBegin = y0;
+    s.rowEnd = y1 + 1;
+
+    const int ty0 = y0 / SW_RASTER_TILE_PX;
+    const int ty1 = y1 / SW_RASTER_TILE_PX;
+    const int tx0 = x0 / SW_RASTER_TILE_PX;
+    const int tx1 = x1 / SW_RASTER_TILE_PX;
+    if (ty0 == ty1 || tx0 == tx1)
+    {
+        // Most segments: one tile row or column, the box is tight enough.
+        for (int ty = ty0; ty <= ty1; ++ty)
+            for (int tx = tx0; tx <= tx1; ++tx)
+                bins[(std::size_t)ty * tilesX + tx].push_back(s);
+        return;
+    }
+
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        // The rectangle is convex: its x-extent within this band of rows comes
+        // from the spans on the first/last row and any corner inside the band.
+        const float bandTop = (float)std::max(y0, ty * SW_RASTER_TILE_PX) + 0.5f;
+        const float bandBottom = (float)std::min(y1, ty * SW_RASTER_TILE_PX + SW_RASTER_TILE_PX - 1) + 0.5f;
+
+        float bandMin = 1e30f, bandMax = -1e30f;
+        for (float y : { bandTop, bandBottom })
+        {
+            float lo, hi;
+            RowSpan(s, y - s.cy, lo, hi);
+            if (lo <= hi)
+            {
+                bandMin = std::min(bandMin, s.cx + lo);
+                bandMax = std::max(bandMax, s.cx + hi);
+            }
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            if (cornerY[i] >= bandTop && cornerY[i] <= bandBottom)
+            {
+                bandMin = std::min(bandMin, cornerX[i]);
+                bandMax = std::max(bandMax, cornerX[i]);
+            }
+        }
+
+        int bandX0, bandX1;
+        ColumnRange(0.0f, bandMin, bandMax, x0, x1, bandX0, bandX1);
+        if (bandX0 > bandX1)
+            continue;
+
+        for (int tx = bandX0 / SW_RASTER_TILE_PX; tx <= bandX1 / SW_RASTER_TILE_PX; ++tx)
+            bins[(std::size_t)ty * tilesX + tx].push_back(s);
+    }
+}
+
+void SoftwareLineRasterizer::Draw(const LineEntity* lines, std::size_t count, const RenderContext& ctx)
+{
+    DrawLines(lines, count, ctx);
+}
+
+void SoftwareLineRasterizer::Draw(const LineInstance* lines, std::size_t count, const RenderContext& ctx)
+{
+    DrawLines(lines, count, ctx);
+}
+
+template <typename Line>
+void SoftwareLineRasterizer::DrawLines(const Line* lines, std::size_t count, const RenderContext& ctx)
+{
+    stats = Stats{};
+    stats.segments = count;
+    if (count == 0 || pixels.empty())
+        return;
+
+    using Clock = std::chrono::steady_clock;
+    const auto t0 = Clock::now();
+
+    const glm::mat4 mvp = ctx.projection * ctx.view * ctx.model;
+    const std::size_t tileCount = (std::size_t)tilesX * (std::size_t)tilesY;
+
+    jobCount = (count + SW_RASTER_BIN_SEGMENTS - 1) / SW_RASTER_BIN_SEGMENTS;
+    if (jobBins.size() < jobCount)
+        jobBins.resize(jobCount);
+
+    ParallelFor(jobCount, 1, [&](std::size_t begin, std::size_t end, unsigned)
+        {
+            for (std::size_t job = begin; job < end; ++job)
+            {
+                auto& bins = jobBins[job];
+                bins.resize(tileCount);
+                for (auto& b : bins)
+                    b.clear();
+
+                const std::size_t first = job * SW_RASTER_BIN_SEGMENTS;
+                const std::size_t last = std::min(count, first + SW_RASTER_BIN_SEGMENTS);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    Segment s;
+                    if (Setup(lines[i], mvp, s))
+                        Bin(s, bins);
+                }
+            }
+        }, threads);
+
+    const auto t1 = Clock::now();
+
+    ParallelFor((std::size_t)tilesY, 1, [&](std::size_t begin, std::size_t end, unsigned)
+        {
+            for (std::size_t ty = begin; ty < end; ++ty)
+                for (int tx = 0; tx < tilesX; ++tx)
+                    RasterizeTile(tx, (int)ty);
+        }, threads);
+
+    const auto t2 = Clock::now();
+
+    for (std::size_t job = 0; job < jobCount; ++job)
+        for (const auto& b : jobBins[job])
+            stats.tileRefs += b.size();
+
+    stats.setupMilliseconds = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+// ------------------------------------------------------------
+// Rasterization
+// ------------------------------------------------------------
+void SoftwareLineRasterizer::RasterizeTile(int tileX, int tileY)
+{
+    const std::size_t tile = (std::size_t)tileY * tilesX + tileX;
+
+    const int x0 = tileX * SW_RASTER_TILE_PX;
+    const int y0 = tileY * SW_RASTER_TILE_PX;
+    // The last column of tiles extends into the row padding so SIMD groups
+    // never straddle two tiles (or threads).
+    const int x1 = (tileX == tilesX - 1) ? stride : std::min(stride, x0 + SW_RASTER_TILE_PX);
+    const int y1 = std::min(height, y0 + SW_RASTER_TILE_PX);
+
+    // Jobs hold consecutive segment ranges, so this is submission order.
+    for (std::size_t job = 0; job < jobCount; ++job)
+        for (const Segment& s : jobBins[job][tile])
+            RasterizeSegment(s, x0, y0, x1, y1);
+}
+
+void SoftwareLineRasterizer::RasterizeSegment(const Segment& s, int tx0, int ty0, int tx1, int ty1)
+{
+    const float a = s.extentA;
+    const float b = s.extentB;
+
+#if SW_RASTER_SSE2
+    const __m128 vA = _mm_set1_ps(a);
+    const __m128 vB = _mm_set1_ps(b);
+    const __m128 vDx = _mm_set1_ps(s.dx);
+    const __m128 vDy = _mm_set1_ps(s.dy);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 vScale = _mm_set1_ps(128.0f);
+    const __m128 vAbs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 vLane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128i vZeroI = _mm_setzero_si128();
+    const __m128i vSrc = _mm_unpacklo_epi8(_mm_set1_epi32((int)s.color), vZeroI); // r g b a r g b a (u16)
+#endif
+
+    // Aliased: inside is -a <= along < a (same across), signs flipped so the
+    // included edges match the GL rasterizer.
+    const float alongSign = IncludesEdge(s.dx, s.dy) ? -1.0f : 1.0f;
+    const float acrossSign = IncludesEdge(-s.dy, s.dx) ? -1.0f : 1.0f;
+
+    const int rowBegin = std::max(ty0, s.rowBegin);
+    const int rowEnd = std::min(ty1, s.rowEnd);
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const float ry = (float)y + 0.5f - s.cy;
+
+        float lo, hi;
+        RowSpan(s, ry, lo, hi);
+
+        int xs, xe;
+        ColumnRange(s.cx, lo, hi, tx0, tx1 - 1, xs, xe);
+        if (xs > xe)
+            continue;
+
+        uint32_t* row = pixels.data() + (std::size_t)y * stride;
+
+#if SW_RASTER_SSE2
+        const __m128 vRyDx = _mm_set1_ps(ry * s.dx);
+        const __m128 vRyDy = _mm_set1_ps(ry * s.dy);
+
+        for (int x = xs & ~3; x <= xe; x += 4)
+        {
+            const __m128 rx = _mm_add_ps(_mm_set1_ps((float)x + 0.5f - s.cx), vLane);
+            const __m128 along = _mm_add_ps(_mm_mul_ps(rx, vDx), vRyDy);
+            const __m128 across = _mm_sub_ps(vRyDx, _mm_mul_ps(rx, vDy));
+
+            __m128 cov;
+            if (antialias)
+            {
+                const __m128 ca = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vA, _mm_and_ps(along, vAbs)), vZero), vOne);
+                const __m128 cb = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vB, _mm_and_ps(across, vAbs)), vZero), vOne);
+                cov = _mm_mul_ps(ca, cb);
+            }
+            else
+            {
+                const __m128 sa = _mm_mul_ps(along, _mm_set1_ps(alongSign));
+                const __m128 sb = _mm_mul_ps(across, _mm_set1_ps(acrossSign));
+                const __m128 inA = _mm_and_ps(_mm_cmpge_ps(sa, _mm_sub_ps(vZero, vA)), _mm_cmplt_ps(sa, vA));
+                const __m128 inB = _mm_and_ps(_mm_cmpge_ps(sb, _mm_sub_ps(vZero, vB)), _mm_cmplt_ps(sb, vB));
+                cov = _mm_and_ps(_mm_and_ps(inA, inB), vOne);
+            }
+
+            // Coverage in 0..128 so (src - dst) * cov fits in 16 bits.
+            const __m128i covI = _mm_cvtps_epi32(_mm_mul_ps(cov, vScale));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(covI, vZeroI)) == 0xFFFF)
+                continue;
+
+            const __m128i cov16 = _mm_packs_epi32(covI, covI);          // c0 c1 c2 c3 c0 c1 c2 c3
+            const __m128i covPairs = _mm_unpacklo_epi16(cov16, cov16);  // c0 c0 c1 c1 c2 c2 c3 c3
+            const __m128i cov01 = _mm_unpacklo_epi32(covPairs, covPairs);
+            const __m128i cov23 = _mm_unpackhi_epi32(covPairs, covPairs);
+
+            __m128i* p = reinterpret_cast<__m128i*>(row + x);
+            const __m128i dst = _mm_loadu_si128(p);
+            __m128i lo16 = _mm_unpacklo_epi8(dst, vZeroI);
+            __m128i hi16 = _mm_unpackhi_epi8(dst, vZeroI);
+
+            lo16 = _mm_add_epi16(lo16, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(vSrc, lo16), cov01), 7));
+            hi16 = _mm_add_epi16(hi16, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(vSrc, hi16), cov23), 7));
+
+            _mm_storeu_si128(p, _mm_packus_epi16(lo16, hi16));
+        }
+#else
+        for (int x = xs; x <= xe; ++x)
+        {
+            const float rx = (float)x + 0.5f - s.cx;
+            const float along = rx * s.dx + ry * s.dy;
+            const float across = ry * s.dx - rx * s.dy;
+
+            int cov;
+            if (antialias)
+            {
+                cov = (int)std::lround(std::clamp(a - std::fabs(along), 0.0f, 1.0f) * std::clamp(b - std::fabs(across), 0.0f, 1.0f) * 128.0f);
+            }
+            else
+            {
+                const float sa = along * alongSign;
+                const float sb = across * acrossSign;
+                cov = (sa >= -a && sa < a && sb >= -b && sb < b) ? 128 : 0;
+            }
+            if (cov == 0)
+                continue;
+
+            uint32_t d = row[x];
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                const int dc = (int)((d >> shift) & 0xFF);
+                const int sc = (int)((s.color >> shift) & 0xFF);
+                const int c = dc + (((sc - dc) * cov) >> 7);
+                out |= (uint32_t)c << shift;
+            }
+            row[x] = out;
+        }
+#endif
+    }
+}
@@ -0,0 +1,118 @@
+// SoftwareLineRasterizer.h
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "LineEntity.h"
+#include "RenderContext.h"
+
+struct LineInstance;
+
+#ifndef SW_RASTER_TILE_PX
+// Square screen tiles segments are binned into; a multiple of 4 (SIMD width).
+#define SW_RASTER_TILE_PX 64
+#endif
+
+#ifndef SW_RASTER_BIN_SEGMENTS
+// Segments set up and binned per parallel job.
+#define SW_RASTER_BIN_SEGMENTS 16384
+#endif
+
+// CPU rasterizer for LineEntity batches into an RGBA8 buffer, for thumbnails,
+// previews and machines without OpenGL.
+//
+// Lines have the same geometry as LinePass: a screen-space rectangle of
+// max(width, 1) pixels, extended by half the width past each endpoint. With
+// antialiasing on, pixel coverage is the product of the (clamped) distances to
+// the rectangle's edges at the pixel center; off, a pixel is lit when its center
+// is inside, like the GL path. Colors replace the destination (weighted by
+// coverage), alpha included, like LinePass which draws without blending.
+//
+// Draw() sets up and bins segments into SW_RASTER_TILE_PX tiles in parallel
+// jobs, then rasterizes rows of tiles in parallel, four pixels at a time with
+// SSE2 where available. Each tile sees its segments in submission order, so
+// the output does not depend on the thread count.
+class SoftwareLineRasterizer
+{
+public:
+    struct Stats
+    {
+        std::size_t segments = 0;  // last Draw()
+        std::size_t tileRefs = 0;  // (segment, tile) pairs rasterized
+        double setupMilliseconds = 0.0;
+        double rasterMilliseconds = 0.0;
+    };
+
+    void Resize(int width, int height);
+    void Clear(const glm::vec4& color);
+
+    // Transforms with ctx (projection * view * model) like LinePass; the
+    // viewport is always this buffer.
+    void Draw(const LineEntity* lines, std::size_t count, const RenderContext& ctx);
+    void Draw(const std::vector<LineEntity>& lines, const RenderContext& ctx) { Draw(lines.data(), lines.size(), ctx); }
+
+    // Same for LinePass instances (2D, RGBA8), e.g. the retained batches read
+    // back with LinePass::ReadStatic.
+    void Draw(const LineInstance* lines, std::size_t count, const RenderContext& ctx);
+
+    void SetAntialiasing(bool enabled) { antialias = enabled; }
+    void SetThreads(unsigned count) { threads = count; } // 0 = hardware concurrency
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // Tightly packed RGBA8, top row first (same layout as HeadlessContext::ReadPixels).
+    void ReadPixels(std::vector<uint8_t>& rgba) const;
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    struct Segment
+    {
+        float cx = 0.0f, cy = 0.0f;    // center (pixels, Y down)
+        float dx = 0.0f, dy = 0.0f;    // unit direction
+        float extentA = 0.0f;          // half extent along dir (caps and AA padding included)
+        float extentB = 0.0f;          // half extent across
+        uint32_t color = 0;            // RGBA8, memory order r,g,b,a
+        int rowBegin = 0, rowEnd = 0;  // rows with covered pixel centers
+
+        // Covered offsets from cx on the row at offset ry from cy are
+        // slope * ry +- half for both A (along) and B (across); see RowSpan().
+        float slopeA = 0.0f, halfA = 0.0f;
+        float slopeB = 0.0f, halfB = 0.0f;
+    };
+
+    static void RowSpan(const Segment& s, float ry, float& lo, float& hi);
+
+    template <typename Line>
+    void DrawLines(const Line* lines, std::size_t count, const RenderContext& ctx);
+
+    bool Setup(const LineEntity& line, const glm::mat4& mvp, Segment& out) const;
+    bool Setup(const LineInstance& line, const glm::mat4& mvp, Segment& out) const;
+    bool Setup(const glm::vec4& c0, const glm::vec4& c1, uint32_t color, float lineWidth, Segment& out) const;
+    void Bin(Segment& s, std::vector<std::vector<Segment>>& bins) const;
+    void RasterizeTile(int tileX, int tileY);
+    void RasterizeSegment(const Segment& s, int x0, int y0, int x1, int y1);
+
+private:
+    int width = 0;
+    int height = 0;
+    int stride = 0; // pixels per row, padded to a multiple of 4
+    std::vector<uint32_t> pixels;
+
+    int tilesX = 0;
+    int tilesY = 0;
+
+    bool antialias = true;
+    unsigned threads = 0;
+
+    // Per Draw() and bin job, the set-up segments of each tile. Copies rather
+    // than indices so each tile streams its segments sequentially.
+    std::vector<std::vector<std::vector<Segment>>> jobBins;
+    std::size_t jobCount = 0;
+
+    Stats stats;
+};
@@ -1,17 +1,53 @@
 // StatefulVectorRenderer.cpp
 #include "StatefulVectorRenderer.h"
 
-#include "HersheyTextBuilder.h"
+#include "FrameProfiler.h"
+#include "HersheyTextCache.h"
+#include "ParallelFor.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp> // glm::ortho
 
+namespace
+{
+    // Store keys of LOD chunks; entity ids never get this high.
+    constexpr uint64_t kLodChunkKeyBit = 1ull << 63;
+
+    // Largest part number a ChunkKey holds.
+    constexpr uint32_t kChunkPartMask = 0x1FFFu;
+}
+
+StatefulVectorRenderer::~StatefulVectorRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        batchQuit = true;
+    }
+    batchWake.notify_all();
+    if (batchWorker.joinable())
+        batchWorker.join();
+}
+
 void StatefulVectorRenderer::Init()
 {
     worldPass.Init();
+    for (LinePass& pass : scenePasses)
+        pass.Init();
     hudPass.Init();
+    overlayPass.Init(OVERLAY_STREAM_BYTES);
+
+    worldPass.SetTimerName("world");
+    for (LinePass& pass : scenePasses)
+        pass.SetTimerName("scene");
+    hudPass.SetTimerName("hud");
+    overlayPass.SetTimerName("overlay");
+    passesInitialized = true;
 }
 
 void StatefulVectorRenderer::SetEntityBook(const EntityBook* book)
@@ -25,39 +61,954 @@ void StatefulVectorRenderer::MarkDirty()
     dirty = true;
 }
 
+StatefulVectorRenderer::BatchGroup StatefulVectorRenderer::GroupOf(const Entity& e)
+{
+    if (e.screenSpace)
+        return HudGroup;
+    return (e.tag == EntityTag::Scene) ? SceneGroup : WorldGroup;
+}
+
+LinePass& StatefulVectorRenderer::GroupPass(BatchGroup group)
+{
+    switch (group)
+    {
+    case SceneGroup:  return scenePasses[sceneFront];
+    case HudGroup:    return hudPass;
+    default:          return worldPass;
+    }
+}
+
+// Group (2 bits), layer (16), tile (32) and part (13) below kLodChunkKeyBit.
+// Callers keep part within kChunkPartMask; a wrapped part would alias another
+// chunk of the same tile.
+uint64_t StatefulVectorRenderer::ChunkKey(BatchGroup group, int layer, uint32_t cell, uint32_t part)
+{
+    assert(part <= kChunkPartMask);
+    const uint64_t layerBits = (uint16_t)(int16_t)std::clamp(layer, -32768, 32767);
+    return kLodChunkKeyBit | ((uint64_t)group << 61) | (layerBits << 45) | ((uint64_t)cell << 13) | (part & kChunkPartMask);
+}
+
+// World tile of a line's midpoint, as two int16 tile coordinates.
+uint32_t StatefulVectorRenderer::ChunkCell(const LineEntity& line)
+{
+    auto tile = [](float v)
+        {
+            const float t = std::floor(v / WORLD_CHUNK_SIZE);
+            return std::isfinite(t) ? (uint32_t)(uint16_t)(int16_t)std::clamp(t, -32768.0f, 32767.0f) : 0u;
+        };
+    return (tile(0.5f * (line.start.x + line.end.x)) << 16) | tile(0.5f * (line.start.y + line.end.y));
+}
+
 void StatefulVectorRenderer::RebuildBatchesIfDirty()
 {
-    if (!dirty || !entityBook)
+    if (!entityBook)
+        return;
+
+    // Tags changed since the last sync, and the ones among them whose entities
+    // were added, removed or reordered rather than just edited.
+    uint32_t changedTags = 0;
+    uint32_t layoutTags = 0;
+    for (std::size_t t = 0; t < kEntityTagCount; ++t)
+    {
+        const uint64_t version = entityBook->GetVersion((EntityTag)t);
+        if (version != tagVersions[t])
+            changedTags |= 1u << t;
+        tagVersions[t] = version;
+
+        const uint64_t layout = entityBook->GetLayoutVersion((EntityTag)t);
+        if (layout != layoutVersions[t])
+            layoutTags |= 1u << t;
+        layoutVersions[t] = layout;
+    }
+
+    editedIds.clear();
+    const bool editsKnown = entityBook->GetEditsSince(editCursor, editedIds);
+    editCursor = entityBook->GetEditCount();
+
+    static const uint32_t kDefaultTags[BatchGroupCount] = {
+        1u << (int)EntityTag::Grid,
+        1u << (int)EntityTag::Scene,
+        (1u << (int)EntityTag::Hud) | (1u << (int)EntityTag::Cursor),
+    };
+
+    // A group is rebuilt when the layout of a tag it holds (or would hold by
+    // default) changed; one whose tags were only edited redoes just the edited
+    // entities. Idle frames stop here.
+    bool rebuild[BatchGroupCount];
+    bool edited[BatchGroupCount];
+    bool any = false;
+    for (int g = 0; g < BatchGroupCount; ++g)
+    {
+        const uint32_t tags = groupTags[g] | kDefaultTags[g];
+        rebuild[g] = dirty || (layoutTags & tags) != 0 || (!editsKnown && (changedTags & tags) != 0);
+        edited[g] = !rebuild[g] && (changedTags & tags) != 0;
+        any |= rebuild[g] || edited[g];
+    }
+    dirty = false;
+    if (!any)
         return;
 
-    cachedWorldLines.clear();
-    cachedHudLines.clear();
+    ScopedCpuTimer cpuTimer("RebuildBatchesIfDirty");
+
+    // Scene edits that can't be redone on their own while a background
+    // rebuild is under way wait for its swap, which replays them.
+    const bool sceneLayout = rebuild[SceneGroup];
+    ApplyEdits(edited, rebuild);
+    if (rebuild[SceneGroup] && !sceneLayout && SceneBuildPending())
+        rebuild[SceneGroup] = false;
 
     const auto& entities = entityBook->GetEntities();
 
-    for (const Entity& e : entities)
+    // Big books rebuild the scene on the worker; the current scene batches
+    // keep drawing until the new ones are uploaded (UpdateAsyncBatches). A
+    // synchronous scene rebuild supersedes any background one.
+    if (rebuild[SceneGroup])
+    {
+        if (entities.size() >= asyncBatchMin)
+        {
+            RequestSceneBuild();
+            rebuild[SceneGroup] = false;
+        }
+        else
+        {
+            CancelSceneBuilds();
+        }
+    }
+
+    if (!rebuild[WorldGroup] && !rebuild[SceneGroup] && !rebuild[HudGroup])
+        return;
+
+    // Re-submit every entity of a rebuilt group; the passes diff against what
+    // they already hold, so unchanged entities upload nothing and removed ids
+    // are dropped.
+    for (int g = 0; g < BatchGroupCount; ++g)
+    {
+        if (!rebuild[g])
+            continue;
+        GroupPass((BatchGroup)g).BeginStaticSync();
+        looseKeys[g].clear();
+    }
+    ++lodStamp;
+    ++batchVersion;
+
+    for (auto it = chunkOfEntity.begin(); it != chunkOfEntity.end(); )
+    {
+        if (rebuild[(it->second >> 61) & 3])
+            it = chunkOfEntity.erase(it);
+        else
+            ++it;
+    }
+
+    BuildGeneration(entities, rebuild, batchThreads, generation);
+    CommitGeneration(generation);
+
+    // Chunks and scene keys of rebuilt groups that were not seen again are gone.
+    for (auto it = lodChunks.begin(); it != lodChunks.end(); )
+    {
+        const bool rebuilt = rebuild[it->second.scene ? SceneGroup : WorldGroup];
+        if (rebuilt && it->second.stamp != lodStamp)
+            it = lodChunks.erase(it);
+        else
+            ++it;
+    }
+
+    if (rebuild[SceneGroup])
+        DropStaleSceneKeys();
+
+    for (int g = 0; g < BatchGroupCount; ++g)
+    {
+        if (!rebuild[g])
+            continue;
+        GroupPass((BatchGroup)g).EndStaticSync();
+        groupTags[g] = generation.tags[g];
+    }
+}
+
+// Plans the submissions of the rebuilt groups in entity order from the entity
+// headers alone, then emits and prepares them. World lines go to the open
+// chunk of their group, layer and tile, which hands out their slot, until it
+// holds LOD_CHUNK_SEGMENTS; entities drawn on their own and other layers in
+// between leave it open. A chunk is submitted where its first line is (the
+// store draws a layer in allocation order anyway). A tile that has used up
+// every part of its key (only a clamped border tile can) draws its remaining
+// lines on their own.
+void StatefulVectorRenderer::BuildGeneration(const std::vector<Entity>& entities, const bool* rebuild, unsigned threads, BatchGeneration& gen)
+{
+    std::unordered_map<uint64_t, uint32_t> open[BatchGroupCount]; // chunk by (layer, tile)
+    std::unordered_map<uint64_t, uint32_t> nextPart;               // by ChunkKey(..., 0)
+    gen.chunkCount = 0;
+    gen.ops.clear();
+    std::fill(std::begin(gen.tags), std::end(gen.tags), 0u);
+
+    // Everything past this point only sees the rebuilt groups' entities, so a
+    // grid rebuild costs the grid, not the book.
+    gen.members.clear();
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        const Entity& e = entities[i];
+        const BatchGroup group = GroupOf(e);
+        if (!rebuild[group])
+            continue;
+        gen.tags[group] |= 1u << (int)e.tag;
+        gen.members.push_back(i);
+    }
+    gen.targets.assign(gen.members.size(), EmitTarget{});
+    if (gen.members.size() < BATCH_BUILD_PARALLEL_MIN)
+        threads = 1;
+
+    auto startChunk = [&](BatchGroup group, int layer, uint32_t cell)
+        {
+            uint32_t& part = nextPart[ChunkKey(group, layer, cell, 0)];
+            if (part > kChunkPartMask)
+                return kNoChunk;
+
+            const uint64_t key = ChunkKey(group, layer, cell, part++);
+            if (gen.chunkCount == gen.chunks.size())
+                gen.chunks.emplace_back();
+            ChunkData& chunk = gen.chunks[gen.chunkCount];
+            chunk.layer = layer;
+            chunk.scene = (group == SceneGroup);
+            chunk.ids.clear();
+            gen.ops.push_back({ group, key, layer, (uint32_t)gen.chunkCount, 0 });
+            return (uint32_t)gen.chunkCount++;
+        };
+
+    for (std::size_t m = 0; m < gen.members.size(); ++m)
+    {
+        const Entity& e = entities[gen.members[m]];
+        const BatchGroup group = GroupOf(e);
+
+        if (e.type == EntityType::Line && !e.screenSpace)
+        {
+            const uint32_t cell = ChunkCell(e.line);
+            auto it = open[group].try_emplace(((uint64_t)(uint32_t)e.drawOrder << 32) | cell, kNoChunk).first;
+            if (it->second == kNoChunk || gen.chunks[it->second].ids.size() >= LOD_CHUNK_SEGMENTS)
+                it->second = startChunk(group, e.drawOrder, cell);
+
+            if (it->second != kNoChunk)
+            {
+                ChunkData& chunk = gen.chunks[it->second];
+                gen.targets[m] = EmitTarget{ it->second, (uint32_t)chunk.ids.size() };
+                chunk.ids.push_back(e.id);
+                continue;
+            }
+        }
+
+        if (e.type != EntityType::Line && e.type != EntityType::Text)
+            continue;
+
+        gen.ops.push_back({ group, e.id, e.drawOrder, kNoChunk, m });
+    }
+
+    // One line per id; emission fills the slots.
+    for (std::size_t c = 0; c < gen.chunkCount; ++c)
+        gen.chunks[c].lines.resize(gen.chunks[c].ids.size());
+
+    // Vertex emission and text tessellation only read the entities and write
+    // disjoint memory, so they run in parallel; chunk hashes and packing
+    // bounds are independent per chunk.
+    EmitBatchInstances(entities, threads, gen);
+
+    ParallelFor(gen.chunkCount, 1, [&gen](std::size_t begin, std::size_t end, unsigned)
+        {
+            for (std::size_t c = begin; c < end; ++c)
+                PrepareLodChunk(gen.chunks[c]);
+        }, threads);
+}
+
+// Instances emitted for an entity drawn on its own.
+const LineInstance* StatefulVectorRenderer::LooseInstances(const BatchGeneration& gen, std::size_t member, uint32_t& count)
+{
+    const EmitRange& range = gen.ranges[member / BATCH_BUILD_GRAIN];
+    const std::size_t local = member % BATCH_BUILD_GRAIN;
+    const uint32_t begin = local ? range.ends[local - 1] : 0;
+    count = range.ends[local] - begin;
+    return range.instances.data() + begin;
+}
+
+// Submits a generation to the front passes inside their sync. Built chunks
+// swap their data into the persistent ones (which keep their pyramids and
+// hand their old memory back to the generation).
+void StatefulVectorRenderer::CommitGeneration(BatchGeneration& gen)
+{
+    for (const BatchOp& op : gen.ops)
+    {
+        if (op.chunk != kNoChunk)
+        {
+            LodChunk& chunk = lodChunks[op.key];
+            std::swap(static_cast<ChunkData&>(chunk), gen.chunks[op.chunk]);
+            chunk.dirty = false;
+            for (const std::size_t id : chunk.ids)
+                chunkOfEntity[id] = op.key;
+
+            FinishLodChunk(op.key, chunk, GroupPass(op.group));
+            if (chunk.scene)
+                TrackSceneKey(op.key, chunk.hash, chunk.lines.data(), chunk.lines.size());
+            continue;
+        }
+
+        uint32_t count = 0;
+        const LineInstance* data = LooseInstances(gen, op.member, count);
+        GroupPass(op.group).SetStaticInstances(op.key, op.layer, data, count);
+        if (op.group != HudGroup)
+            looseKeys[op.group].push_back(op.key);
+        if (op.group == SceneGroup)
+            TrackSceneKey(op.key, LineLodBuilder::Hash(data, count), data, count);
+    }
+}
+
+// Redoes the entities edited since the last sync in groups that are not
+// rebuilt anyway: chunked lines mark their chunk dirty (it stays in its tile
+// until the next rebuild, with its bounds updated), everything else is
+// re-submitted on its own. A group whose edits can't be replayed is flagged
+// for a rebuild instead.
+void StatefulVectorRenderer::ApplyEdits(const bool* editedGroups, bool* rebuild)
+{
+    std::sort(editedIds.begin(), editedIds.end());
+    editedIds.erase(std::unique(editedIds.begin(), editedIds.end()), editedIds.end());
+
+    const auto& entities = entityBook->GetEntities();
+    dirtyChunkKeys.clear();
+
+    for (const std::size_t id : editedIds)
     {
+        const auto index = entityBook->FindIndexById(id);
+        if (!index)
+            continue; // removed since, which is a layout change
+
+        const Entity& e = entities[*index];
+        const BatchGroup group = GroupOf(e);
+        if (!editedGroups[group] || rebuild[group])
+            continue;
+
+        auto chunkIt = chunkOfEntity.find(id);
+        if (chunkIt != chunkOfEntity.end())
+        {
+            auto it = lodChunks.find(chunkIt->second);
+            if (it != lodChunks.end() && !it->second.dirty)
+            {
+                it->second.dirty = true;
+                dirtyChunkKeys.push_back(it->first);
+            }
+            continue;
+        }
+
+        if (e.type == EntityType::Line && !e.screenSpace)
+        {
+            rebuild[group] = true; // not chunked yet (or its tile ran out of parts)
+            continue;
+        }
+
+        editInstances.clear();
         if (e.type == EntityType::Line)
         {
-            if (e.screenSpace) cachedHudLines.push_back(e.line);
-            else               cachedWorldLines.push_back(e.line);
+            editInstances.push_back(LinePass::MakeInstance(e.line));
         }
         else if (e.type == EntityType::Text)
         {
-            if (e.screenSpace)
-                HersheyTextBuilder::BuildLines(e.text, cachedHudLines);
-            else
-                HersheyTextBuilder::BuildLines(e.text, cachedWorldLines);
+            editLines.clear();
+            HersheyTextCache::BuildLines(e.text, editLines);
+            for (const auto& l : editLines)
+                editInstances.push_back(LinePass::MakeInstance(l));
+        }
+        else
+        {
+            continue;
         }
+
+        GroupPass(group).SetStaticInstances(e.id, e.drawOrder, editInstances.data(), editInstances.size());
+        if (group == SceneGroup)
+            TrackSceneKey(e.id, LineLodBuilder::Hash(editInstances.data(), editInstances.size()), editInstances.data(), editInstances.size());
     }
 
-    worldPass.BuildStatic(cachedWorldLines);
-    hudPass.BuildStatic(cachedHudLines);
+    for (const uint64_t key : dirtyChunkKeys)
+    {
+        LodChunk& chunk = lodChunks[key];
+        chunk.dirty = false;
+        const BatchGroup group = chunk.scene ? SceneGroup : WorldGroup;
+        if (rebuild[group])
+            continue;
 
-    dirty = false;
+        chunk.lines.clear();
+        for (const std::size_t id : chunk.ids)
+        {
+            const auto index = entityBook->FindIndexById(id);
+            if (!index)
+                break;
+            chunk.lines.push_back(LinePass::MakeInstance(entities[*index].line));
+        }
+        if (chunk.lines.size() != chunk.ids.size())
+        {
+            rebuild[group] = true;
+            continue;
+        }
+
+        PrepareLodChunk(chunk);
+        FinishLodChunk(key, chunk, GroupPass(group));
+        if (chunk.scene)
+            TrackSceneKey(key, chunk.hash, chunk.lines.data(), chunk.lines.size());
+    }
+}
+
+// Emits the instances of the generation's members, one fixed range of
+// BATCH_BUILD_GRAIN members per work item: chunked lines into their planned
+// chunk slot, everything else into the range's own EmitRange.
+void StatefulVectorRenderer::EmitBatchInstances(const std::vector<Entity>& entities, unsigned threads, BatchGeneration& gen)
+{
+    const std::size_t rangeCount = (gen.members.size() + BATCH_BUILD_GRAIN - 1) / BATCH_BUILD_GRAIN;
+    if (gen.ranges.size() < rangeCount)
+        gen.ranges.resize(rangeCount);
+
+    ParallelFor(rangeCount, 1, [&](std::size_t begin, std::size_t end, unsigned)
+        {
+            for (std::size_t r = begin; r < end; ++r)
+            {
+                EmitRange& out = gen.ranges[r];
+                out.instances.clear();
+                out.ends.clear();
+
+                const std::size_t first = r * BATCH_BUILD_GRAIN;
+                const std::size_t last = std::min(gen.members.size(), first + BATCH_BUILD_GRAIN);
+                for (std::size_t m = first; m < last; ++m)
+                {
+                    const Entity& e = entities[gen.members[m]];
+                    const EmitTarget& target = gen.targets[m];
+                    if (target.chunk != kNoChunk)
+                    {
+                        gen.chunks[target.chunk].lines[target.slot] = LinePass::MakeInstance(e.line);
+                    }
+                    else if (e.type == EntityType::Line)
+                    {
+                        out.instances.push_back(LinePass::MakeInstance(e.line));
+                    }
+                    else if (e.type == EntityType::Text)
+                    {
+                        out.textLines.clear();
+                        HersheyTextCache::BuildLines(e.text, out.textLines);
+                        for (const auto& l : out.textLines)
+                            out.instances.push_back(LinePass::MakeInstance(l));
+                    }
+                    out.ends.push_back((uint32_t)out.instances.size());
+                }
+            }
+        }, threads);
+}
+
+// ------------------------------------------------------------
+// Background rebuilds
+// ------------------------------------------------------------
+// Hands a copy of the scene entities to the worker; a snapshot it has not
+// started on yet is replaced. Edits from here on go to the front pass as
+// usual and are redone on the new generation when it is swapped in.
+void StatefulVectorRenderer::RequestSceneBuild()
+{
+    std::unique_ptr<SceneBuild> build = spareBuild ? std::move(spareBuild) : std::make_unique<SceneBuild>();
+    build->serial = ++sceneBuildSerial;
+    build->editCursor = entityBook->GetEditCount();
+    build->threads = batchThreads;
+
+    // Only the fields the build reads, into entities kept from earlier
+    // snapshots; a line's stale text payload is never looked at.
+    const auto& entities = entityBook->GetEntities();
+    build->entities.resize(entities.size());
+    std::size_t count = 0;
+    for (const Entity& e : entities)
+    {
+        if (GroupOf(e) != SceneGroup)
+            continue;
+        Entity& copy = build->entities[count++];
+        copy.id = e.id;
+        copy.type = e.type;
+        copy.tag = e.tag;
+        copy.screenSpace = e.screenSpace;
+        copy.drawOrder = e.drawOrder;
+        copy.line = e.line;
+        if (e.type == EntityType::Text)
+            copy.text = e.text;
+    }
+    build->entities.resize(count);
+
+    if (!batchWorker.joinable())
+        batchWorker = std::thread(&StatefulVectorRenderer::BatchWorkerMain, this);
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        std::swap(queuedBuild, build);
+    }
+    batchWake.notify_one();
+    if (build)
+        spareBuild = std::move(build); // superseded before the worker got to it
+    ++asyncStats.requested;
+}
+
+// A synchronous scene rebuild outdates every background one requested so far:
+// builds still in flight are dropped when they land and an upload in progress
+// is abandoned (the next one re-syncs the back pass from scratch).
+void StatefulVectorRenderer::CancelSceneBuilds()
+{
+    if (!SceneBuildPending())
+        return;
+
+    syncSceneSerial = sceneBuildSerial;
+    sceneTakenSerial = sceneBuildSerial;
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        queuedBuild.reset();
+    }
+
+    // Front chunks whose pyramid requests were replaced ask again when the
+    // rebuild submits them (see RequestLod).
+    if (applyingBuild)
+    {
+        nextChunks.clear();
+        spareBuild = std::move(applyingBuild);
+    }
+}
+
+// Picks up a finished generation and submits the next BATCH_UPLOAD_INSTANCES_PER_FRAME
+// of it to the back scene pass, uploading the slice right away (when drawing
+// with GL) so drawing the front pass in the same frame stays cheap. The last
+// slice swaps the passes.
+void StatefulVectorRenderer::UpdateAsyncBatches()
+{
+    if (!applyingBuild)
+    {
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+            applyingBuild = std::move(readyBuild);
+        }
+        if (!applyingBuild)
+            return;
+
+        sceneTakenSerial = std::max(sceneTakenSerial, applyingBuild->serial);
+        if (applyingBuild->serial <= syncSceneSerial)
+        {
+            spareBuild = std::move(applyingBuild);
+            return;
+        }
+
+        scenePasses[sceneFront ^ 1].BeginStaticSync();
+        nextChunks.clear();
+        applyCursor = 0;
+    }
+
+    ScopedCpuTimer cpuTimer("UploadSceneBatches");
 
-    //std::cout << "[StatefulVectorRenderer] rebuilt: worldLines=" << cachedWorldLines.size()
-              //<< " hudLines=" << cachedHudLines.size() << std::endl;
+    LinePass& back = scenePasses[sceneFront ^ 1];
+    BatchGeneration& gen = applyingBuild->generation;
+    std::size_t submitted = 0;
+    while (applyCursor < gen.ops.size() && submitted < BATCH_UPLOAD_INSTANCES_PER_FRAME)
+    {
+        const BatchOp& op = gen.ops[applyCursor++];
+        if (op.chunk != kNoChunk)
+        {
+            // Pyramids of unchanged chunks carry over from the front.
+            LodChunk& chunk = nextChunks[op.key];
+            std::swap(static_cast<ChunkData&>(chunk), gen.chunks[op.chunk]);
+            auto front = lodChunks.find(op.key);
+            if (front != lodChunks.end())
+            {
+                chunk.lod = front->second.lod;
+                chunk.requestedHash = front->second.requestedHash;
+            }
+
+            FinishLodChunk(op.key, chunk, back);
+            submitted += chunk.lines.size();
+            continue;
+        }
+
+        uint32_t count = 0;
+        const LineInstance* data = LooseInstances(gen, op.member, count);
+        back.SetStaticInstances(op.key, op.layer, data, count);
+        submitted += count;
+    }
+
+    if (passesInitialized)
+        back.FlushStatic();
+    ++asyncStats.uploadFrames;
+
+    if (applyCursor == gen.ops.size())
+        SwapSceneGeneration();
+}
+
+// Makes the fully uploaded back scene pass the front one, with its chunks,
+// loose keys and tile invalidation, then redoes the edits made since the
+// generation's snapshot (they only reached the old front).
+void StatefulVectorRenderer::SwapSceneGeneration()
+{
+    scenePasses[sceneFront ^ 1].EndStaticSync();
+    sceneFront ^= 1;
+    ++lodStamp;
+    ++batchVersion;
+
+    for (auto it = lodChunks.begin(); it != lodChunks.end(); )
+    {
+        if (it->second.scene)
+            it = lodChunks.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = chunkOfEntity.begin(); it != chunkOfEntity.end(); )
+    {
+        if (((it->second >> 61) & 3) == SceneGroup)
+            it = chunkOfEntity.erase(it);
+        else
+            ++it;
+    }
+    looseKeys[SceneGroup].clear();
+
+    const BatchGeneration& gen = applyingBuild->generation;
+    for (const BatchOp& op : gen.ops)
+    {
+        if (op.chunk != kNoChunk)
+        {
+            LodChunk& chunk = lodChunks[op.key];
+            chunk = std::move(nextChunks[op.key]);
+            chunk.stamp = lodStamp;
+            for (const std::size_t id : chunk.ids)
+                chunkOfEntity[id] = op.key;
+
+            RequestLod(op.key, chunk);
+            TrackSceneKey(op.key, chunk.hash, chunk.lines.data(), chunk.lines.size());
+            continue;
+        }
+
+        uint32_t count = 0;
+        const LineInstance* data = LooseInstances(gen, op.member, count);
+        looseKeys[SceneGroup].push_back(op.key);
+        TrackSceneKey(op.key, LineLodBuilder::Hash(data, count), data, count);
+    }
+    nextChunks.clear();
+    DropStaleSceneKeys();
+    groupTags[SceneGroup] = gen.tags[SceneGroup];
+    ++asyncStats.swapped;
+
+    const uint64_t since = applyingBuild->editCursor;
+    const bool latest = applyingBuild->serial == sceneBuildSerial;
+    spareBuild = std::move(applyingBuild);
+
+    bool edited[BatchGroupCount]{};
+    bool rebuild[BatchGroupCount]{};
+    edited[SceneGroup] = true;
+    editedIds.clear();
+    if (entityBook->GetEditsSince(since, editedIds))
+        ApplyEdits(edited, rebuild);
+    else
+        rebuild[SceneGroup] = true;
+
+    // Edits that can't be redone need another pass, unless one is coming.
+    if (rebuild[SceneGroup] && latest)
+        RequestSceneBuild();
+}
+
+void StatefulVectorRenderer::BatchWorkerMain()
+{
+    static const bool kSceneOnly[BatchGroupCount] = { false, true, false };
+
+    std::unique_lock<std::mutex> lock(batchMutex);
+    for (;;)
+    {
+        batchWake.wait(lock, [this] { return batchQuit || queuedBuild; });
+        if (batchQuit)
+            return;
+
+        std::unique_ptr<SceneBuild> build = std::move(queuedBuild);
+        lock.unlock();
+
+        BuildGeneration(build->entities, kSceneOnly, build->threads, build->generation);
+
+        lock.lock();
+        readyBuild = std::move(build); // a newer result replaces one not picked up
+    }
+}
+
+// ------------------------------------------------------------
+// Level of detail
+// ------------------------------------------------------------
+// Hash, packing error and bounds of a chunk's full-detail lines. Touches nothing but
+// the chunk, so chunks of one rebuild are prepared in parallel.
+void StatefulVectorRenderer::PrepareLodChunk(ChunkData& chunk)
+{
+    chunk.hash = LineLodBuilder::Hash(chunk.lines.data(), chunk.lines.size());
+
+    // Every level lies within the full-detail bounds, so this bounds the packing
+    // error of whichever level is submitted.
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    float maxWidth = 0.0f;
+    for (const auto& l : chunk.lines)
+    {
+        lo = glm::min(lo, glm::min(l.p0, l.p1));
+        hi = glm::max(hi, glm::max(l.p0, l.p1));
+        maxWidth = std::max(maxWidth, l.width);
+    }
+    const glm::vec2 halfExtent = chunk.lines.empty() ? glm::vec2(0.0f) : 0.5f * (hi - lo);
+    chunk.quantError = 0.5f * std::max(halfExtent.x, halfExtent.y) / 32767.0f;
+
+    // Culling bounds
+    chunk.boundsMin = lo;
+    chunk.boundsMax = hi;
+    chunk.maxWidth = maxWidth;
+}
+
+// Submits a prepared chunk (see PrepareLodChunk) to pass, which is inside its sync.
+void StatefulVectorRenderer::FinishLodChunk(uint64_t key, LodChunk& chunk, LinePass& pass)
+{
+    chunk.stamp = lodStamp;
+    ++batchVersion;
+
+    RequestLod(key, chunk);
+
+    // Always re-submit inside the sync so the store keeps the key.
+    chunk.submittedLevel = -2;
+    SubmitLodChunk(key, chunk, pass);
+}
+
+// Pyramids are built off-thread; until one for this content lands, the chunk
+// is drawn at full detail.
+void StatefulVectorRenderer::RequestLod(uint64_t key, LodChunk& chunk)
+{
+    const bool lodCurrent = chunk.lod && chunk.lod->hash == chunk.hash;
+    if (lodCurrent || chunk.requestedHash == chunk.hash)
+        return;
+
+    lodBuilder.Request(key, chunk.hash, chunk.lines.data(), chunk.lines.size());
+    chunk.requestedHash = chunk.hash;
+
+    // That replaces a request still queued under the key, which may be the one
+    // of the other scene buffer's chunk; it asks again when it is submitted.
+    for (auto* chunks : { &lodChunks, &nextChunks })
+    {
+        auto it = chunks->find(key);
+        if (it != chunks->end() && &it->second != &chunk && it->second.requestedHash != chunk.hash)
+            it->second.requestedHash = 0;
+    }
+}
+
+void StatefulVectorRenderer::SubmitLodChunk(uint64_t key, LodChunk& chunk, LinePass& pass)
+{
+    const bool lodCurrent = chunk.lod && chunk.lod->hash == chunk.hash;
+    const int level = lodCurrent ? chunk.lod->SelectLevel(worldPerPixel) : -1;
+
+    // Pack while the int16 grid stays well under a pixel at this zoom.
+    const float maxError = LINE_PACK_PIXEL_ERROR * worldPerPixel;
+    const bool packed = chunk.quantError <= maxError;
+
+    if (level == chunk.submittedLevel && chunk.hash == chunk.submittedHash && packed == chunk.submittedPacked)
+        return;
+
+    const std::vector<LineInstance>& lines = (level >= 0) ? chunk.lod->levels[level] : chunk.lines;
+    pass.SetStaticInstances(key, chunk.layer, lines.data(), lines.size(), packed ? maxError : 0.0f);
+
+    chunk.submittedLevel = level;
+    chunk.submittedHash = chunk.hash;
+    chunk.submittedPacked = packed;
+}
+
+void StatefulVectorRenderer::UpdateLod()
+{
+    lodResults.clear();
+    lodBuilder.Poll(lodResults);
+    for (auto& r : lodResults)
+    {
+        // Chunks waiting in the back scene pass share keys with the front.
+        auto next = nextChunks.find(r.first);
+        if (next != nextChunks.end())
+            next->second.lod = r.second;
+
+        auto it = lodChunks.find(r.first);
+        if (it != lodChunks.end())
+            it->second.lod = std::move(r.second);
+    }
+    if (!lodResults.empty())
+        ++batchVersion;
+
+    // Zoom changes (and finished pyramids) only swap the submitted level;
+    // otherwise every chunk already holds the level it would get.
+    if (batchVersion != lodVersion || worldPerPixel != lodWorldPerPixel)
+    {
+        lodVersion = batchVersion;
+        lodWorldPerPixel = worldPerPixel;
+
+        lodStats = LodStats{};
+        for (auto& kv : lodChunks)
+        {
+            LodChunk& chunk = kv.second;
+            SubmitLodChunk(kv.first, chunk, GroupPass(chunk.scene ? SceneGroup : WorldGroup));
+
+            ++lodStats.chunks;
+            lodStats.sourceInstances += chunk.lines.size();
+            const std::size_t drawn = (chunk.submittedLevel >= 0)
+                ? chunk.lod->levels[chunk.submittedLevel].size() : chunk.lines.size();
+            lodStats.drawnInstances += drawn;
+            if (chunk.submittedLevel >= 0)
+                ++lodStats.simplifiedChunks;
+            if (chunk.submittedPacked && drawn >= LINE_PACK_MIN_INSTANCES)
+                ++lodStats.packedChunks;
+            if (chunk.requestedHash == chunk.hash && !(chunk.lod && chunk.lod->hash == chunk.hash))
+                ++lodStats.pendingChunks;
+        }
+    }
+
+    lodStats.culledChunks = 0;
+    lodStats.staticBytes = 0;
+    for (const LinePass* pass : { &worldPass, &scenePasses[0], &scenePasses[1], &hudPass })
+        lodStats.staticBytes += pass->GetStaticStats().capacityBytes + pass->GetPackedStats().capacityBytes;
+}
+
+bool StatefulVectorRenderer::HasPendingWork() const
+{
+    return SceneBuildPending() || lodStats.pendingChunks > 0 || (tileCacheEnabled && tileCache.GetStats().pending > 0);
+}
+
+// ------------------------------------------------------------
+// Tile cache
+// ------------------------------------------------------------
+void StatefulVectorRenderer::ToggleTileCache()
+{
+    tileCacheEnabled = !tileCacheEnabled;
+
+    // Invalidation is tracked while disabled too; just give the memory back.
+    if (!tileCacheEnabled)
+        tileCache.Release();
+}
+
+void StatefulVectorRenderer::TrackSceneKey(uint64_t key, uint64_t hash, const LineInstance* lines, std::size_t count)
+{
+    auto it = sceneKeys.find(key);
+    const bool existed = (it != sceneKeys.end());
+    if (existed && it->second.hash == hash)
+    {
+        it->second.stamp = lodStamp;
+        return;
+    }
+
+    SceneKey& s = existed ? it->second : sceneKeys[key];
+    s.stamp = lodStamp;
+
+    // Tiles showing the old or the new geometry are out of date.
+    if (existed)
+        tileCache.Invalidate(s.boundsMin, s.boundsMax);
+
+    s.hash = hash;
+    s.boundsMin = glm::vec2(std::numeric_limits<float>::max());
+    s.boundsMax = glm::vec2(std::numeric_limits<float>::lowest());
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const LineInstance& l = lines[i];
+        s.boundsMin = glm::min(s.boundsMin, glm::min(glm::vec2(l.p0), glm::vec2(l.p1)));
+        s.boundsMax = glm::max(s.boundsMax, glm::max(glm::vec2(l.p0), glm::vec2(l.p1)));
+    }
+
+    if (count)
+        tileCache.Invalidate(s.boundsMin, s.boundsMax);
+}
+
+void StatefulVectorRenderer::DropStaleSceneKeys()
+{
+    for (auto it = sceneKeys.begin(); it != sceneKeys.end(); )
+    {
+        if (it->second.stamp != lodStamp)
+        {
+            tileCache.Invalidate(it->second.boundsMin, it->second.boundsMax);
+            it = sceneKeys.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void StatefulVectorRenderer::DrawSceneTile(const RenderContext& tileCtx, const glm::vec2& worldMin, const glm::vec2& worldMax)
+{
+    tileKeys.clear();
+    for (const auto& kv : sceneKeys)
+    {
+        const SceneKey& s = kv.second;
+        if (s.boundsMax.x < worldMin.x || s.boundsMin.x > worldMax.x ||
+            s.boundsMax.y < worldMin.y || s.boundsMin.y > worldMax.y)
+            continue;
+        tileKeys.push_back(kv.first);
+    }
+
+    GroupPass(SceneGroup).DrawStaticKeys(tileCtx, tileKeys);
+}
+
+void StatefulVectorRenderer::DrawCulled(const RenderContext& ctx, BatchGroup group)
+{
+    LinePass& pass = GroupPass(group);
+    const VisibleKeys& visible = CollectVisibleKeys(ctx, group);
+    if (visible.culled == 0)
+        pass.DrawStatic(ctx);
+    else
+        pass.DrawStaticKeys(ctx, visible.keys);
+}
+
+const StatefulVectorRenderer::VisibleKeys& StatefulVectorRenderer::CollectVisibleKeys(const RenderContext& ctx, BatchGroup group)
+{
+    VisibleKeys& visible = visibleKeys[group];
+    const glm::mat4 mvp = ctx.projection * ctx.view * ctx.model;
+    if (visible.version == batchVersion && visible.worldPerPixel == worldPerPixel && visible.mvp == mvp)
+    {
+        lodStats.culledChunks += visible.culled;
+        return visible;
+    }
+    visible.version = batchVersion;
+    visible.worldPerPixel = worldPerPixel;
+    visible.mvp = mvp;
+
+    // World rectangle under the viewport (the NDC square mapped back).
+    const glm::mat4 inverseMvp = glm::inverse(mvp);
+    glm::vec2 viewMin(std::numeric_limits<float>::max());
+    glm::vec2 viewMax(std::numeric_limits<float>::lowest());
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        const glm::vec4 w = inverseMvp * glm::vec4((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, 0.0f, 1.0f);
+        const glm::vec2 p = glm::vec2(w.x, w.y) / w.w;
+        viewMin = glm::min(viewMin, p);
+        viewMax = glm::max(viewMax, p);
+    }
+
+    visible.keys = looseKeys[group];
+    std::size_t culled = 0;
+    for (const auto& kv : lodChunks)
+    {
+        const LodChunk& chunk = kv.second;
+        if ((chunk.scene ? SceneGroup : WorldGroup) != group)
+            continue;
+
+        // Lines reach half their pixel width (plus a pixel of antialiasing)
+        // past their endpoints.
+        const float pad = (0.5f * chunk.maxWidth + 1.0f) * worldPerPixel;
+        if (chunk.boundsMax.x + pad < viewMin.x || chunk.boundsMin.x - pad > viewMax.x ||
+            chunk.boundsMax.y + pad < viewMin.y || chunk.boundsMin.y - pad > viewMax.y)
+        {
+            ++culled;
+            continue;
+        }
+        visible.keys.push_back(kv.first);
+    }
+    visible.culled = culled;
+    lodStats.culledChunks += culled;
+    return visible;
+}
+
+// World size of one framebuffer pixel under the context's transform.
+static float WorldPerPixel(const RenderContext& ctx)
+{
+    glm::vec2 viewport = ctx.viewportSize;
+    if (viewport.x <= 0.0f || viewport.y <= 0.0f)
+    {
+        GLint vp[4] = { 0, 0, 1, 1 };
+        glGetIntegerv(GL_VIEWPORT, vp);
+        viewport = glm::vec2((float)std::max(1, vp[2]), (float)std::max(1, vp[3]));
+    }
+
+    const glm::mat4 mvp = ctx.projection * ctx.view * ctx.model;
+    const float px = mvp[0][0] * 0.5f * viewport.x;
+    const float py = mvp[0][1] * 0.5f * viewport.y;
+    const float pixelsPerWorld = std::sqrt(px * px + py * py);
+    return (pixelsPerWorld > 0.0f) ? 1.0f / pixelsPerWorld : 0.0f;
 }
 
 // Extract viewport dimensions from glm::ortho(0, w, h, 0, -1, 1) (Y-down).
@@ -72,15 +1023,44 @@ static void ExtractViewportWH_FromOrthoYDown(const glm::mat4& proj, float& outW,
 
 void StatefulVectorRenderer::Redraw(const RenderContext& ctx)
 {
-    // DEBUG / SIMPLICITY: always rebuild so EntityBook mutations (colors) show immediately.
-    dirty = true; // <-- ADDED
+    worldPerPixel = WorldPerPixel(ctx);
 
     RebuildBatchesIfDirty();
+    UpdateAsyncBatches();
+    UpdateLod();
 
     // World pass uses Application model/view/projection
-    worldPass.DrawStatic(ctx);
+    DrawCulled(ctx, WorldGroup);
+
+    if (tileCacheEnabled)
+    {
+        // One section for the composite; the tile renders nest inside it.
+        ScopedGpuTimer gpuTimer("scene");
+        tileCache.Draw(ctx, [this](const RenderContext& tileCtx, const glm::vec2& worldMin, const glm::vec2& worldMax)
+            {
+                DrawSceneTile(tileCtx, worldMin, worldMax);
+            });
+    }
+    else
+    {
+        DrawCulled(ctx, SceneGroup);
+    }
 
-    // HUD pass: identity view/model + Y-up ortho so Hershey text is upright.
+    const RenderContext hudCtx = MakeHudContext(ctx);
+    if (overlayLines && !overlayLines->empty())
+    {
+        overlayPass.BeginFrame();
+        for (const LineEntity& l : *overlayLines)
+            overlayPass.Submit(l);
+        overlayPass.Draw(hudCtx);
+    }
+
+    hudPass.DrawStatic(hudCtx);
+}
+
+// HUD pass: identity view/model + Y-up ortho so Hershey text is upright.
+RenderContext StatefulVectorRenderer::MakeHudContext(const RenderContext& ctx)
+{
     float w = 1.0f, h = 1.0f;
     ExtractViewportWH_FromOrthoYDown(ctx.projection, w, h);
 
@@ -88,7 +1068,43 @@ void StatefulVectorRenderer::Redraw(const RenderContext& ctx)
     hudCtx.model = glm::mat4(1.0f);
     hudCtx.view = glm::mat4(1.0f);
     hudCtx.projection = glm::ortho(0.0f, w, 0.0f, h, -1.0f, 1.0f);
+    return hudCtx;
+}
 
-    hudPass.DrawStatic(hudCtx);
+// ------------------------------------------------------------
+// Software rasterization
+// ------------------------------------------------------------
+void StatefulVectorRenderer::RasterizeSoftware(const RenderContext& ctx, SoftwareLineRasterizer& target)
+{
+    if (!entityBook)
+        return;
+
+    // The viewport is always the target, whatever ctx says (and without GL
+    // there is no viewport to fall back on).
+    RenderContext swCtx = ctx;
+    swCtx.viewportSize = glm::vec2((float)target.GetWidth(), (float)target.GetHeight());
+
+    // Same preparation as Redraw; without GL the passes only keep their CPU
+    // shadows, which is what is drawn here.
+    worldPerPixel = WorldPerPixel(swCtx);
+    RebuildBatchesIfDirty();
+    UpdateAsyncBatches();
+    UpdateLod();
+
+    for (const BatchGroup group : { WorldGroup, SceneGroup })
+    {
+        const VisibleKeys& visible = CollectVisibleKeys(swCtx, group);
+        softwareInstances.clear();
+        GroupPass(group).ReadStatic(visible.culled ? &visible.keys : nullptr, softwareInstances);
+        target.Draw(softwareInstances.data(), softwareInstances.size(), swCtx);
+    }
+
+    const RenderContext hudCtx = MakeHudContext(swCtx);
+    if (overlayLines && !overlayLines->empty())
+        target.Draw(*overlayLines, hudCtx);
+
+    softwareInstances.clear();
+    hudPass.ReadStatic(nullptr, softwareInstances);
+    target.Draw(softwareInstances.data(), softwareInstances.size(), hudCtx);
 }
 
@@ -2,33 +2,376 @@
 
 #include "EntityBook.h"
 #include "LinePass.h"
+#include "LineLod.h"
 #include "RenderContext.h"
+#include "RenderLoopRenderer.h"
+#include "SoftwareLineRasterizer.h"
+#include "WorldTileCache.h"
 
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#ifndef OVERLAY_STREAM_BYTES
+// Ring behind the immediate-mode cursor overlay; one frame of it is a few
+// hundred bytes, so this covers many frames in flight.
+#define OVERLAY_STREAM_BYTES (64u << 10)
+#endif
+
+#ifndef WORLD_CHUNK_SIZE
+// Side of the world tiles world-space lines are bucketed into (world units).
+// A tile's lines form one chunk (split every LOD_CHUNK_SEGMENTS), the unit of
+// rebuilds, culling and level of detail.
+#define WORLD_CHUNK_SIZE 256.0f
+#endif
+
+#ifndef BATCH_BUILD_THREADS
+// Workers emitting batch instances on a rebuild (0 = hardware concurrency,
+// 1 = serial). The result does not depend on it.
+#define BATCH_BUILD_THREADS 0
+#endif
+
+#ifndef BATCH_BUILD_GRAIN
+// Entities per emission range. Ranges are fixed by position among the rebuilt
+// entities, so the merge order never depends on which worker took which range.
+#define BATCH_BUILD_GRAIN 1024
+#endif
+
+#ifndef BATCH_BUILD_PARALLEL_MIN
+// Rebuilds of fewer entities than this run on the calling thread; handing the
+// work to the pool would cost more than the rebuild.
+#define BATCH_BUILD_PARALLEL_MIN 16384
+#endif
+
+#ifndef BATCH_ASYNC_MIN_ENTITIES
+// Books with at least this many entities rebuild the scene batches on a
+// background thread while the previous ones keep drawing (0 = always).
+#define BATCH_ASYNC_MIN_ENTITIES 65536
+#endif
+
+#ifndef BATCH_UPLOAD_INSTANCES_PER_FRAME
+// Instances a frame submits from a finished background rebuild into the back
+// scene pass; the rest waits for the following frames.
+#define BATCH_UPLOAD_INSTANCES_PER_FRAME (64u << 10)
+#endif
+
 class StatefulVectorRenderer
 {
 public:
+    struct LodStats
+    {
+        std::size_t chunks = 0;
+        std::size_t simplifiedChunks = 0; // drawn from a pyramid level
+        std::size_t sourceInstances = 0;  // full detail
+        std::size_t drawnInstances = 0;   // after level selection
+        std::size_t packedChunks = 0;     // submitted as int16 packed instances
+        std::size_t staticBytes = 0;      // static instance buffers of all passes (last flush)
+        std::size_t pendingChunks = 0;    // pyramids requested but not landed yet
+        std::size_t culledChunks = 0;     // outside the view (last frame)
+    };
+
+    struct AsyncBatchStats
+    {
+        uint64_t requested = 0;    // background scene rebuilds started
+        uint64_t swapped = 0;      // finished ones swapped in
+        uint64_t uploadFrames = 0; // frames that uploaded a slice of one
+    };
+
+    StatefulVectorRenderer() = default;
+    ~StatefulVectorRenderer();
+
+    StatefulVectorRenderer(const StatefulVectorRenderer&) = delete;
+    StatefulVectorRenderer& operator=(const StatefulVectorRenderer&) = delete;
+
     void Init();
 
     void SetEntityBook(const EntityBook* book);
+
+    // Screen-space (Y-up) lines streamed every frame through an immediate-mode
+    // overlay pass, drawn between the scene and the HUD. They are not part of
+    // the retained batches, so changing them costs no rebuild.
+    void SetOverlayLines(const std::vector<LineEntity>* lines) { overlayLines = lines; }
+    const StreamRingBuffer::Stats& GetOverlayStreamStats() const { return overlayPass.GetStreamStats(); }
+
+    // Rebuild every batch on the next Redraw (changes made through the book
+    // are picked up without this).
     void MarkDirty();
 
-    // Draw cached/static batches
+    // Workers for batch rebuilds (0 = hardware concurrency, 1 = serial).
+    void SetBatchThreads(unsigned threads) { batchThreads = threads; }
+    unsigned GetBatchThreads() const { return batchThreads; }
+
+    // Books of at least this many entities rebuild the scene in the background
+    // (0 = always); see BATCH_ASYNC_MIN_ENTITIES.
+    void SetAsyncBatchMin(std::size_t entities) { asyncBatchMin = entities; }
+    std::size_t GetAsyncBatchMin() const { return asyncBatchMin; }
+    const AsyncBatchStats& GetAsyncBatchStats() const { return asyncStats; }
+
+    // Draw cached/static batches, first rebuilding the ones whose entities
+    // changed (per EntityBook tag version).
     void Redraw(const RenderContext& ctx);
 
+    const LodStats& GetLodStats() const { return lodStats; }
+
+    // True while background batch rebuilds, LOD builds or tile renders still
+    // have to land; the frames that pick them up have to be scheduled by the
+    // caller.
+    bool HasPendingWork() const;
+
+    // Draw the frame Redraw would draw with the CPU rasterizer instead of GL:
+    // the same batches (rebuilt first if needed) and passes, chunks in view at
+    // their current level of detail, then the overlay and HUD. The scene is
+    // drawn directly even with the tile cache on. Needs no GL context.
+    void RasterizeSoftware(const RenderContext& ctx, SoftwareLineRasterizer& target);
+
+    // Composite Scene-tagged world content from cached raster tiles instead of
+    // drawing it every frame (off by default).
+    void ToggleTileCache();
+    bool IsTileCacheEnabled() const { return tileCacheEnabled; }
+    const WorldTileCache::Stats& GetTileStats() const { return tileCache.GetStats(); }
+
 private:
+    // Batches rebuilt independently; an entity's group follows from its tag
+    // and screenSpace flag.
+    enum BatchGroup
+    {
+        WorldGroup,  // world space, not EntityTag::Scene (grid, ...)
+        SceneGroup,  // world space EntityTag::Scene
+        HudGroup,    // screen space
+        BatchGroupCount
+    };
+
+    // World-space lines of one group, layer and world tile (WORLD_CHUNK_SIZE),
+    // in entity order, as a rebuild produces them (see PrepareLodChunk).
+    struct ChunkData
+    {
+        int layer = 0;
+        bool scene = false; // drawn by the scene pass
+        uint64_t hash = 0;
+        std::vector<std::size_t> ids;    // entity ids, in entity order
+        std::vector<LineInstance> lines; // full detail, one per id
+        glm::vec2 boundsMin{ 0.0f };     // of lines
+        glm::vec2 boundsMax{ 0.0f };
+        float maxWidth = 0.0f;           // pixels
+        float quantError = 0.0f; // world-space error if packed (half an int16 step)
+    };
+
+    // A submitted chunk, drawn at a level of detail picked from the current
+    // pixel size and skipped when outside the view; keyed by ChunkKey(). An
+    // edit of one of its entities rebuilds just this chunk.
+    struct LodChunk : ChunkData
+    {
+        bool dirty = false;              // an entity of it was edited
+        std::shared_ptr<const LineLodChunk> lod; // may lag behind hash
+        uint64_t requestedHash = 0;
+
+        int submittedLevel = -2;
+        uint64_t submittedHash = 0;
+        bool submittedPacked = false;
+        uint32_t stamp = 0;
+    };
+
+    static BatchGroup GroupOf(const Entity& e);
+    LinePass& GroupPass(BatchGroup group);
+
+    // Instances of one fixed range of members, emitted by whichever worker
+    // took the range. ends[i] is the end offset of the range's i-th member
+    // (chunked lines get an empty span).
+    struct EmitRange
+    {
+        std::vector<LineInstance> instances;
+        std::vector<uint32_t> ends;
+        std::vector<LineEntity> textLines; // tessellation scratch
+    };
+
+    static constexpr uint32_t kNoChunk = 0xFFFFFFFFu;
+
+    // Where emission writes a chunked line: its slot in the chunk's lines,
+    // assigned (and the chunk sized) before emission starts.
+    struct EmitTarget
+    {
+        uint32_t chunk = kNoChunk; // index into BatchGeneration::chunks
+        uint32_t slot = 0;
+    };
+
+    // One store submission of a rebuild, replayed serially in entity order.
+    struct BatchOp
+    {
+        BatchGroup group;
+        uint64_t key;
+        int layer;
+        uint32_t chunk;     // a finished chunk (BatchGeneration::chunks), or
+        std::size_t member; // the BatchGeneration::members index of an entity drawn on its own
+    };
+
+    // Everything a rebuild produces before it touches a pass: the chunks with
+    // their lines and the submissions in entity order. BuildGeneration() only
+    // reads the entities it is given, so it runs on any thread; the result is
+    // submitted on the main thread, at once or spread over frames.
+    struct BatchGeneration
+    {
+        std::vector<ChunkData> chunks; // the first chunkCount are this build's
+        std::size_t chunkCount = 0;
+        std::vector<BatchOp> ops;
+        std::vector<std::size_t> members; // entity indices of the rebuilt groups, in order
+        std::vector<EmitRange> ranges;
+        std::vector<EmitTarget> targets; // by member
+        uint32_t tags[BatchGroupCount]{};
+    };
+
+    // A background scene rebuild: a copy of the book's scene entities, the
+    // book's edit count when it was taken, and the generation built from it.
+    struct SceneBuild
+    {
+        uint64_t serial = 0;
+        uint64_t editCursor = 0;
+        unsigned threads = 1;
+        std::vector<Entity> entities;
+        BatchGeneration generation;
+    };
+
+    static uint64_t ChunkKey(BatchGroup group, int layer, uint32_t cell, uint32_t part);
+    static uint32_t ChunkCell(const LineEntity& line);
+
     void RebuildBatchesIfDirty();
+    void ApplyEdits(const bool* editedGroups, bool* rebuild);
+    static void BuildGeneration(const std::vector<Entity>& entities, const bool* rebuild, unsigned threads, BatchGeneration& gen);
+    static void EmitBatchInstances(const std::vector<Entity>& entities, unsigned threads, BatchGeneration& gen);
+    static const LineInstance* LooseInstances(const BatchGeneration& gen, std::size_t member, uint32_t& count);
+    void CommitGeneration(BatchGeneration& gen);
+    static RenderContext MakeHudContext(const RenderContext& ctx);
+    static void PrepareLodChunk(ChunkData& chunk);
+    void FinishLodChunk(uint64_t key, LodChunk& chunk, LinePass& pass);
+    void RequestLod(uint64_t key, LodChunk& chunk);
+    void SubmitLodChunk(uint64_t key, LodChunk& chunk, LinePass& pass);
+    void UpdateLod();
+
+    // Background scene rebuilds: snapshot, build on batchWorker, upload into
+    // the back scene pass a slice per frame, then swap.
+    bool SceneBuildPending() const { return sceneTakenSerial != sceneBuildSerial || applyingBuild; }
+    void RequestSceneBuild();
+    void CancelSceneBuilds();
+    void UpdateAsyncBatches();
+    void SwapSceneGeneration();
+    void BatchWorkerMain();
+
+    // Keys of a group's loose entities and of its chunks that touch the view,
+    // with the number of chunks culled. Reused while the transform, the pixel
+    // size and the batches (batchVersion) are the same.
+    struct VisibleKeys
+    {
+        std::vector<uint64_t> keys;
+        std::size_t culled = 0;
+        glm::mat4 mvp{ 0.0f };
+        float worldPerPixel = -1.0f;
+        uint64_t version = ~0ull;
+    };
+
+    // Draws the pass's loose keys plus the group's chunks that touch the view.
+    void DrawCulled(const RenderContext& ctx, BatchGroup group);
+    const VisibleKeys& CollectVisibleKeys(const RenderContext& ctx, BatchGroup group);
+
+    // Scene content bounds, for tile invalidation and per-tile culling.
+    void TrackSceneKey(uint64_t key, uint64_t hash, const LineInstance* lines, std::size_t count);
+    void DropStaleSceneKeys();
+    void DrawSceneTile(const RenderContext& tileCtx, const glm::vec2& worldMin, const glm::vec2& worldMax);
 
 private:
     const EntityBook* entityBook = nullptr;
-    bool dirty = true;
+    bool dirty = true; // rebuild all groups
 
-    // We batch everything into lines for now (lines + text -> line segments)
-    std::vector<LineEntity> cachedWorldLines;
-    std::vector<LineEntity> cachedHudLines;
+    // EntityBook tag versions last synced, and the tags (bit per EntityTag)
+    // each group held after its last rebuild. A group whose tags were only
+    // edited (layout versions unchanged) redoes just the logged entities.
+    uint64_t tagVersions[kEntityTagCount]{};
+    uint64_t layoutVersions[kEntityTagCount]{};
+    uint32_t groupTags[BatchGroupCount]{};
+    uint64_t editCursor = 0;
+    std::vector<std::size_t> editedIds;
 
-    LinePass worldPass;
+    // Chunk of every chunked entity id, and the keys of world and scene
+    // entities drawn on their own (text), which are never culled.
+    std::unordered_map<std::size_t, uint64_t> chunkOfEntity;
+    std::vector<uint64_t> looseKeys[BatchGroupCount];
+    VisibleKeys visibleKeys[BatchGroupCount];
+    std::vector<uint64_t> dirtyChunkKeys;
+    std::vector<LineEntity> editLines;
+    std::vector<LineInstance> editInstances;
+
+    // We batch everything into lines for now (lines + text -> line segments).
+    // Each entity's lines are keyed by its id in the pass's static store.
+    // Chunk slots are planned first (count), then emission runs in parallel
+    // over entity ranges and writes every chunked line once, into its slot
+    // (scatter); submission stays serial.
+    unsigned batchThreads = BATCH_BUILD_THREADS;
+    BatchGeneration generation; // synchronous rebuilds
+
+    LinePass worldPass;      // world content other than the scene (grid, ...)
+    LinePass scenePasses[2]; // EntityTag::Scene world content, front and back
+    int sceneFront = 0;
     LinePass hudPass;
-};
+    bool passesInitialized = false; // Init() ran: the passes can upload and draw
+
+    // Background scene rebuilds. The worker builds the latest queued snapshot
+    // and leaves it in readyBuild; the main thread uploads it into the back
+    // scene pass (applyCursor = next op) while the front one keeps drawing,
+    // then swaps. A synchronous scene rebuild drops builds requested before it
+    // (serial <= syncSceneSerial). batchQuit, queuedBuild and readyBuild are
+    // shared with the worker under batchMutex.
+    std::size_t asyncBatchMin = BATCH_ASYNC_MIN_ENTITIES;
+    uint64_t sceneBuildSerial = 0; // last requested
+    uint64_t sceneTakenSerial = 0; // last picked up (or dropped)
+    uint64_t syncSceneSerial = 0;
+    std::unique_ptr<SceneBuild> applyingBuild;
+    std::unique_ptr<SceneBuild> spareBuild; // recycled allocations
+    std::size_t applyCursor = 0;
+    std::unordered_map<uint64_t, LodChunk> nextChunks; // scene chunks of the back pass
+    AsyncBatchStats asyncStats;
+
+    std::mutex batchMutex;
+    std::condition_variable batchWake;
+    bool batchQuit = false;
+    std::unique_ptr<SceneBuild> queuedBuild;
+    std::unique_ptr<SceneBuild> readyBuild;
+    std::thread batchWorker; // started by the first request
+
+    // Cursor overlay, immediate mode (drawn under hudPass)
+    RenderLoopRenderer overlayPass;
+    const std::vector<LineEntity>* overlayLines = nullptr;
 
+    // Level of detail for world lines
+    std::unordered_map<uint64_t, LodChunk> lodChunks;
+    uint32_t lodStamp = 0;
+    float worldPerPixel = 0.0f;
+
+    // Bumped whenever the chunks, the loose keys or a chunk's content or
+    // pyramid change. UpdateLod() walks the chunks only when it or
+    // worldPerPixel moved since its last walk (lodVersion, lodWorldPerPixel).
+    uint64_t batchVersion = 0;
+    uint64_t lodVersion = ~0ull;
+    float lodWorldPerPixel = -1.0f;
+    LineLodBuilder lodBuilder;
+    std::vector<LineLodBuilder::Result> lodResults;
+    LodStats lodStats;
+
+    // Raster tile cache for the front scene pass
+    struct SceneKey
+    {
+        uint64_t hash = 0;
+        glm::vec2 boundsMin{ 0.0f };
+        glm::vec2 boundsMax{ 0.0f };
+        uint32_t stamp = 0;
+    };
+
+    std::unordered_map<uint64_t, SceneKey> sceneKeys;
+    std::vector<uint64_t> tileKeys;
+    WorldTileCache tileCache;
+    bool tileCacheEnabled = false;
+
+    // Software rasterization: a group's batches read back from its pass
+    std::vector<LineInstance> softwareInstances;
+};
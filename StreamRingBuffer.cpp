@@ -0,0 +1,274 @@
+// StreamRingBuffer.cpp
+#include "StreamRingBuffer.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// GL 4.4 / ARB_buffer_storage (not part of the 3.3 core glad loader).
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace
+{
+    typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_VK)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+    bool HasBufferStorageExtension()
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4))
+            return true;
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i)
+        {
+            const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, (GLuint)i));
+            if (ext && std::strcmp(ext, "GL_ARB_buffer_storage") == 0)
+                return true;
+        }
+        return false;
+    }
+
+    PFNGLBUFFERSTORAGEPROC_VK LoadBufferStorage()
+    {
+        static bool resolved = false;
+        static PFNGLBUFFERSTORAGEPROC_VK fn = nullptr;
+        if (resolved)
+            return fn;
+        resolved = true;
+
+        if (!HasBufferStorageExtension())
+            return nullptr;
+
+#ifdef _WIN32
+        fn = reinterpret_cast<PFNGLBUFFERSTORAGEPROC_VK>(wglGetProcAddress("glBufferStorage"));
+#else
+        // libglvnd's libGL dispatches to whichever context is current (GLX or EGL).
+        fn = reinterpret_cast<PFNGLBUFFERSTORAGEPROC_VK>(dlsym(RTLD_DEFAULT, "glBufferStorage"));
+        if (!fn)
+        {
+            if (void* lib = dlopen("libGL.so.1", RTLD_LAZY | RTLD_LOCAL))
+                fn = reinterpret_cast<PFNGLBUFFERSTORAGEPROC_VK>(dlsym(lib, "glBufferStorage"));
+        }
+#endif
+        return fn;
+    }
+}
+
+void StreamRingBuffer::Init(GLenum bufferTarget, std::size_t capacityBytes, bool persistent)
+{
+    target = bufferTarget;
+    allowPersistent = persistent;
+
+    mode = (allowPersistent && LoadBufferStorage()) ? Mode::Persistent : Mode::Unsynchronized;
+    Allocate(capacityBytes);
+}
+
+void StreamRingBuffer::Release()
+{
+    DropFences();
+
+    if (buffer)
+    {
+        if (persistentPtr)
+        {
+            GLStateCache::BindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            persistentPtr = nullptr;
+        }
+        GLStateCache::DeleteBuffer(buffer);
+        buffer = 0;
+    }
+    capacity = 0;
+    head = 0;
+    pending = false;
+}
+
+const char* StreamRingBuffer::GetModeName() const
+{
+    switch (mode)
+    {
+    case Mode::Persistent:     return "persistent";
+    case Mode::Unsynchronized: return "unsynchronized";
+    case Mode::Orphaning:      return "orphaning";
+    default:                   return "?";
+    }
+}
+
+void StreamRingBuffer::Allocate(std::size_t capacityBytes)
+{
+    Release();
+
+    capacity = std::max<std::size_t>(capacityBytes, 64 * 1024);
+    glGenBuffers(1, &buffer);
+    GLStateCache::BindBuffer(target, buffer);
+
+    if (mode == Mode::Persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        LoadBufferStorage()(target, (GLsizeiptr)capacity, nullptr, flags);
+        persistentPtr = glMapBufferRange(target, 0, (GLsizeiptr)capacity, flags);
+        if (!persistentPtr)
+        {
+            // Immutable storage can't be re-specified; start over with a plain buffer.
+            std::printf("[StreamRingBuffer] persistent mapping failed, falling back to unsynchronized\n");
+            GLStateCache::DeleteBuffer(buffer);
+            mode = Mode::Unsynchronized;
+            glGenBuffers(1, &buffer);
+            GLStateCache::BindBuffer(target, buffer);
+        }
+    }
+
+    if (mode != Mode::Persistent)
+        glBufferData(target, (GLsizeiptr)capacity, nullptr, GL_STREAM_DRAW);
+
+    ++stats.orphans;
+}
+
+void StreamRingBuffer::DropFences()
+{
+    for (auto& f : fences)
+        glDeleteSync(f.sync);
+    fences.clear();
+}
+
+void StreamRingBuffer::WaitForRange(std::size_t begin, std::size_t end)
+{
+    // Fences are in submission order; anything overlapping [begin, end) must retire.
+    for (auto it = fences.begin(); it != fences.end(); )
+    {
+        if (it->end <= begin || it->begin >= end)
+        {
+            ++it;
+            continue;
+        }
+
+        GLenum r = glClientWaitSync(it->sync, 0, 0);
+        if (r == GL_TIMEOUT_EXPIRED)
+        {
+            const auto t0 = std::chrono::steady_clock::now();
+            do
+            {
+                r = glClientWaitSync(it->sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            } while (r == GL_TIMEOUT_EXPIRED);
+
+            ++stats.stalls;
+            stats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        }
+
+        glDeleteSync(it->sync);
+        it = fences.erase(it);
+    }
+}
+
+GLintptr StreamRingBuffer::Upload(const void* data, std::size_t bytes, std::size_t alignment)
+{
+    if (!buffer)
+        Init(target);
+
+    // Keep room for about three uploads of this size in flight.
+    if (bytes * 3 > capacity)
+    {
+        std::size_t grown = capacity;
+        while (grown < bytes * 3)
+            grown *= 2;
+        Allocate(grown);
+    }
+
+    alignment = std::max<std::size_t>(1, alignment);
+    std::size_t offset = (head + alignment - 1) / alignment * alignment;
+
+    const bool wrap = (offset + bytes > capacity);
+    if (wrap)
+    {
+        // Everything written so far has been drawn; fence it before reusing the start.
+        Fence();
+        offset = 0;
+        ++stats.wraps;
+    }
+
+    GLStateCache::BindBuffer(target, buffer);
+
+    switch (mode)
+    {
+    case Mode::Persistent:
+        WaitForRange(offset, offset + bytes);
+        std::memcpy(static_cast<char*>(persistentPtr) + offset, data, bytes);
+        break;
+
+    case Mode::Unsynchronized:
+    {
+        WaitForRange(offset, offset + bytes);
+        void* dst = glMapBufferRange(target, offset, (GLsizeiptr)bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (dst)
+        {
+            std::memcpy(dst, data, bytes);
+            glUnmapBuffer(target);
+            break;
+        }
+
+        // Mapping not usable on this driver: orphan from now on.
+        std::printf("[StreamRingBuffer] glMapBufferRange failed, falling back to orphaning\n");
+        mode = Mode::Orphaning;
+        DropFences();
+        [[fallthrough]];
+    }
+
+    case Mode::Orphaning:
+        if (wrap || offset == 0)
+        {
+            glBufferData(target, (GLsizeiptr)capacity, nullptr, GL_STREAM_DRAW);
+            ++stats.orphans;
+        }
+        glBufferSubData(target, offset, (GLsizeiptr)bytes, data);
+        break;
+    }
+
+    if (!pending)
+    {
+        pendingBegin = offset;
+        pending = true;
+    }
+    pendingEnd = offset + bytes;
+    head = offset + bytes;
+
+    stats.bytesStreamed += bytes;
+    stats.frameBytes += bytes;
+    ++stats.uploads;
+
+    return (GLintptr)offset;
+}
+
+void StreamRingBuffer::Fence()
+{
+    if (!pending)
+        return;
+    pending = false;
+
+    if (mode == Mode::Orphaning)
+        return;
+
+    FencedRange f;
+    f.begin = pendingBegin;
+    f.end = pendingEnd;
+    f.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fences.push_back(f);
+}
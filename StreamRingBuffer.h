@@ -0,0 +1,81 @@
+// StreamRingBuffer.h
+#pragma once
+#include "glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Streaming buffer for per-frame vertex/instance data.
+//
+// Uploads are appended to a ring sized for about three frames in flight; each
+// region is protected with a glFenceSync after the draws that read it, and the
+// writer only waits when it catches up with a region the GPU may still be
+// reading (counted as a stall). Writes go through, in order of preference:
+//  - Persistent: glBufferStorage + persistent coherent mapping (GL 4.4 /
+//    GL_ARB_buffer_storage; resolved at runtime since glad is 3.3 core only)
+//  - Unsynchronized: glMapBufferRange(UNSYNCHRONIZED | INVALIDATE_RANGE)
+//  - Orphaning: glBufferData(nullptr) on wrap + glBufferSubData (no fences;
+//    the driver hands out fresh storage)
+class StreamRingBuffer
+{
+public:
+    enum class Mode { Persistent, Unsynchronized, Orphaning };
+
+    struct Stats
+    {
+        uint64_t bytesStreamed = 0;   // total
+        uint64_t frameBytes = 0;      // since the last ResetFrameStats()
+        uint64_t uploads = 0;
+        uint64_t wraps = 0;
+        uint64_t stalls = 0;          // waits on a fence that had not signaled yet
+        double stallMilliseconds = 0.0;
+        uint64_t orphans = 0;         // buffer re-specifications (orphaning mode / growth)
+    };
+
+    void Init(GLenum target = GL_ARRAY_BUFFER, std::size_t capacityBytes = 3u << 20, bool allowPersistent = true);
+    void Release();
+
+    // Copies data into the ring and returns its byte offset in GetBuffer().
+    // Leaves the ring buffer bound to the target.
+    GLintptr Upload(const void* data, std::size_t bytes, std::size_t alignment = 16);
+
+    // Call after the draws that read everything uploaded since the last Fence().
+    void Fence();
+
+    GLuint GetBuffer() const { return buffer; }
+    Mode GetMode() const { return mode; }
+    const char* GetModeName() const;
+
+    const Stats& GetStats() const { return stats; }
+    void ResetFrameStats() { stats.frameBytes = 0; }
+
+private:
+    struct FencedRange
+    {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        GLsync sync = nullptr;
+    };
+
+    void Allocate(std::size_t capacityBytes);
+    void WaitForRange(std::size_t begin, std::size_t end);
+    void DropFences();
+
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint buffer = 0;
+    std::size_t capacity = 0;
+    std::size_t head = 0;
+
+    Mode mode = Mode::Unsynchronized;
+    bool allowPersistent = true;
+    void* persistentPtr = nullptr;
+
+    // Region written since the last Fence()
+    std::size_t pendingBegin = 0;
+    std::size_t pendingEnd = 0;
+    bool pending = false;
+
+    std::deque<FencedRange> fences;
+    Stats stats;
+};
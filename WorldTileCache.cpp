@@ -0,0 +1,410 @@
+// WorldTileCache.cpp
+#include "WorldTileCache.h"
+#include "GLShaderUtil.h"
+#include "GLStateCache.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Content is queried this many pixels past the tile edge so wide lines and
+    // square caps crossing it are not cut off.
+    constexpr float kQueryPadPx = 16.0f;
+
+    // Sub-pixel offsets of the world origin are matched to 1/256 pixel.
+    constexpr int kPhaseSteps = 256;
+
+    uint32_t FloatBits(float f)
+    {
+        uint32_t u = 0;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+}
+
+void WorldTileCache::Init()
+{
+    // One quad per tile; corners come from gl_VertexID, the world rect from a uniform.
+    const char* vs = R"(
+        #version 330 core
+        uniform mat4 mvp;
+        uniform vec4 rect; // world corners at texel (0, 0) and (1, 1)
+        out vec2 vUv;
+
+        void main()
+        {
+            vec2 c = vec2((gl_VertexID & 1) != 0 ? 1.0 : 0.0, (gl_VertexID & 2) != 0 ? 1.0 : 0.0);
+            vUv = c; // rect.xy is texel (0, 0)
+            gl_Position = mvp * vec4(mix(rect.xy, rect.zw, c), 0.0, 1.0);
+        }
+    )";
+
+    const char* fs = R"(
+        #version 330 core
+        uniform sampler2D tileTexture;
+        in vec2 vUv;
+        out vec4 FragColor;
+        void main()
+        {
+            FragColor = texture(tileTexture, vUv); // premultiplied
+        }
+    )";
+
+    program = CreateProgram(vs, fs);
+    uMvp = glGetUniformLocation(program, "mvp");
+    uRect = glGetUniformLocation(program, "rect");
+    uTexture = glGetUniformLocation(program, "tileTexture");
+
+    glGenVertexArrays(1, &quadVao);
+
+    glGenSamplers(1, &nearestSampler);
+    glSamplerParameteri(nearestSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(nearestSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glSamplerParameteri(nearestSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(nearestSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenSamplers(1, &linearSampler);
+    glSamplerParameteri(linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void WorldTileCache::Release()
+{
+    for (auto& t : tiles)
+    {
+        GLStateCache::DeleteFramebuffer(t.fbo);
+        GLStateCache::DeleteTexture(t.texture);
+    }
+    tiles.clear();
+    tileIndex.clear();
+
+    if (program)
+    {
+        GLStateCache::DeleteProgram(program);
+        GLStateCache::DeleteVertexArray(quadVao);
+        glDeleteSamplers(1, &nearestSampler);
+        glDeleteSamplers(1, &linearSampler);
+        program = 0;
+        quadVao = 0;
+        nearestSampler = 0;
+        linearSampler = 0;
+    }
+}
+
+// ------------------------------------------------------------
+// Invalidation
+// ------------------------------------------------------------
+void WorldTileCache::Invalidate(const glm::vec2& worldMin, const glm::vec2& worldMax)
+{
+    for (auto& t : tiles)
+    {
+        if (!t.inUse || !t.valid)
+            continue;
+
+        // Pixels past the edge can come from content just outside the tile.
+        const float pad = kQueryPadPx / t.scale;
+        if (worldMax.x < t.worldMin.x - pad || worldMin.x > t.worldMax.x + pad ||
+            worldMax.y < t.worldMin.y - pad || worldMin.y > t.worldMax.y + pad)
+            continue;
+
+        t.valid = false;
+    }
+}
+
+void WorldTileCache::InvalidateAll()
+{
+    for (auto& t : tiles)
+        t.valid = false;
+}
+
+// ------------------------------------------------------------
+// Tiles
+// ------------------------------------------------------------
+std::size_t WorldTileCache::AcquireTile(const TileKey& key)
+{
+    auto it = tileIndex.find(key);
+    if (it != tileIndex.end())
+        return it->second;
+
+    std::size_t index = tiles.size();
+    if (tiles.size() < TILE_CACHE_MAX_TILES)
+    {
+        Tile t;
+        glGenTextures(1, &t.texture);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, t.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TILE_CACHE_TILE_PX, TILE_CACHE_TILE_PX, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+
+        const GLuint prevFbo = GLStateCache::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
+        glGenFramebuffers(1, &t.fbo);
+        GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, t.fbo);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t.texture, 0);
+        const GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+        GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::printf("[WorldTileCache] tile framebuffer incomplete (0x%x)\n", status);
+            GLStateCache::DeleteFramebuffer(t.fbo);
+            GLStateCache::DeleteTexture(t.texture);
+            return SIZE_MAX;
+        }
+
+        tiles.push_back(t);
+    }
+    else
+    {
+        // Least recently used tile that is not on screen this frame.
+        index = SIZE_MAX;
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (tiles[i].lastUsed >= frame)
+                continue;
+            if (index == SIZE_MAX || tiles[i].lastUsed < tiles[index].lastUsed)
+                index = i;
+        }
+        if (index == SIZE_MAX)
+            return SIZE_MAX;
+
+        tileIndex.erase(tiles[index].key);
+        ++stats.evicted;
+    }
+
+    Tile& t = tiles[index];
+    t.key = key;
+    t.inUse = true;
+    t.valid = false;
+    tileIndex[key] = index;
+    return index;
+}
+
+void WorldTileCache::RenderTile(Tile& tile, const RenderFn& render)
+{
+    const GLuint prevFbo = GLStateCache::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
+    const GLStateCache::Rect prevViewport = GLStateCache::GetViewport();
+    const glm::vec4 prevClear = GLStateCache::GetClearColor();
+
+    GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, tile.fbo);
+    GLStateCache::Viewport(0, 0, TILE_CACHE_TILE_PX, TILE_CACHE_TILE_PX);
+    GLStateCache::ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // cornerA lands on texel (0, 0), in the same orientation as on screen.
+    RenderContext tileCtx;
+    tileCtx.projection = glm::ortho(tile.cornerA.x, tile.cornerB.x, tile.cornerA.y, tile.cornerB.y, -1.0f, 1.0f);
+    tileCtx.viewportSize = glm::vec2((float)TILE_CACHE_TILE_PX);
+
+    const glm::vec2 pad(kQueryPadPx / tile.scale);
+    render(tileCtx, tile.worldMin - pad, tile.worldMax + pad);
+
+    GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+    GLStateCache::Viewport(prevViewport.x, prevViewport.y, prevViewport.width, prevViewport.height);
+    GLStateCache::ClearColor(prevClear.x, prevClear.y, prevClear.z, prevClear.w);
+
+    tile.valid = true;
+    ++stats.rendered;
+}
+
+void WorldTileCache::DrawTile(const Tile& tile, const glm::mat4& mvp, bool exact)
+{
+    GLStateCache::UniformMatrix4(uMvp, mvp);
+    GLStateCache::Uniform4f(uRect, tile.cornerA.x, tile.cornerA.y, tile.cornerB.x, tile.cornerB.y);
+    glBindSampler(0, exact ? nearestSampler : linearSampler);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, tile.texture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// ------------------------------------------------------------
+// Frame
+// ------------------------------------------------------------
+void WorldTileCache::Draw(const RenderContext& ctx, const RenderFn& render)
+{
+    if (!program)
+        Init();
+
+    ++frame;
+    stats.visible = 0;
+    stats.fallbacks = 0;
+    stats.rendered = 0;
+    stats.pending = 0;
+
+    const GLStateCache::Rect vp = GLStateCache::GetViewport();
+    glm::vec2 viewport = ctx.viewportSize;
+    if (viewport.x <= 0.0f || viewport.y <= 0.0f)
+        viewport = glm::vec2((float)std::max(1, vp.width), (float)std::max(1, vp.height));
+
+    // Window pixel p of world point w, per axis: p = w * s + o (s < 0 for Y-down).
+    const glm::mat4 mvp = ctx.projection * ctx.view * ctx.model;
+    const glm::vec2 s(mvp[0][0] * 0.5f * viewport.x, mvp[1][1] * 0.5f * viewport.y);
+    const glm::vec2 o((mvp[3][0] * 0.5f + 0.5f) * viewport.x, (mvp[3][1] * 0.5f + 0.5f) * viewport.y);
+    const float scale = std::abs(s.x);
+    if (!(scale > 0.0f) || !std::isfinite(scale) || !(std::abs(s.y) > 0.0f))
+        return;
+
+    // Tiles live on the screen's pixel grid: cell (i, j) covers q in [iT, (i+1)T)
+    // with q = p - floor(o) = w * s + phase. Panning by whole pixels keeps the
+    // phase, so cached tiles line up exactly; the phase is part of the level.
+    const glm::vec2 originPx = glm::floor(o);
+    const glm::ivec2 phaseQ(
+        (int)std::lround((o.x - originPx.x) * kPhaseSteps) % kPhaseSteps,
+        (int)std::lround((o.y - originPx.y) * kPhaseSteps) % kPhaseSteps);
+    const glm::vec2 phase = glm::vec2(phaseQ) / (float)kPhaseSteps;
+
+    const uint64_t level = ((uint64_t)FloatBits(scale) << 32) | ((s.y < 0.0f) ? 0x10000u : 0u) |
+        ((uint64_t)phaseQ.x << 8) | (uint64_t)phaseQ.y;
+
+    const float tilePx = (float)TILE_CACHE_TILE_PX;
+    auto worldAt = [&](float qx, float qy) { return glm::vec2((qx - phase.x) / s.x, (qy - phase.y) / s.y); };
+
+    const int32_t x0 = (int32_t)std::floor(-originPx.x / tilePx);
+    const int32_t x1 = (int32_t)std::floor((viewport.x - 1.0f - originPx.x) / tilePx);
+    const int32_t y0 = (int32_t)std::floor(-originPx.y / tilePx);
+    const int32_t y1 = (int32_t)std::floor((viewport.y - 1.0f - originPx.y) / tilePx);
+
+    struct Cell
+    {
+        TileKey key;
+        glm::vec2 cornerA; // world at the cell's (0, 0) texel corner
+        glm::vec2 cornerB; // world at the opposite corner
+        float distance;    // from the view center, in cells
+    };
+
+    std::vector<Cell> cells;
+    cells.reserve((std::size_t)(x1 - x0 + 1) * (std::size_t)(y1 - y0 + 1));
+    const glm::vec2 centerCell = 0.5f * glm::vec2((float)(x0 + x1), (float)(y0 + y1));
+    for (int32_t y = y0; y <= y1; ++y)
+    {
+        for (int32_t x = x0; x <= x1; ++x)
+        {
+            Cell c;
+            c.key = TileKey{ level, x, y };
+            c.cornerA = worldAt(x * tilePx, y * tilePx);
+            c.cornerB = worldAt((x + 1) * tilePx, (y + 1) * tilePx);
+            c.distance = glm::length(glm::vec2((float)x, (float)y) - centerCell);
+            cells.push_back(c);
+
+            // Keep on-screen tiles away from eviction before anything renders.
+            auto it = tileIndex.find(c.key);
+            if (it != tileIndex.end())
+                tiles[it->second].lastUsed = frame;
+        }
+    }
+    stats.visible = cells.size();
+
+    // Render missing/stale cells on a per-frame budget, center first.
+    std::vector<const Cell*> missing;
+    for (const Cell& c : cells)
+    {
+        auto it = tileIndex.find(c.key);
+        if (it == tileIndex.end() || !tiles[it->second].valid)
+            missing.push_back(&c);
+    }
+    std::sort(missing.begin(), missing.end(), [](const Cell* a, const Cell* b) { return a->distance < b->distance; });
+
+    for (const Cell* c : missing)
+    {
+        if (stats.rendered >= TILE_CACHE_TILES_PER_FRAME)
+        {
+            ++stats.pending;
+            continue;
+        }
+
+        const std::size_t index = AcquireTile(c->key);
+        if (index == SIZE_MAX)
+        {
+            ++stats.pending;
+            continue;
+        }
+
+        Tile& t = tiles[index];
+        t.scale = scale;
+        t.cornerA = c->cornerA;
+        t.cornerB = c->cornerB;
+        t.worldMin = glm::min(c->cornerA, c->cornerB);
+        t.worldMax = glm::max(c->cornerA, c->cornerB);
+        t.lastUsed = frame;
+        RenderTile(t, render);
+    }
+
+    // Composite (premultiplied alpha over whatever is already drawn)
+    const bool blendWasEnabled = GLStateCache::IsEnabled(GL_BLEND);
+    const bool scissorWasEnabled = GLStateCache::IsEnabled(GL_SCISSOR_TEST);
+    const GLStateCache::Rect prevScissor = GLStateCache::GetScissor();
+    const GLStateCache::BlendFactors prevBlend = GLStateCache::GetBlendFunc();
+
+    GLStateCache::SetEnabled(GL_BLEND, true);
+    GLStateCache::BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateCache::SetEnabled(GL_DEPTH_TEST, false);
+
+    GLStateCache::UseProgram(program);
+    GLStateCache::Uniform1i(uTexture, 0);
+    GLStateCache::ActiveTexture(GL_TEXTURE0);
+    GLStateCache::BindVertexArray(quadVao);
+
+    std::vector<Tile*> fallback;
+    for (const Cell& c : cells)
+    {
+        auto it = tileIndex.find(c.key);
+        if (it != tileIndex.end())
+        {
+            // Current level (possibly stale until its turn to re-render)
+            GLStateCache::SetEnabled(GL_SCISSOR_TEST, false);
+            DrawTile(tiles[it->second], mvp, true);
+            continue;
+        }
+
+        // Other levels overlapping this cell, farthest scale first so the
+        // closest one ends up on top.
+        const glm::vec2 cellMin = glm::min(c.cornerA, c.cornerB);
+        const glm::vec2 cellMax = glm::max(c.cornerA, c.cornerB);
+
+        fallback.clear();
+        for (Tile& t : tiles)
+        {
+            if (!t.inUse || t.key.level == level)
+                continue;
+            if (t.worldMax.x <= cellMin.x || t.worldMin.x >= cellMax.x ||
+                t.worldMax.y <= cellMin.y || t.worldMin.y >= cellMax.y)
+                continue;
+            fallback.push_back(&t);
+        }
+        if (fallback.empty())
+            continue;
+
+        std::sort(fallback.begin(), fallback.end(), [scale](const Tile* a, const Tile* b)
+            {
+                return std::abs(std::log2(a->scale / scale)) > std::abs(std::log2(b->scale / scale));
+            });
+
+        GLStateCache::SetEnabled(GL_SCISSOR_TEST, true);
+        GLStateCache::Scissor(vp.x + (GLint)originPx.x + c.key.x * TILE_CACHE_TILE_PX,
+            vp.y + (GLint)originPx.y + c.key.y * TILE_CACHE_TILE_PX,
+            TILE_CACHE_TILE_PX, TILE_CACHE_TILE_PX);
+
+        for (Tile* t : fallback)
+        {
+            t->lastUsed = frame;
+            DrawTile(*t, mvp, false);
+        }
+        ++stats.fallbacks;
+    }
+
+    glBindSampler(0, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+
+    GLStateCache::BlendFuncSeparate(prevBlend);
+    GLStateCache::SetEnabled(GL_BLEND, blendWasEnabled);
+    GLStateCache::SetEnabled(GL_SCISSOR_TEST, scissorWasEnabled);
+    GLStateCache::Scissor(prevScissor.x, prevScissor.y, prevScissor.width, prevScissor.height);
+
+    stats.tiles = tiles.size();
+}
@@ -0,0 +1,124 @@
+// WorldTileCache.h
+#pragma once
+#include "glad.h"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderContext.h"
+
+#ifndef TILE_CACHE_TILE_PX
+#define TILE_CACHE_TILE_PX 256
+#endif
+
+#ifndef TILE_CACHE_MAX_TILES
+// 160 tiles of 256x256 RGBA8 = 40 MB of textures.
+#define TILE_CACHE_MAX_TILES 160
+#endif
+
+#ifndef TILE_CACHE_TILES_PER_FRAME
+// Tiles (re)rendered per frame; the rest of the view is composited from cache.
+#define TILE_CACHE_TILES_PER_FRAME 4
+#endif
+
+// Raster cache for static world content.
+//
+// The world is cut into square tiles of TILE_CACHE_TILE_PX pixels on the
+// screen's pixel grid at the exact scale they were rendered at (a "level" = one
+// pixels-per-world value and sub-pixel phase, so whole-pixel pans reuse tiles
+// texel for texel). Draw()
+// renders at most TILE_CACHE_TILES_PER_FRAME missing or invalidated visible
+// tiles, nearest to the view center first, into offscreen textures, then
+// composites every visible tile as a textured quad. A visible cell with no tile
+// at the current level yet shows the cached tiles of other levels (scaled,
+// clipped to the cell), so zooming keeps showing content while the new level
+// fills in. Tiles are recycled least-recently-used.
+//
+// Invalidate() marks tiles of every level overlapping a world rect; they keep
+// being shown (stale) until re-rendered.
+//
+// Assumes the transform is a 2D scale + translation (no rotation).
+class WorldTileCache
+{
+public:
+    // Draw the content of [worldMin, worldMax] with tileCtx (FBO and viewport are bound).
+    using RenderFn = std::function<void(const RenderContext& tileCtx, const glm::vec2& worldMin, const glm::vec2& worldMax)>;
+
+    struct Stats
+    {
+        std::size_t tiles = 0;       // allocated
+        std::size_t visible = 0;     // cells covering the view
+        std::size_t fallbacks = 0;   // cells drawn from other levels
+        std::size_t rendered = 0;    // tiles rendered this frame
+        std::size_t pending = 0;     // visible cells still missing or stale
+        std::size_t evicted = 0;     // total
+    };
+
+    void Init();
+    void Release();
+
+    void Invalidate(const glm::vec2& worldMin, const glm::vec2& worldMax);
+    void InvalidateAll();
+
+    void Draw(const RenderContext& ctx, const RenderFn& render);
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    struct TileKey
+    {
+        uint64_t level = 0; // pixels-per-world, orientation and sub-pixel phase
+        int32_t x = 0;
+        int32_t y = 0;
+
+        bool operator==(const TileKey& o) const { return level == o.level && x == o.x && y == o.y; }
+    };
+
+    struct TileKeyHash
+    {
+        std::size_t operator()(const TileKey& k) const
+        {
+            uint64_t h = k.level * 0x9e3779b97f4a7c15ull;
+            h ^= ((uint64_t)(uint32_t)k.x << 32 | (uint32_t)k.y) + 0xbf58476d1ce4e5b9ull + (h << 6) + (h >> 2);
+            return (std::size_t)h;
+        }
+    };
+
+    struct Tile
+    {
+        GLuint texture = 0;
+        GLuint fbo = 0;
+        TileKey key;
+        float scale = 0.0f;         // pixels per world unit
+        glm::vec2 cornerA{ 0.0f };  // world at texel (0, 0)
+        glm::vec2 cornerB{ 0.0f };  // world at texel (T, T)
+        glm::vec2 worldMin{ 0.0f };
+        glm::vec2 worldMax{ 0.0f };
+        uint64_t lastUsed = 0;
+        bool inUse = false;
+        bool valid = false;
+    };
+
+    std::size_t AcquireTile(const TileKey& key);
+    void RenderTile(Tile& tile, const RenderFn& render);
+    void DrawTile(const Tile& tile, const glm::mat4& mvp, bool exact);
+
+private:
+    GLuint program = 0;
+    GLuint quadVao = 0;
+    GLuint nearestSampler = 0;
+    GLuint linearSampler = 0;
+    GLint uMvp = -1;
+    GLint uRect = -1;
+    GLint uTexture = -1;
+
+    std::vector<Tile> tiles;
+    std::unordered_map<TileKey, std::size_t, TileKeyHash> tileIndex;
+    uint64_t frame = 0;
+
+    Stats stats;
+};
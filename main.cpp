@@ -12,6 +12,10 @@
 #include <cstdlib>
 
 #include "Application.h"
+#include "FrameProfiler.h"
+#include "FrameScheduler.h"
+#include "GLStateCache.h"
+#include "IntersectionBenchmark.h"
 
 // ADD: renderer headers
 #include "StatefulVectorRenderer.h"
@@ -19,9 +23,24 @@
 
 static Application g_app;
 
+// Renders only when something invalidated the frame; the loop blocks otherwise.
+static FrameScheduler g_scheduler;
+
 // ADD: global renderer instance
 static StatefulVectorRenderer g_renderer;
 
+// ------------------------------------------------------------
+// Vsync (WGL_EXT_swap_control, when the driver exposes it)
+// ------------------------------------------------------------
+typedef BOOL(WINAPI* SwapIntervalFn)(int interval);
+static SwapIntervalFn g_swapInterval = nullptr;
+
+static void ApplyVSync()
+{
+    if (g_swapInterval)
+        g_swapInterval(g_scheduler.IsVSync() ? 1 : 0);
+}
+
 // ------------------------------------------------------------
 // OpenGL init
 // ------------------------------------------------------------
@@ -51,6 +70,9 @@ static void InitOpenGL(HWND hwnd)
         std::exit(1);
     }
 
+    g_swapInterval = (SwapIntervalFn)wglGetProcAddress("wglSwapIntervalEXT");
+    ApplyVSync();
+
     // ADD: init renderer once GL is ready
     g_renderer.Init();
 
@@ -63,7 +85,7 @@ static void InitOpenGL(HWND hwnd)
 static void OnResize(int w, int h)
 {
     g_app.OnResize(w, h);
-    glViewport(0, 0, w, h);
+    GLStateCache::Viewport(0, 0, w, h);
 }
 
 // ------------------------------------------------------------
@@ -71,7 +93,7 @@ static void OnResize(int w, int h)
 // ------------------------------------------------------------
 static void RenderFrame(HWND hwnd)
 {
-    glClearColor(0.07f, 0.07f, 0.08f, 1.0f);
+    GLStateCache::ClearColor(0.07f, 0.07f, 0.08f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // ADD: draw EntityBook through renderer each frame
@@ -79,6 +101,7 @@ static void RenderFrame(HWND hwnd)
     ctx.projection = g_app.GetProjectionMatrix();
     ctx.view = g_app.GetViewMatrix();
     ctx.model = g_app.GetModelMatrix();
+    ctx.viewportSize = glm::vec2(g_app.GetClientSize());
 
     g_renderer.Redraw(ctx);
 
@@ -140,6 +163,13 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 
     case WM_SIZE:
         OnResize((int)LOWORD(lParam), (int)HIWORD(lParam));
+        g_scheduler.Invalidate();
+        return 0;
+
+    case WM_PAINT:
+        // Exposed or restored: the next scheduled frame repaints everything.
+        ValidateRect(hwnd, nullptr);
+        g_scheduler.Invalidate();
         return 0;
 
     case WM_SETCURSOR:
@@ -241,6 +271,15 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         {
         case 'S': g_app.ToggleSelectionMode(); return 0;
         case 'G': g_app.ToggleGrid(); return 0;
+        case 'O': g_app.ToggleObjectSnap(); return 0;
+        case 'B': IntersectionBenchmark::Run(); return 0;
+        case 'T': g_renderer.ToggleTileCache(); return 0;
+        case 'F': g_app.ToggleFrameStats(); return 0;
+        case 'V':
+            g_scheduler.SetVSync(!g_scheduler.IsVSync());
+            ApplyVSync();
+            std::printf("[Main] vsync %s\n", g_scheduler.IsVSync() ? "on" : "off");
+            return 0;
         case VK_LEFT:  g_app.PanByPixels(-40, 0); return 0;
         case VK_RIGHT: g_app.PanByPixels(40, 0); return 0;
         case VK_UP:    g_app.PanByPixels(0, -40); return 0;
@@ -250,6 +289,8 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
     }
 
     case WM_DESTROY:
+        FrameProfiler::Release();
+        GLStateCache::Release();
         ShowSystemCursor();
         PostQuitMessage(0);
         return 0;
@@ -304,12 +345,15 @@ int WINAPI WinMain(
     if (!hwnd)
         return 0;
 
+    // Pick index persisted next to the drawing (mapped on load when up to date).
+    g_app.SetPickIndexPath("scene.vkpick");
     g_app.Init(width, height);
 
     // ADD: connect renderer to app's EntityBook after app is initialized
     g_renderer.SetEntityBook(&g_app.GetEntityBook());
+    g_renderer.SetOverlayLines(&g_app.GetOverlayLines());
 
-    auto last = std::chrono::high_resolution_clock::now();
+    using Clock = FrameScheduler::Clock;
 
     MSG msg{};
     while (true)
@@ -318,16 +362,44 @@ int WINAPI WinMain(
         {
             if (msg.message == WM_QUIT)
                 return 0;
+
+            // Mouse and keyboard input can change the cursor, camera or scene.
+            if ((msg.message >= WM_MOUSEFIRST && msg.message <= WM_MOUSELAST) ||
+                (msg.message >= WM_KEYFIRST && msg.message <= WM_KEYLAST))
+                g_scheduler.Invalidate();
+
             TranslateMessage(&msg);
             DispatchMessageA(&msg);
         }
 
-        auto now = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<float> dt = now - last;
-        last = now;
+        const auto now = Clock::now();
+        if (!g_scheduler.IsFrameDue(now))
+        {
+            // Idle: sleep until the next message or the next scheduled frame.
+            Clock::duration wait;
+            DWORD timeout = INFINITE;
+            if (g_scheduler.GetWaitTime(now, wait))
+                timeout = (DWORD)std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, timeout, QS_ALLINPUT);
+            continue;
+        }
+
+        const float dt = g_scheduler.BeginFrame(now);
 
-        g_app.Update(dt.count());
+        FrameProfiler::BeginFrame();
+        g_app.Update(dt);
         RenderFrame(hwnd);
+
+        const auto end = Clock::now();
+        FrameProfiler::EndFrame(std::chrono::duration<double, std::milli>(end - now).count());
+
+        // Keep frames coming while background results are due or the
+        // statistics overlay is refreshing.
+        if (g_app.HasPendingWork() || g_renderer.HasPendingWork())
+            g_scheduler.InvalidateAt(end + std::chrono::milliseconds(FRAME_SCHEDULER_POLL_MS));
+        if (g_app.IsFrameStatsVisible())
+            g_scheduler.InvalidateAt(end + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<float>(FRAME_STATS_HUD_INTERVAL)));
     }
 }
 